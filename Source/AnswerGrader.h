@@ -0,0 +1,68 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "QuizSession.h"
+#include "PitchSet.h"
+#include "Metrics.h"
+
+// Grades played notes against the session's melody one step at a time. A
+// wrong step counts a mistake and restarts the attempt from the first note;
+// repeating the previous note is ignored. Message thread only.
+class AnswerGrader
+{
+public:
+    enum class Result
+    {
+        ignored,
+        step,
+        wrong,
+        complete
+    };
+
+    explicit AnswerGrader(const QuizSession &quizSession) : session(quizSession) {}
+
+    bool isExpectingNote() const
+    {
+        return !session.replaying.load() && session.answering && session.quiz[position] != 0;
+    }
+
+    Result grade(int note)
+    {
+        if (!isExpectingNote() || note == previousNote)
+            return Result::ignored;
+
+        Metrics::ScopedTimer timer(Metrics::get().gradingSeconds);
+        auto correct = PitchSet::matchesMelodicStep(note, previousNote, session.quiz[position],
+                                                    position ? session.quiz[position - 1] : 0, position > 0);
+        previousNote = note;
+        if (!correct)
+        {
+            ++mistakes;
+            position = 0;
+            return Result::wrong;
+        }
+
+        ++position;
+        return session.quiz[position] == 0 ? Result::complete : Result::step;
+    }
+
+    // Notes answered correctly so far in this attempt.
+    int getPosition() const { return position; }
+    int getMistakes() const { return mistakes; }
+
+    // For answers graded elsewhere, such as rhythm takes.
+    void countMistake() { ++mistakes; }
+
+    // Call when a new quiz starts.
+    void reset()
+    {
+        position = 0;
+        mistakes = 0;
+    }
+
+private:
+    const QuizSession &session;
+    int position = 0;
+    int mistakes = 0;
+    int previousNote = 0;
+};
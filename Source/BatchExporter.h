@@ -0,0 +1,231 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "QuizGenerator.h"
+#include "SynthUsingMidiInput.h"
+
+// Renders one quiz at a time through its own copy of the app's instruments,
+// streaming each block straight to the writer so memory stays bounded by
+// the block size. instrument is an InstrumentSynth::Instrument, or -1 for
+// the app's default; the sampled piano falls back to that default when its
+// library is not installed.
+class QuizRenderer
+{
+public:
+    QuizRenderer(double sampleRate, int blockSize, int instrument = -1)
+        : instruments(instrument < 0 || instrument == (int)InstrumentSynth::Instrument::sampledPiano),
+          synth(instruments.getSynth()), buffer(1, blockSize)
+    {
+        if (instrument >= 0)
+            instruments.setInstrument((InstrumentSynth::Instrument)instrument);
+
+        synth.setCurrentPlaybackSampleRate(sampleRate);
+        noteLength = juce::roundToInt(sampleRate * 0.5);
+        tailLength = juce::roundToInt(sampleRate * 0.25);
+    }
+
+    // Plays the zero-terminated note list with the same 0.5 s spacing as replay.
+    bool render(const int *quiz, juce::AudioFormatWriter &writer)
+    {
+        return renderBlocks(quiz, [&writer](const juce::AudioSampleBuffer &block, int numSamples)
+                            { return writer.writeFromAudioSampleBuffer(block, 0, numSamples); });
+    }
+
+    // Hands each rendered block to sink(block, numSamples); stops if it returns false.
+    template <typename Sink>
+    bool renderBlocks(const int *quiz, Sink &&sink)
+    {
+        quizMidi.clear();
+        int numNotes = 0;
+        for (; numNotes < QuizGenerator::maxQuizLength && quiz[numNotes]; ++numNotes)
+        {
+            quizMidi.addEvent(juce::MidiMessage::noteOn(1, quiz[numNotes], (juce::uint8)100), numNotes * noteLength);
+            quizMidi.addEvent(juce::MidiMessage::noteOff(1, quiz[numNotes]), (numNotes + 1) * noteLength);
+        }
+
+        auto ok = true;
+        auto totalLength = numNotes * noteLength + tailLength;
+        for (auto pos = 0; pos < totalLength && ok; pos += buffer.getNumSamples())
+        {
+            auto numSamples = juce::jmin(buffer.getNumSamples(), totalLength - pos);
+            blockMidi.clear();
+            blockMidi.addEvents(quizMidi, pos, numSamples, -pos);
+
+            buffer.clear();
+            synth.renderNextBlock(buffer, blockMidi, 0, numSamples);
+            ok = sink(static_cast<const juce::AudioSampleBuffer &>(buffer), numSamples);
+        }
+
+        synth.allNotesOff(0, false);
+        return ok;
+    }
+
+private:
+    InstrumentSynth instruments;
+    ParallelSynthesiser &synth;
+    juce::AudioSampleBuffer buffer;
+    juce::MidiBuffer quizMidi, blockMidi;
+    int noteLength = 0, tailLength = 0;
+};
+
+// Renders every level x key combination to individual audio files in
+// parallel and writes a CSV manifest with the expected answers.
+class BatchExporter
+{
+public:
+    struct Settings
+    {
+        juce::File directory;
+        juce::String format = "wav";
+        int quizzesPerCombination = 1;
+        int numThreads = juce::SystemStats::getNumCpus();
+        double sampleRate = 44100.0;
+        int blockSize = 512;
+        int instrument = -1; // see QuizRenderer
+        juce::int64 seed = 1;
+    };
+
+    struct Result
+    {
+        int numQuizzes = 0;
+        int numFailed = 0;
+        double seconds = 0.0;
+    };
+
+    static Result run(const Settings &settings)
+    {
+        BatchExporter exporter(settings);
+        return exporter.runJobs();
+    }
+
+private:
+    explicit BatchExporter(const Settings &s)
+        : settings(s),
+          numQuizzes(QuizGenerator::numLevels * 12 * s.quizzesPerCombination),
+          manifest((size_t)numQuizzes)
+    {
+    }
+
+    class ExportJob : public juce::ThreadPoolJob
+    {
+    public:
+        explicit ExportJob(BatchExporter &e) : juce::ThreadPoolJob("Quiz export"), owner(e) {}
+
+        JobStatus runJob() override
+        {
+            QuizRenderer renderer(owner.settings.sampleRate, owner.settings.blockSize, owner.settings.instrument);
+
+            for (;;)
+            {
+                auto index = owner.nextQuiz++;
+                if (index >= owner.numQuizzes || shouldExit())
+                    break;
+
+                if (!owner.exportQuiz(renderer, index))
+                    ++owner.numFailed;
+            }
+            return jobHasFinished;
+        }
+
+    private:
+        BatchExporter &owner;
+    };
+
+    Result runJobs()
+    {
+        settings.directory.createDirectory();
+
+        auto start = juce::Time::getMillisecondCounterHiRes();
+        {
+            auto numThreads = juce::jmax(1, settings.numThreads);
+            juce::ThreadPool pool(numThreads);
+            juce::OwnedArray<ExportJob> jobs;
+
+            for (auto i = 0; i < numThreads; ++i)
+                pool.addJob(jobs.add(new ExportJob(*this)), false);
+
+            for (auto *job : jobs)
+                pool.waitForJobToFinish(job, -1);
+        }
+
+        Result result;
+        result.numQuizzes = numQuizzes;
+        result.numFailed = numFailed;
+        result.seconds = (juce::Time::getMillisecondCounterHiRes() - start) * 0.001;
+
+        writeManifest();
+        return result;
+    }
+
+    bool exportQuiz(QuizRenderer &renderer, int index)
+    {
+        auto combination = index / settings.quizzesPerCombination;
+        auto level = combination / 12 + 1;
+        auto key = combination % 12;
+
+        int quiz[QuizGenerator::maxQuizLength] = {};
+        QuizGenerator generator(settings.seed * 1000003 + index);
+        generator.generate(level, 60 + key, quiz);
+
+        auto fileName = juce::String::formatted("quiz_%05d.", index) + settings.format;
+        auto file = settings.directory.getChildFile(fileName);
+        file.deleteFile();
+
+        auto writer = createWriter(file);
+        if (writer == nullptr || !renderer.render(quiz, *writer))
+            return false;
+
+        juce::StringArray names;
+        juce::String notes;
+        for (auto i = 0; i < QuizGenerator::maxQuizLength && quiz[i]; ++i)
+        {
+            notes << (i ? " " : "") << quiz[i];
+            names.add(juce::MidiMessage::getMidiNoteName(quiz[i], true, true, 3));
+        }
+        manifest[(size_t)index] = fileName + "," + juce::String(level) + "," + juce::String(key) + ","
+                                  + notes + "," + names.joinIntoString(" ");
+        return true;
+    }
+
+    std::unique_ptr<juce::AudioFormatWriter> createWriter(const juce::File &file) const
+    {
+        std::unique_ptr<juce::AudioFormat> format;
+        if (settings.format == "flac")
+            format.reset(new juce::FlacAudioFormat());
+        else
+            format.reset(new juce::WavAudioFormat());
+
+        std::unique_ptr<juce::FileOutputStream> stream(file.createOutputStream());
+        if (stream == nullptr)
+            return nullptr;
+
+        std::unique_ptr<juce::AudioFormatWriter> writer(format->createWriterFor(stream.get(), settings.sampleRate,
+                                                                                 1, 16, {}, 0));
+        if (writer != nullptr)
+            stream.release();
+
+        return writer;
+    }
+
+    void writeManifest() const
+    {
+        auto file = settings.directory.getChildFile("manifest.csv");
+        file.deleteFile();
+        juce::FileOutputStream out(file);
+        if (!out.openedOk())
+            return;
+
+        out << "file,level,key,notes,names" << juce::newLine;
+        for (auto &line : manifest)
+            if (line.isNotEmpty())
+                out << line << juce::newLine;
+    }
+
+    Settings settings;
+    const int numQuizzes;
+    std::vector<juce::String> manifest;
+    std::atomic<int> nextQuiz{0};
+    std::atomic<int> numFailed{0};
+
+    JUCE_DECLARE_NON_COPYABLE(BatchExporter)
+};
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "HeadlessCommand.h"
+#include "BatchExporter.h"
+
+// Headless modes for BatchExporter: the export itself and its thread scaling.
+class BatchExporterCommands : private HeadlessCommand
+{
+public:
+    static void addTo(juce::ConsoleApplication &app)
+    {
+        app.addCommand({"--export",
+                        "--export <directory> [--count=N] [--format=wav|flac] [--threads=N] [--instrument=N]",
+                        "Renders quizzes for every level and key to audio files.",
+                        "Writes one file per quiz plus manifest.csv with the expected answers. --instrument picks 0 sine, "
+                        "1 sampled piano, 2 plucked string or 3 modal piano; by default the app's instrument is used.",
+                        [](const juce::ArgumentList &a) { exportQuizzes(a); }});
+        app.addCommand({"--export-scaling",
+                        "--export-scaling [--count=N] [--format=wav|flac] [--instrument=N]",
+                        "Measures batch export throughput from 1 to N threads.",
+                        {},
+                        [](const juce::ArgumentList &a) { exportScaling(a); }});
+    }
+
+private:
+    static BatchExporter::Settings getExportSettings(const juce::ArgumentList &args)
+    {
+        BatchExporter::Settings settings;
+        settings.quizzesPerCombination = juce::jmax(1, getIntOption(args, "--count", 1));
+        settings.numThreads = juce::jmax(1, getIntOption(args, "--threads", settings.numThreads));
+        settings.instrument = juce::jlimit(-1, 3, getIntOption(args, "--instrument", settings.instrument));
+        if (args.containsOption("--format"))
+            settings.format = args.getValueForOption("--format").toLowerCase();
+
+        if (settings.format != "wav" && settings.format != "flac")
+            juce::ConsoleApplication::fail("Unknown format: " + settings.format);
+
+        return settings;
+    }
+
+    static void exportQuizzes(const juce::ArgumentList &args)
+    {
+        args.checkMinNumArguments(2);
+        auto settings = getExportSettings(args);
+        settings.directory = args[1].resolveAsFile();
+
+        auto result = BatchExporter::run(settings);
+        std::cout << "Exported " << result.numQuizzes - result.numFailed << " quizzes to "
+                  << settings.directory.getFullPathName() << " in " << result.seconds << " s" << std::endl;
+
+        if (result.numFailed > 0)
+            juce::ConsoleApplication::fail(juce::String(result.numFailed) + " quizzes could not be written");
+    }
+
+    static void exportScaling(const juce::ArgumentList &args)
+    {
+        auto settings = getExportSettings(args);
+        settings.quizzesPerCombination = juce::jmax(1, getIntOption(args, "--count", 20));
+        auto tempDir = juce::File::createTempFile("SenseTrainerExport");
+
+        juce::Array<int> threadCounts;
+        for (auto n = 1; n < juce::SystemStats::getNumCpus(); n *= 2)
+            threadCounts.add(n);
+        threadCounts.add(juce::SystemStats::getNumCpus());
+
+        double baseline = 0.0;
+        std::cout << "threads  quizzes/s  speedup" << std::endl;
+        for (auto n : threadCounts)
+        {
+            settings.numThreads = n;
+            settings.directory = tempDir.getChildFile(juce::String(n));
+
+            auto result = BatchExporter::run(settings);
+            auto rate = result.numQuizzes / juce::jmax(1.0e-9, result.seconds);
+            if (baseline == 0.0)
+                baseline = rate;
+
+            std::cout << juce::String(n).paddedLeft(' ', 7) << "  "
+                      << juce::String(rate, 1).paddedLeft(' ', 9) << "  "
+                      << juce::String(rate / baseline, 2).paddedLeft(' ', 7) << std::endl;
+
+            settings.directory.deleteRecursively();
+        }
+        tempDir.deleteRecursively();
+    }
+};
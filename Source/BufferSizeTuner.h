@@ -0,0 +1,293 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <functional>
+
+// Times the audio callback. begin/end are called from the audio thread
+// around the render; the counters are read from the message thread.
+class CallbackMonitor
+{
+public:
+    struct Snapshot
+    {
+        juce::int64 callbacks = 0, lateCallbacks = 0, busyTicks = 0, budgetTicks = 0;
+    };
+
+    // Call while the device is stopped, e.g. from prepareToPlay.
+    void prepare(int blockSize, double sampleRate)
+    {
+        ticksPerSample = (double)juce::Time::getHighResolutionTicksPerSecond() / sampleRate;
+        nominalTicks = (juce::int64)(blockSize * ticksPerSample);
+        lastStart = 0;
+    }
+
+    juce::int64 begin()
+    {
+        auto now = juce::Time::getHighResolutionTicks();
+
+        // A callback two periods late means the device has run dry in between.
+        if (lastStart != 0 && now - lastStart > 2 * nominalTicks)
+            lateCallbacks.fetch_add(1, std::memory_order_relaxed);
+
+        lastStart = now;
+        return now;
+    }
+
+    void end(juce::int64 startTicks, int numSamples)
+    {
+        auto busy = juce::Time::getHighResolutionTicks() - startTicks;
+        auto budget = (juce::int64)(numSamples * ticksPerSample);
+
+        callbacks.fetch_add(1, std::memory_order_relaxed);
+        busyTicks.fetch_add(busy, std::memory_order_relaxed);
+        budgetTicks.fetch_add(budget, std::memory_order_relaxed);
+
+        auto load = budget > 0 ? (float)busy / (float)budget : 0.0f;
+        auto peak = peakLoad.load(std::memory_order_relaxed);
+        while (load > peak && !peakLoad.compare_exchange_weak(peak, load, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    Snapshot snapshot() const
+    {
+        return {callbacks.load(), lateCallbacks.load(), busyTicks.load(), budgetTicks.load()};
+    }
+
+    // Highest fraction of the block period spent rendering since the last call.
+    float takePeakLoad() { return peakLoad.exchange(0.0f); }
+
+private:
+    double ticksPerSample = 0.0;
+    juce::int64 nominalTicks = 0, lastStart = 0;
+    std::atomic<juce::int64> callbacks{0}, lateCallbacks{0}, busyTicks{0}, budgetTicks{0};
+    std::atomic<float> peakLoad{0.0f};
+};
+
+// Steps the audio device down through its buffer sizes while a synth load
+// runs, and settles on the smallest one that plays without xruns and with
+// headroom to spare. The chosen size is played again for longer before it
+// is accepted, stepping back up if it glitches.
+class BufferSizeTuner : private juce::Timer
+{
+public:
+    // Peak callback load a size may reach and still count as stable.
+    static constexpr float maxLoad = 0.6f;
+
+    struct Trial
+    {
+        int bufferSize = 0;
+        juce::int64 xruns = 0;
+        float peakLoad = 0.0f;
+        double meanLoad = 0.0;
+        bool stable = false;
+    };
+
+    struct Result
+    {
+        bool ok = false;
+        juce::String deviceName;
+        double sampleRate = 44100.0;
+        int bufferSize = 0;
+        juce::Array<Trial> trials;
+
+        juce::String describe() const
+        {
+            juce::String text;
+            for (auto &t : trials)
+                text << juce::String(t.bufferSize).paddedLeft(' ', 5) << " samples: peak load "
+                     << juce::roundToInt(t.peakLoad * 100.0f) << "%, mean " << juce::roundToInt(t.meanLoad * 100.0)
+                     << "%, xruns " << (int)t.xruns << (t.stable ? "" : " (unstable)") << juce::newLine;
+            return text;
+        }
+    };
+
+    // A key press waits up to one buffer to be rendered, then one buffer
+    // plus the device's output latency to be heard.
+    static double keyToSoundMs(int bufferSize, int outputLatencySamples, double sampleRate, double midiInputMs)
+    {
+        return midiInputMs + (2.0 * bufferSize + outputLatencySamples) * 1000.0 / sampleRate;
+    }
+
+    BufferSizeTuner(juce::AudioDeviceManager &manager, CallbackMonitor &callbackMonitor)
+        : deviceManager(manager), monitor(callbackMonitor)
+    {
+    }
+
+    ~BufferSizeTuner() override { stopTimer(); }
+
+    // Switches the test load on and off; called on the message thread.
+    std::function<void(bool)> onLoadChanged;
+    std::function<void(const Result &)> onFinished;
+
+    int settleMs = 300, measureMs = 1500, confirmMs = 4000;
+
+    bool isRunning() const { return phase != Phase::idle; }
+
+    // Runs from a timer; headless callers without a message loop can call
+    // advance() themselves instead.
+    bool start()
+    {
+        auto *device = deviceManager.getCurrentAudioDevice();
+        if (device == nullptr || isRunning())
+            return false;
+
+        result = {};
+        result.deviceName = device->getName();
+        result.sampleRate = device->getCurrentSampleRate();
+
+        available = device->getAvailableBufferSizes();
+        available.sort();
+        auto initial = device->getCurrentBufferSizeSamples();
+
+        // Roughly halve each step so a long list of sizes doesn't take minutes.
+        candidates.clearQuick();
+        for (auto i = available.size(); --i >= 0;)
+        {
+            auto size = available[i];
+            if (size <= initial && size >= 16 && (candidates.isEmpty() || size <= candidates.getLast() * 3 / 4))
+                candidates.add(size);
+        }
+        if (candidates.isEmpty())
+            candidates.add(initial);
+
+        if (onLoadChanged)
+            onLoadChanged(true);
+
+        nextCandidate = 0;
+        confirming = false;
+        tryBufferSize(candidates[nextCandidate++]);
+        startTimer(50);
+        return true;
+    }
+
+    void advance()
+    {
+        auto elapsed = (int)(juce::Time::getMillisecondCounter() - phaseStart);
+        auto *device = deviceManager.getCurrentAudioDevice();
+        if (phase == Phase::idle)
+            return;
+
+        if (device == nullptr)
+        {
+            finish();
+            return;
+        }
+
+        if (phase == Phase::settling && elapsed >= settleMs)
+        {
+            startSnapshot = monitor.snapshot();
+            startDeviceXruns = device->getXRunCount();
+            monitor.takePeakLoad();
+            phase = Phase::measuring;
+            phaseStart = juce::Time::getMillisecondCounter();
+        }
+        else if (phase == Phase::measuring && elapsed >= (confirming ? confirmMs : measureMs))
+        {
+            finishTrial(measure(*device));
+        }
+    }
+
+private:
+    enum class Phase
+    {
+        idle,
+        settling,
+        measuring
+    };
+
+    void timerCallback() override { advance(); }
+
+    void tryBufferSize(int size)
+    {
+        auto setup = deviceManager.getAudioDeviceSetup();
+        setup.bufferSize = size;
+        deviceManager.setAudioDeviceSetup(setup, true);
+
+        phase = Phase::settling;
+        phaseStart = juce::Time::getMillisecondCounter();
+    }
+
+    Trial measure(juce::AudioIODevice &device)
+    {
+        auto now = monitor.snapshot();
+        auto deviceXruns = device.getXRunCount();
+
+        Trial trial;
+        trial.bufferSize = device.getCurrentBufferSizeSamples();
+        trial.peakLoad = monitor.takePeakLoad();
+        trial.meanLoad = now.budgetTicks > startSnapshot.budgetTicks
+                             ? (double)(now.busyTicks - startSnapshot.busyTicks) / (double)(now.budgetTicks - startSnapshot.budgetTicks)
+                             : 1.0;
+
+        // Not every driver counts xruns; late callbacks catch the rest.
+        trial.xruns = now.lateCallbacks - startSnapshot.lateCallbacks;
+        if (deviceXruns >= 0 && startDeviceXruns >= 0)
+            trial.xruns += juce::jmax(0, deviceXruns - startDeviceXruns);
+
+        trial.stable = now.callbacks > startSnapshot.callbacks && trial.xruns == 0 && trial.peakLoad <= maxLoad;
+        return trial;
+    }
+
+    void finishTrial(const Trial &trial)
+    {
+        result.trials.add(trial);
+
+        if (!confirming)
+        {
+            if (trial.stable && nextCandidate < candidates.size())
+            {
+                tryBufferSize(candidates[nextCandidate++]);
+                return;
+            }
+
+            // Sizes were tried largest first, so the last stable one is the smallest.
+            auto chosen = candidates.getFirst();
+            for (auto &t : result.trials)
+                if (t.stable)
+                    chosen = t.bufferSize;
+
+            confirming = true;
+            tryBufferSize(chosen);
+            return;
+        }
+
+        if (!trial.stable)
+        {
+            for (auto size : available)
+            {
+                if (size > trial.bufferSize)
+                {
+                    tryBufferSize(size);
+                    return;
+                }
+            }
+        }
+
+        result.ok = trial.stable;
+        result.bufferSize = trial.bufferSize;
+        finish();
+    }
+
+    void finish()
+    {
+        stopTimer();
+        phase = Phase::idle;
+
+        if (onLoadChanged)
+            onLoadChanged(false);
+        if (onFinished)
+            onFinished(result);
+    }
+
+    juce::AudioDeviceManager &deviceManager;
+    CallbackMonitor &monitor;
+    Result result;
+    juce::Array<int> available, candidates;
+    int nextCandidate = 0;
+    bool confirming = false;
+    Phase phase = Phase::idle;
+    juce::uint32 phaseStart = 0;
+    CallbackMonitor::Snapshot startSnapshot;
+    int startDeviceXruns = -1;
+};
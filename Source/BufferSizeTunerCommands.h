@@ -0,0 +1,72 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "HeadlessCommand.h"
+#include "BufferSizeTuner.h"
+#include "LatencyCalibration.h"
+#include "SynthLoad.h"
+
+// Headless mode for BufferSizeTuner: tunes the default device and stores the result.
+class BufferSizeTunerCommands : private HeadlessCommand
+{
+public:
+    static void addTo(juce::ConsoleApplication &app)
+    {
+        app.addCommand({"--buffer-tune",
+                        "--buffer-tune [--voices=N]",
+                        "Finds the smallest stable buffer size for the default audio device under a synth load.",
+                        "Stores the size for the device and reports the key-to-sound latency it gives.",
+                        [](const juce::ArgumentList &a) { bufferTune(a); }});
+    }
+
+private:
+    static void bufferTune(const juce::ArgumentList &args)
+    {
+        juce::AudioDeviceManager devices;
+        auto error = devices.initialiseWithDefaultDevices(0, 2);
+        if (error.isNotEmpty() || devices.getCurrentAudioDevice() == nullptr)
+            juce::ConsoleApplication::fail("Could not open an audio device: " + error);
+
+        SynthLoad load(juce::jmax(1, getIntOption(args, "--voices", 16)));
+        juce::AudioSourcePlayer player;
+        player.setSource(&load);
+        devices.addAudioCallback(&player);
+
+        BufferSizeTuner tuner(devices, load.monitor);
+        BufferSizeTuner::Result result;
+        auto finished = false;
+        tuner.onLoadChanged = [&load](bool on) { load.active = on; };
+        tuner.onFinished = [&](const BufferSizeTuner::Result &r)
+        {
+            result = r;
+            finished = true;
+        };
+
+        std::cout << "Tuning " << devices.getCurrentAudioDevice()->getName() << " at "
+                  << devices.getCurrentAudioDevice()->getCurrentSampleRate() << " Hz" << std::endl;
+        tuner.start();
+        while (!finished)
+        {
+            juce::Thread::sleep(20);
+            tuner.advance();
+        }
+
+        std::cout << result.describe();
+        auto *device = devices.getCurrentAudioDevice();
+        devices.removeAudioCallback(&player);
+        if (!result.ok || device == nullptr)
+            juce::ConsoleApplication::fail("No stable buffer size found");
+
+        LatencyProfiles profiles;
+        profiles.load(LatencyProfiles::getDefaultFile());
+        profiles.setBufferSize(result.deviceName, result.sampleRate, result.bufferSize);
+        profiles.save(LatencyProfiles::getDefaultFile());
+
+        LatencyProfiles::AudioLatency measured;
+        auto outputLatency = profiles.getAudio(result.deviceName, measured) ? juce::roundToInt(measured.outputMs * 0.001 * result.sampleRate)
+                                                                            : device->getOutputLatencyInSamples();
+        std::cout << "chose " << result.bufferSize << " samples; key-to-sound latency about "
+                  << juce::String(BufferSizeTuner::keyToSoundMs(result.bufferSize, outputLatency, result.sampleRate, 0.0), 1)
+                  << " ms plus MIDI input latency" << std::endl;
+    }
+};
@@ -0,0 +1,32 @@
+/*
+  ==============================================================================
+
+    Entry point of SenseTrainerCli (Cli/SenseTrainerCli.jucer): the headless
+    modes of the main application, built without any GUI module. That keeps
+    the quiz, grading and synthesis headers they use free of GUI
+    dependencies.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "HeadlessCommands.h"
+
+#if JUCE_MODULE_AVAILABLE_juce_gui_basics
+ #error "SenseTrainerCli must not depend on juce_gui_basics"
+#endif
+
+int main(int argc, char *argv[])
+{
+    // Timers and device callbacks still need a message manager on this thread.
+    juce::MessageManager::getInstance();
+
+    juce::ArgumentList args(argc, argv);
+    auto result = 0;
+    if (!HeadlessCommands::run(args, result))
+        HeadlessCommands::run(juce::ArgumentList(args.executableName, "--help"), result);
+
+    juce::DeletedAtShutdown::deleteAll();
+    juce::MessageManager::deleteInstance();
+    return result;
+}
@@ -0,0 +1,325 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "DspKernels.h"
+#include "RealtimeThreads.h"
+
+// Uniformly partitioned overlap-save convolution of one IR segment. Each
+// call consumes exactly one partition of input and produces the matching
+// partition of output.
+class PartitionedConvolver
+{
+public:
+    void prepare(const float *ir, int irLength, int partitionSize)
+    {
+        blockSize = partitionSize;
+        numBins = blockSize + 1;
+        numPartitions = juce::jmax(1, (irLength + blockSize - 1) / blockSize);
+        fft.reset(new juce::dsp::FFT(juce::roundToInt(std::log2(2 * blockSize))));
+
+        irSpectra.assign((size_t)(numPartitions * 2 * numBins), 0.0f);
+        fdl.assign(irSpectra.size(), 0.0f);
+        input.assign((size_t)(2 * blockSize), 0.0f);
+        work.assign((size_t)(4 * blockSize), 0.0f);
+        fdlPos = 0;
+
+        for (auto p = 0; p < numPartitions; ++p)
+        {
+            std::fill(work.begin(), work.end(), 0.0f);
+            auto n = juce::jmin(blockSize, irLength - p * blockSize);
+            if (n > 0)
+                std::copy(ir + p * blockSize, ir + p * blockSize + n, work.begin());
+            fft->performRealOnlyForwardTransform(work.data(), true);
+            std::copy(work.begin(), work.begin() + 2 * numBins, irSpectra.begin() + p * 2 * numBins);
+        }
+    }
+
+    void reset()
+    {
+        std::fill(fdl.begin(), fdl.end(), 0.0f);
+        std::fill(input.begin(), input.end(), 0.0f);
+    }
+
+    void processBlock(const float *in, float *out)
+    {
+        std::copy(input.begin() + blockSize, input.end(), input.begin());
+        std::copy(in, in + blockSize, input.begin() + blockSize);
+
+        std::fill(work.begin(), work.end(), 0.0f);
+        std::copy(input.begin(), input.end(), work.begin());
+        fft->performRealOnlyForwardTransform(work.data(), true);
+
+        fdlPos = (fdlPos + 1) % numPartitions;
+        std::copy(work.begin(), work.begin() + 2 * numBins, fdl.begin() + fdlPos * 2 * numBins);
+
+        std::fill(work.begin(), work.end(), 0.0f);
+        for (auto p = 0; p < numPartitions; ++p)
+        {
+            auto slot = (fdlPos - p + numPartitions) % numPartitions;
+            DspKernels::complexMultiplyAccumulate(work.data(), fdl.data() + slot * 2 * numBins,
+                                                  irSpectra.data() + p * 2 * numBins, numBins);
+        }
+
+        fft->performRealOnlyInverseTransform(work.data());
+        std::copy(work.begin() + blockSize, work.begin() + 2 * blockSize, out);
+    }
+
+    int getBlockSize() const { return blockSize; }
+
+private:
+    int blockSize = 0, numBins = 0, numPartitions = 0, fdlPos = 0;
+    std::unique_ptr<juce::dsp::FFT> fft;
+    std::vector<float> irSpectra, fdl, input, work;
+};
+
+// Zero-latency convolution of one channel, split in three stages:
+//   head  IR[0, B)      direct-form FIR on the audio thread, one
+//                       DspKernels::dotProduct per sample
+//   body  IR[B, 2T)     partition B on the audio thread (its B-sample
+//                       latency is hidden by the segment offset)
+//   tail  IR[2T, end)   partition T on the reverb thread, which has one
+//                       full tail block of slack before its output is due
+class ChannelConvolver
+{
+public:
+    static constexpr int numTailSlots = 4;
+
+    void prepare(const float *ir, int irLength, int headSize, int tailSize)
+    {
+        B = headSize;
+        T = tailSize;
+
+        head.assign(ir, ir + juce::jmin(irLength, B));
+        head.resize((size_t)B, 0.0f);
+        std::reverse(head.begin(), head.end());
+        history.assign((size_t)(2 * B), 0.0f);
+
+        auto bodyLength = juce::jlimit(0, 2 * T - B, irLength - B);
+        hasBody = bodyLength > 0;
+        if (hasBody)
+            body.prepare(ir + B, bodyLength, B);
+        bodyIn.assign((size_t)B, 0.0f);
+        bodyOut.assign((size_t)B, 0.0f);
+
+        hasTail = irLength > 2 * T;
+        if (hasTail)
+            tail.prepare(ir + 2 * T, irLength - 2 * T, T);
+        tailAccum.assign((size_t)T, 0.0f);
+        for (auto &slot : tailIn)
+            slot.assign((size_t)T, 0.0f);
+        for (auto &slot : tailOut)
+            slot.assign((size_t)T, 0.0f);
+
+        bodyPos = tailPos = 0;
+        tailBlock = 0;
+        tailSubmitted = tailCompleted = 0;
+    }
+
+    // Adds the wet signal for in[0..n) to out[0..n). Returns true if a tail
+    // block was handed to the reverb thread.
+    bool process(const float *in, float *out, int n, float wetGain)
+    {
+        auto submitted = false;
+        for (auto done = 0; done < n;)
+        {
+            auto k = juce::jmin(n - done, B - bodyPos, T - tailPos);
+
+            // Head: y[j] = sum h[i] x[j - i] over the newest B input samples.
+            std::copy(in + done, in + done + k, history.begin() + (B - 1));
+            for (auto j = 0; j < k; ++j)
+                out[done + j] += wetGain * DspKernels::dotProduct(head.data(), history.data() + j, B);
+            std::copy(history.begin() + k, history.begin() + k + (B - 1), history.begin());
+
+            if (hasBody)
+                juce::FloatVectorOperations::addWithMultiply(out + done, bodyOut.data() + bodyPos, wetGain, k);
+
+            if (hasTail && tailBlock >= 2)
+            {
+                if (tailCompleted.load(std::memory_order_acquire) > tailBlock - 2)
+                    juce::FloatVectorOperations::addWithMultiply(out + done, tailOut[(size_t)((tailBlock - 2) % numTailSlots)].data() + tailPos, wetGain, k);
+                else if (tailPos == 0)
+                    ++lateTailBlocks;
+            }
+
+            std::copy(in + done, in + done + k, bodyIn.begin() + bodyPos);
+            std::copy(in + done, in + done + k, tailAccum.begin() + tailPos);
+            bodyPos += k;
+            tailPos += k;
+            done += k;
+
+            if (bodyPos == B)
+            {
+                if (hasBody)
+                    body.processBlock(bodyIn.data(), bodyOut.data());
+                bodyPos = 0;
+            }
+
+            if (tailPos == T)
+            {
+                std::copy(tailAccum.begin(), tailAccum.end(), tailIn[(size_t)(tailBlock % numTailSlots)].begin());
+                tailSubmitted.store(tailBlock + 1, std::memory_order_release);
+                ++tailBlock;
+                tailPos = 0;
+                if (inlineTail)
+                    processTail();
+                else
+                    submitted = true;
+            }
+        }
+        return submitted;
+    }
+
+    // Called on the reverb thread; returns true if a block was processed.
+    bool processTail()
+    {
+        auto next = tailCompleted.load(std::memory_order_relaxed);
+        if (!hasTail || next >= tailSubmitted.load(std::memory_order_acquire))
+            return false;
+
+        tail.processBlock(tailIn[(size_t)(next % numTailSlots)].data(), tailOut[(size_t)(next % numTailSlots)].data());
+        tailCompleted.store(next + 1, std::memory_order_release);
+        return true;
+    }
+
+    std::atomic<int> lateTailBlocks{0};
+    // Offline rendering runs faster than the reverb thread could keep up with.
+    bool inlineTail = false;
+
+private:
+    int B = 64, T = 1024;
+    std::vector<float> head, history, bodyIn, bodyOut, tailAccum;
+    std::vector<float> tailIn[numTailSlots], tailOut[numTailSlots];
+    PartitionedConvolver body, tail;
+    bool hasBody = false, hasTail = false;
+    int bodyPos = 0, tailPos = 0;
+    juce::int64 tailBlock = 0;
+    std::atomic<juce::int64> tailSubmitted{0}, tailCompleted{0};
+};
+
+// Convolution reverb applied in place to the synth output. The IR is read
+// from a WAV file; tail partitions are computed on a background thread.
+class ConvolutionReverb : private juce::Thread
+{
+public:
+    ConvolutionReverb() : juce::Thread("Convolution reverb") {}
+
+    ~ConvolutionReverb() override
+    {
+        stopThread(2000);
+    }
+
+    bool loadImpulseResponse(const juce::File &file)
+    {
+        juce::AudioFormatManager formats;
+        formats.registerBasicFormats();
+        std::unique_ptr<juce::AudioFormatReader> reader(formats.createReaderFor(file));
+        if (reader == nullptr)
+            return false;
+
+        juce::AudioSampleBuffer ir(juce::jmin(2, (int)reader->numChannels), (int)reader->lengthInSamples);
+        reader->read(&ir, 0, ir.getNumSamples(), 0, true, ir.getNumChannels() > 1);
+        setImpulseResponse(ir);
+        return true;
+    }
+
+    // Must be called before prepare(), or while audio is stopped.
+    void setImpulseResponse(const juce::AudioSampleBuffer &ir)
+    {
+        impulseResponse.makeCopyOf(ir);
+    }
+
+    bool isActive() const { return active; }
+    int getImpulseResponseLength() const { return impulseResponse.getNumSamples(); }
+
+    // When rendering offline, tail partitions are computed in process()
+    // instead of on the reverb thread. Call before prepare().
+    void setNonRealtime(bool isNonRealtime) { nonRealtime = isNonRealtime; }
+
+    void prepare(int samplesPerBlockExpected, int numChannels)
+    {
+        stopThread(2000);
+        active = impulseResponse.getNumSamples() > 0;
+        if (!active)
+            return;
+
+        // Head/body partition follows the device block size; the tail uses
+        // partitions large enough to keep the FFT count low.
+        auto headSize = juce::jlimit(32, 512, (int)juce::nextPowerOfTwo(samplesPerBlockExpected));
+        auto tailSize = juce::jmax(1024, headSize * 16);
+
+        channels.clear();
+        for (auto ch = 0; ch < numChannels; ++ch)
+        {
+            auto *channel = channels.add(new ChannelConvolver());
+            auto irChannel = juce::jmin(ch, impulseResponse.getNumChannels() - 1);
+            channel->prepare(impulseResponse.getReadPointer(irChannel), impulseResponse.getNumSamples(), headSize, tailSize);
+            channel->inlineTail = nonRealtime;
+        }
+        dry.setSize(1, juce::jmax(samplesPerBlockExpected, 4096));
+
+        if (!nonRealtime)
+            startThread(8);
+    }
+
+    void process(juce::AudioSampleBuffer &buffer, int startSample, int numSamples)
+    {
+        if (!active)
+            return;
+
+        auto submitted = false;
+        for (auto ch = 0; ch < juce::jmin(buffer.getNumChannels(), channels.size()); ++ch)
+        {
+            auto *data = buffer.getWritePointer(ch, startSample);
+            for (auto done = 0; done < numSamples;)
+            {
+                auto n = juce::jmin(numSamples - done, dry.getNumSamples());
+                dry.copyFrom(0, 0, data + done, n);
+                submitted = channels[ch]->process(dry.getReadPointer(0), data + done, n, wetGain) || submitted;
+                done += n;
+            }
+        }
+
+        // Once per tail partition, so the thread sleeps between them.
+        if (submitted)
+            notify();
+    }
+
+    void setWetGain(float gain) { wetGain = gain; }
+
+    int getLateTailBlocks() const
+    {
+        auto total = 0;
+        for (auto *channel : channels)
+            total += channel->lateTailBlocks.load();
+        return total;
+    }
+
+    static juce::File getDefaultImpulseResponse()
+    {
+        return juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+            .getChildFile("SenseTrainer")
+            .getChildFile("Reverb.wav");
+    }
+
+private:
+    void run() override
+    {
+        RealtimeThreads::getInstance().enterRealtime(RealtimeThreads::Role::reverbTail, 0);
+        while (!threadShouldExit())
+        {
+            auto didWork = false;
+            for (auto *channel : channels)
+                while (channel->processTail())
+                    didWork = true;
+
+            // notify() from process() ends the wait; stopThread() does too.
+            if (!didWork)
+                wait(-1);
+        }
+    }
+
+    juce::AudioSampleBuffer impulseResponse, dry;
+    juce::OwnedArray<ChannelConvolver> channels;
+    float wetGain = 0.3f;
+    bool active = false, nonRealtime = false;
+};
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "HeadlessCommand.h"
+#include "ConvolutionReverb.h"
+
+// Headless mode for the convolution reverb: its cost per block.
+class ConvolutionReverbCommands : private HeadlessCommand
+{
+public:
+    static void addTo(juce::ConsoleApplication &app)
+    {
+        app.addCommand({"--reverb-bench",
+                        "--reverb-bench [--block=N] [--seconds=N]",
+                        "Measures convolution reverb cost for 1 s and 4 s impulse responses.",
+                        {},
+                        [](const juce::ArgumentList &a) { reverbBench(a); }});
+    }
+
+private:
+    static void reverbBench(const juce::ArgumentList &args)
+    {
+        const double sampleRate = 48000.0;
+        auto blockSize = getIntOption(args, "--block", 64);
+        auto seconds = getIntOption(args, "--seconds", 5);
+        auto blockMs = blockSize * 1000.0 / sampleRate;
+        juce::Random random(1);
+
+        std::cout << "IR    block  avg us  max us  budget %  late tail blocks" << std::endl;
+        for (auto irSeconds : {1, 4})
+        {
+            juce::AudioSampleBuffer ir(2, (int)(irSeconds * sampleRate));
+            for (auto ch = 0; ch < 2; ++ch)
+                for (auto i = 0; i < ir.getNumSamples(); ++i)
+                    ir.setSample(ch, i, (random.nextFloat() * 2.0f - 1.0f) * std::exp(-6.9f * (float)i / ir.getNumSamples()));
+
+            ConvolutionReverb reverb;
+            reverb.setImpulseResponse(ir);
+            reverb.prepare(blockSize, 2);
+
+            juce::AudioSampleBuffer buffer(2, blockSize);
+            auto numBlocks = (int)(seconds * sampleRate / blockSize);
+            double total = 0.0, worst = 0.0;
+            auto start = juce::Time::getMillisecondCounterHiRes();
+
+            for (auto b = 0; b < numBlocks; ++b)
+            {
+                for (auto ch = 0; ch < 2; ++ch)
+                    for (auto i = 0; i < blockSize; ++i)
+                        buffer.setSample(ch, i, random.nextFloat() - 0.5f);
+
+                auto t0 = juce::Time::getHighResolutionTicks();
+                reverb.process(buffer, 0, blockSize);
+                auto us = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - t0) * 1.0e6;
+                total += us;
+                worst = juce::jmax(worst, us);
+
+                auto wait = start + (b + 1) * blockMs - juce::Time::getMillisecondCounterHiRes();
+                if (wait > 0)
+                    juce::Thread::sleep((int)wait);
+            }
+
+            auto average = total / numBlocks;
+            std::cout << irSeconds << " s   " << juce::String(blockSize).paddedLeft(' ', 5)
+                      << juce::String(average, 1).paddedLeft(' ', 8)
+                      << juce::String(worst, 1).paddedLeft(' ', 8)
+                      << juce::String(average / (blockMs * 10.0), 1).paddedLeft(' ', 10)
+                      << juce::String(reverb.getLateTailBlocks()).paddedLeft(' ', 18) << std::endl;
+        }
+    }
+};
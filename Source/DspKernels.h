@@ -0,0 +1,460 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+
+#if JUCE_USE_SSE_INTRINSICS
+ #include <immintrin.h>
+#elif JUCE_USE_ARM_NEON
+ #include <arm_neon.h>
+#endif
+
+// Inner loops of the voices, the reverb and the sampled-piano resampler.
+// Each kernel has a scalar reference and one vector version written over a
+// small table of operations (DspKernelsSimd.h), compiled for SSE2, AVX2 and
+// AVX-512 on x86 and for NEON on ARM. The wider x86 sets are built under a
+// target pragma on GCC and Clang (MSVC needs none), so one binary carries
+// them all. prepare() picks a set from the CPUID bits JUCE reads, once per
+// prepareToPlay, and the free functions at the end call through it.
+namespace DspKernels
+{
+// The most modes resonatorBank() runs; the bank is always this size.
+constexpr int maxResonators = 16;
+
+// 4-point, 3rd-order Hermite interpolation. Output i is read at
+// start + i * ratio frames from src[0]; src must be readable from index -1
+// up to two frames past the last read position.
+inline void hermiteResampleScalar(const float *src, float *dst, int numOut, double start, double ratio)
+{
+    for (int i = 0; i < numOut; ++i)
+    {
+        auto pos = start + i * ratio;
+        auto index = (int)pos;
+        auto t = (float)(pos - index);
+        auto *s = src + index;
+        auto c1 = 0.5f * (s[1] - s[-1]);
+        auto c2 = s[-1] - 2.5f * s[0] + 2.0f * s[1] - 0.5f * s[2];
+        auto c3 = 0.5f * (s[2] - s[-1]) + 1.5f * (s[0] - s[1]);
+        dst[i] = ((c3 * t + c2) * t + c1) * t + s[0];
+    }
+}
+
+// acc += a * b over interleaved (re, im) complex arrays.
+inline void complexMultiplyAccumulateScalar(float *acc, const float *a, const float *b, int numComplex)
+{
+    for (int i = 0; i < numComplex; ++i)
+    {
+        auto ar = a[2 * i], ai = a[2 * i + 1], br = b[2 * i], bi = b[2 * i + 1];
+        acc[2 * i] += ar * br - ai * bi;
+        acc[2 * i + 1] += ar * bi + ai * br;
+    }
+}
+
+// The sum of a[i] * b[i], for direct-form FIRs.
+inline float dotProductScalar(const float *a, const float *b, int n)
+{
+    auto sum = 0.0f;
+    for (int i = 0; i < n; ++i)
+        sum += a[i] * b[i];
+    return sum;
+}
+
+// A bank of maxResonators damped resonators driven by one input. Each mode k
+// is a complex one-pole, z = (a[k] + i b[k]) z + input[n], and out[n] += sum
+// of gain[k] * im(z). re and im hold the state between calls; input may be
+// null. Unused modes have zero coefficients and gain.
+inline void resonatorBankScalar(float *re, float *im, const float *a, const float *b, const float *gain,
+                                const float *input, float *out, int numSamples)
+{
+    for (int n = 0; n < numSamples; ++n)
+    {
+        auto x = input != nullptr ? input[n] : 0.0f;
+        auto sum = 0.0f;
+        for (int k = 0; k < maxResonators; ++k)
+        {
+            auto r = a[k] * re[k] - b[k] * im[k] + x;
+            auto i = b[k] * re[k] + a[k] * im[k];
+            re[k] = r;
+            im[k] = i;
+            sum += gain[k] * i;
+        }
+        out[n] += sum;
+    }
+}
+
+// dst[ch][i] += src[ch][i] * gain, with the gain ramping from startGain
+// towards endGain as in AudioBuffer::addFromWithRamp. If there are fewer
+// source channels than destinations the last source channel repeats.
+inline void mixScalar(float *const *dst, int numDst, const float *const *src, int numSrc,
+                      int numSamples, float startGain, float endGain)
+{
+    auto step = numSamples > 0 ? (endGain - startGain) / (float)numSamples : 0.0f;
+    for (int ch = 0; ch < numDst; ++ch)
+    {
+        auto *d = dst[ch];
+        auto *s = src[juce::jmin(ch, numSrc - 1)];
+        for (int i = 0; i < numSamples; ++i)
+            d[i] += s[i] * (startGain + (float)i * step);
+    }
+}
+
+constexpr float laneIndex[16] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+
+enum class Isa
+{
+    scalar,
+    sse2,
+    avx2,
+    avx512,
+    neon
+};
+
+inline const char *getName(Isa isa)
+{
+    const char *names[] = {"scalar", "SSE2", "AVX2", "AVX-512", "NEON"};
+    return names[(int)isa];
+}
+
+template <Isa isa>
+struct Kernels;
+
+template <>
+struct Kernels<Isa::scalar>
+{
+    static void hermiteResample(const float *src, float *dst, int numOut, double start, double ratio)
+    {
+        hermiteResampleScalar(src, dst, numOut, start, ratio);
+    }
+
+    static void complexMultiplyAccumulate(float *acc, const float *a, const float *b, int numComplex)
+    {
+        complexMultiplyAccumulateScalar(acc, a, b, numComplex);
+    }
+
+    static float dotProduct(const float *a, const float *b, int n)
+    {
+        return dotProductScalar(a, b, n);
+    }
+
+    static void resonatorBank(float *re, float *im, const float *a, const float *b, const float *gain,
+                              const float *input, float *out, int numSamples)
+    {
+        resonatorBankScalar(re, im, a, b, gain, input, out, numSamples);
+    }
+
+    template <int numChannels>
+    static void mix(float *const *dst, int numDst, const float *const *src, int numSrc,
+                    int numSamples, float startGain, float endGain)
+    {
+        mixScalar(dst, numDst, src, numSrc, numSamples, startGain, endGain);
+    }
+};
+
+#if JUCE_USE_SSE_INTRINSICS
+namespace Sse2
+{
+struct Ops
+{
+    using V = __m128;
+    static constexpr int width = 4;
+
+    static V load(const float *p) { return _mm_loadu_ps(p); }
+    static void store(float *p, V v) { _mm_storeu_ps(p, v); }
+    static V set1(float x) { return _mm_set1_ps(x); }
+    static V zero() { return _mm_setzero_ps(); }
+    static V add(V a, V b) { return _mm_add_ps(a, b); }
+    static V sub(V a, V b) { return _mm_sub_ps(a, b); }
+    static V mul(V a, V b) { return _mm_mul_ps(a, b); }
+    static V mulAdd(V a, V b, V c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+
+    static float sum(V v)
+    {
+        v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+        return _mm_cvtss_f32(_mm_add_ss(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1))));
+    }
+
+    // Products of interleaved (re, im) pairs.
+    static V complexMultiply(V a, V b)
+    {
+        auto bRe = _mm_shuffle_ps(b, b, _MM_SHUFFLE(2, 2, 0, 0));
+        auto bIm = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 3, 1, 1));
+        auto aSwap = _mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1));
+        return _mm_add_ps(_mm_mul_ps(a, bRe), _mm_mul_ps(_mm_mul_ps(aSwap, bIm), _mm_set_ps(1.0f, -1.0f, 1.0f, -1.0f)));
+    }
+};
+
+#include "DspKernelsSimd.h"
+} // namespace Sse2
+
+ #if defined(__clang__)
+  #pragma clang attribute push(__attribute__((target("avx2,fma"))), apply_to = function)
+ #elif defined(__GNUC__)
+  #pragma GCC push_options
+  #pragma GCC target("avx2,fma")
+ #endif
+namespace Avx2
+{
+struct Ops
+{
+    using V = __m256;
+    static constexpr int width = 8;
+
+    static V load(const float *p) { return _mm256_loadu_ps(p); }
+    static void store(float *p, V v) { _mm256_storeu_ps(p, v); }
+    static V set1(float x) { return _mm256_set1_ps(x); }
+    static V zero() { return _mm256_setzero_ps(); }
+    static V add(V a, V b) { return _mm256_add_ps(a, b); }
+    static V sub(V a, V b) { return _mm256_sub_ps(a, b); }
+    static V mul(V a, V b) { return _mm256_mul_ps(a, b); }
+    static V mulAdd(V a, V b, V c) { return _mm256_fmadd_ps(a, b, c); }
+
+    static float sum(V v)
+    {
+        return Sse2::Ops::sum(_mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1)));
+    }
+
+    // Even lanes take a.re * b.re - a.im * b.im, odd lanes a.im * b.re + a.re * b.im.
+    static V complexMultiply(V a, V b)
+    {
+        return _mm256_fmaddsub_ps(a, _mm256_moveldup_ps(b), _mm256_mul_ps(_mm256_permute_ps(a, 0xb1), _mm256_movehdup_ps(b)));
+    }
+};
+
+#include "DspKernelsSimd.h"
+} // namespace Avx2
+ #if defined(__clang__)
+  #pragma clang attribute pop
+ #elif defined(__GNUC__)
+  #pragma GCC pop_options
+ #endif
+
+ #if defined(__clang__)
+  #pragma clang attribute push(__attribute__((target("avx512f,avx2,fma"))), apply_to = function)
+ #elif defined(__GNUC__)
+  #pragma GCC push_options
+  #pragma GCC target("avx512f,avx2,fma")
+ #endif
+namespace Avx512
+{
+struct Ops
+{
+    using V = __m512;
+    static constexpr int width = 16;
+
+    static V load(const float *p) { return _mm512_loadu_ps(p); }
+    static void store(float *p, V v) { _mm512_storeu_ps(p, v); }
+    static V set1(float x) { return _mm512_set1_ps(x); }
+    static V zero() { return _mm512_setzero_ps(); }
+    static V add(V a, V b) { return _mm512_add_ps(a, b); }
+    static V sub(V a, V b) { return _mm512_sub_ps(a, b); }
+    static V mul(V a, V b) { return _mm512_mul_ps(a, b); }
+    static V mulAdd(V a, V b, V c) { return _mm512_fmadd_ps(a, b, c); }
+
+    // GCC implements the unmasked extract, cast-down, permute and duplicate
+    // intrinsics with a deliberately uninitialised pass-through register,
+    // which -Wmaybe-uninitialized reports in every caller; zero-masked
+    // extracts and two-operand shuffles do the same work without one.
+    static float sum(V v)
+    {
+        auto halves = _mm512_castps_pd(v);
+        auto low = _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xff, halves, 0));
+        auto high = _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xff, halves, 1));
+        return Avx2::Ops::sum(_mm256_add_ps(low, high));
+    }
+
+    static V complexMultiply(V a, V b)
+    {
+        auto bRe = _mm512_shuffle_ps(b, b, _MM_SHUFFLE(2, 2, 0, 0));
+        auto bIm = _mm512_shuffle_ps(b, b, _MM_SHUFFLE(3, 3, 1, 1));
+        return _mm512_fmaddsub_ps(a, bRe, _mm512_mul_ps(_mm512_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1)), bIm));
+    }
+};
+
+#include "DspKernelsSimd.h"
+} // namespace Avx512
+ #if defined(__clang__)
+  #pragma clang attribute pop
+ #elif defined(__GNUC__)
+  #pragma GCC pop_options
+ #endif
+
+template <>
+struct Kernels<Isa::sse2> : Sse2::Impl
+{
+};
+
+template <>
+struct Kernels<Isa::avx2> : Avx2::Impl
+{
+};
+
+template <>
+struct Kernels<Isa::avx512> : Avx512::Impl
+{
+};
+#elif JUCE_USE_ARM_NEON
+namespace Neon
+{
+struct Ops
+{
+    using V = float32x4_t;
+    static constexpr int width = 4;
+
+    static V load(const float *p) { return vld1q_f32(p); }
+    static void store(float *p, V v) { vst1q_f32(p, v); }
+    static V set1(float x) { return vdupq_n_f32(x); }
+    static V zero() { return vdupq_n_f32(0.0f); }
+    static V add(V a, V b) { return vaddq_f32(a, b); }
+    static V sub(V a, V b) { return vsubq_f32(a, b); }
+    static V mul(V a, V b) { return vmulq_f32(a, b); }
+    static V mulAdd(V a, V b, V c) { return vmlaq_f32(c, a, b); }
+
+    static float sum(V v)
+    {
+        auto pair = vpadd_f32(vget_low_f32(v), vget_high_f32(v));
+        return vget_lane_f32(vpadd_f32(pair, pair), 0);
+    }
+
+    static V complexMultiply(V a, V b)
+    {
+        const float sign[] = {-1.0f, 1.0f, -1.0f, 1.0f};
+        auto bSplit = vtrnq_f32(b, b); // (re, re) and (im, im) pairs
+        return vmlaq_f32(vmulq_f32(a, bSplit.val[0]), vmulq_f32(vrev64q_f32(a), bSplit.val[1]), vld1q_f32(sign));
+    }
+};
+
+#include "DspKernelsSimd.h"
+} // namespace Neon
+
+template <>
+struct Kernels<Isa::neon> : Neon::Impl
+{
+};
+#endif
+
+using HermiteResampleFn = void (*)(const float *, float *, int, double, double);
+using ComplexMultiplyAccumulateFn = void (*)(float *, const float *, const float *, int);
+using DotProductFn = float (*)(const float *, const float *, int);
+using ResonatorBankFn = void (*)(float *, float *, const float *, const float *, const float *, const float *, float *, int);
+using MixFn = void (*)(float *const *, int, const float *const *, int, int, float, float);
+
+// One variant of every kernel, for one instruction set and output channel count.
+struct KernelSet
+{
+    Isa isa;
+    int numChannels; // the count mix is specialised for, or 0
+    HermiteResampleFn hermiteResample;
+    ComplexMultiplyAccumulateFn complexMultiplyAccumulate;
+    DotProductFn dotProduct;
+    ResonatorBankFn resonatorBank;
+    MixFn mix, mixAnyChannels;
+
+    // Adds src into dest from startSample on, every destination channel
+    // taking the matching source channel or the last one.
+    void addTo(juce::AudioSampleBuffer &dest, int startSample, const float *const *src, int numSrc,
+               int numSamples, float startGain = 1.0f, float endGain = 1.0f) const
+    {
+        auto numDst = dest.getNumChannels();
+        if (numDst == numChannels && numDst > 0)
+        {
+            float *channels[2] = {dest.getWritePointer(0, startSample), dest.getWritePointer(numDst - 1, startSample)};
+            mix(channels, numDst, src, numSrc, numSamples, startGain, endGain);
+            return;
+        }
+
+        for (auto ch = 0; ch < numDst; ++ch)
+        {
+            auto *channel = dest.getWritePointer(ch, startSample);
+            mixAnyChannels(&channel, 1, src + juce::jmin(ch, numSrc - 1), 1, numSamples, startGain, endGain);
+        }
+    }
+};
+
+template <Isa isa, int numChannels>
+const KernelSet &getKernelSet()
+{
+    using K = Kernels<isa>;
+    static const KernelSet set{isa, numChannels, K::hermiteResample, K::complexMultiplyAccumulate, K::dotProduct, K::resonatorBank,
+                               K::template mix<numChannels>, K::template mix<0>};
+    return set;
+}
+
+template <Isa isa>
+const KernelSet &getKernelSet(int numChannels)
+{
+    return numChannels == 1 ? getKernelSet<isa, 1>() : numChannels == 2 ? getKernelSet<isa, 2>() : getKernelSet<isa, 0>();
+}
+
+// The kernels for isa, or nullptr if this build or CPU lacks it.
+inline const KernelSet *find(Isa isa, int numChannels)
+{
+    switch (isa)
+    {
+    case Isa::scalar:
+        return &getKernelSet<Isa::scalar>(numChannels);
+#if JUCE_USE_SSE_INTRINSICS
+    case Isa::sse2:
+        return &getKernelSet<Isa::sse2>(numChannels);
+    case Isa::avx2:
+        return juce::SystemStats::hasAVX2() && juce::SystemStats::hasFMA3() ? &getKernelSet<Isa::avx2>(numChannels) : nullptr;
+    case Isa::avx512:
+        return juce::SystemStats::hasAVX512F() ? &getKernelSet<Isa::avx512>(numChannels) : nullptr;
+#elif JUCE_USE_ARM_NEON
+    case Isa::neon:
+        return &getKernelSet<Isa::neon>(numChannels);
+#endif
+    default:
+        return nullptr;
+    }
+}
+
+// The widest set the CPU has. Blocks shorter than four AVX-512 vectors leave
+// most of their samples to the scalar tails, so they stay on AVX2.
+inline const KernelSet &select(int numChannels, int blockSize)
+{
+    for (auto isa : {Isa::avx512, Isa::avx2, Isa::sse2, Isa::neon})
+        if (auto *set = find(isa, numChannels))
+            if (isa != Isa::avx512 || blockSize >= 64)
+                return *set;
+
+    return *find(Isa::scalar, numChannels);
+}
+
+inline std::atomic<const KernelSet *> &currentSet()
+{
+    static std::atomic<const KernelSet *> set{&select(2, 512)};
+    return set;
+}
+
+inline const KernelSet &current()
+{
+    return *currentSet().load(std::memory_order_relaxed);
+}
+
+// Call from prepareToPlay with the output channel count and block size.
+inline void prepare(int numChannels, int blockSize)
+{
+    currentSet().store(&select(numChannels, blockSize), std::memory_order_relaxed);
+}
+
+inline void hermiteResample(const float *src, float *dst, int numOut, double start, double ratio)
+{
+    current().hermiteResample(src, dst, numOut, start, ratio);
+}
+
+inline void complexMultiplyAccumulate(float *acc, const float *a, const float *b, int numComplex)
+{
+    current().complexMultiplyAccumulate(acc, a, b, numComplex);
+}
+
+inline float dotProduct(const float *a, const float *b, int n)
+{
+    return current().dotProduct(a, b, n);
+}
+
+inline void resonatorBank(float *re, float *im, const float *a, const float *b, const float *gain,
+                          const float *input, float *out, int numSamples)
+{
+    current().resonatorBank(re, im, a, b, gain, input, out, numSamples);
+}
+} // namespace DspKernels
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <functional>
+#include <vector>
+#include "HeadlessCommand.h"
+#include "DspKernels.h"
+
+// Headless mode for DspKernels: every variant timed and checked against scalar.
+class DspKernelsCommands : private HeadlessCommand
+{
+public:
+    static void addTo(juce::ConsoleApplication &app)
+    {
+        app.addCommand({"--kernel-bench",
+                        "--kernel-bench [--block=N] [--iterations=N]",
+                        "Times every DSP kernel in each instruction-set variant this CPU runs and checks it against the scalar version.",
+                        "Exits with an error if any variant differs from the scalar reference by more than rounding.",
+                        [](const juce::ArgumentList &a) { kernelBench(a); }});
+    }
+
+private:
+    struct KernelRun
+    {
+        double microseconds;
+        std::vector<float> output;
+    };
+
+    // Runs one kernel of set over fixed random input, iterations times.
+    using KernelCall = std::function<void(const DspKernels::KernelSet &set, std::vector<float> &output)>;
+
+    static KernelRun runKernel(const DspKernels::KernelSet &set, int iterations, const KernelCall &call)
+    {
+        KernelRun run;
+        call(set, run.output);
+        auto start = juce::Time::getHighResolutionTicks();
+        std::vector<float> scratch;
+        for (auto i = 0; i < iterations; ++i)
+            call(set, scratch);
+        run.microseconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start) * 1.0e6 / iterations;
+        return run;
+    }
+
+    static void kernelBench(const juce::ArgumentList &args)
+    {
+        using namespace DspKernels;
+        auto blockSize = juce::jmax(16, getIntOption(args, "--block", 256));
+        auto iterations = juce::jmax(1, getIntOption(args, "--iterations", 20000));
+        juce::Random random(1);
+        auto noise = [&random](int size)
+        {
+            std::vector<float> v((size_t)size);
+            for (auto &x : v)
+                x = random.nextFloat() * 2.0f - 1.0f;
+            return v;
+        };
+
+        auto source = noise(4 * blockSize + 8);
+        auto spectrumA = noise(2 * (blockSize + 1)), spectrumB = noise(2 * (blockSize + 1));
+        auto excitation = noise(blockSize);
+        float a[maxResonators], b[maxResonators], gain[maxResonators];
+        for (auto k = 0; k < maxResonators; ++k)
+        {
+            auto w = 0.02 * (k + 1);
+            a[k] = (float)(0.9995 * std::cos(w));
+            b[k] = (float)(0.9995 * std::sin(w));
+            gain[k] = 1.0f / (k + 1);
+        }
+
+        struct Kernel
+        {
+            const char *name;
+            int numChannels;
+            KernelCall call;
+        };
+        std::vector<Kernel> kernels;
+        kernels.push_back({"hermite resample", 2, [&](const KernelSet &set, std::vector<float> &out)
+                           {
+                               out.resize((size_t)blockSize);
+                               set.hermiteResample(source.data() + 1, out.data(), blockSize, 0.25, 1.37);
+                           }});
+        kernels.push_back({"complex mac", 2, [&](const KernelSet &set, std::vector<float> &out)
+                           {
+                               out.assign((size_t)(2 * (blockSize + 1)), 0.0f);
+                               set.complexMultiplyAccumulate(out.data(), spectrumA.data(), spectrumB.data(), blockSize + 1);
+                           }});
+        kernels.push_back({"dot product", 2, [&](const KernelSet &set, std::vector<float> &out)
+                           {
+                               out.assign(1, set.dotProduct(source.data(), source.data() + blockSize, blockSize));
+                           }});
+        kernels.push_back({"resonator bank", 2, [&](const KernelSet &set, std::vector<float> &out)
+                           {
+                               float re[maxResonators] = {}, im[maxResonators] = {};
+                               out.assign((size_t)blockSize, 0.0f);
+                               set.resonatorBank(re, im, a, b, gain, excitation.data(), out.data(), blockSize);
+                           }});
+        for (auto numChannels : {1, 2, 3})
+            kernels.push_back({numChannels == 1 ? "mix mono" : numChannels == 2 ? "mix stereo" : "mix 3 channels", numChannels,
+                               [&, numChannels](const KernelSet &set, std::vector<float> &out)
+                               {
+                                   out.assign((size_t)(numChannels * blockSize), 0.0f);
+                                   float *channels[] = {out.data(), out.data() + blockSize, out.data() + 2 * blockSize};
+                                   juce::AudioSampleBuffer dest(channels, numChannels, blockSize);
+                                   const float *src[] = {source.data(), source.data() + blockSize};
+                                   set.addTo(dest, 0, src, 2, blockSize, 0.25f, 0.75f);
+                               }});
+
+        auto failed = false;
+        std::cout << "kernel            isa         us/call  speedup  max error" << std::endl;
+        for (auto &kernel : kernels)
+        {
+            auto reference = runKernel(*find(Isa::scalar, kernel.numChannels), iterations, kernel.call);
+            auto peak = 0.0f;
+            for (auto x : reference.output)
+                peak = juce::jmax(peak, std::abs(x));
+
+            for (auto isa : {Isa::scalar, Isa::sse2, Isa::avx2, Isa::avx512, Isa::neon})
+            {
+                auto *set = find(isa, kernel.numChannels);
+                if (set == nullptr)
+                    continue;
+
+                auto run = isa == Isa::scalar ? reference : runKernel(*set, iterations, kernel.call);
+                auto error = 0.0f;
+                for (size_t i = 0; i < run.output.size(); ++i)
+                    error = juce::jmax(error, std::abs(run.output[i] - reference.output[i]));
+                auto matches = run.output.size() == reference.output.size() && error <= 1.0e-5f * juce::jmax(1.0f, peak);
+                failed = failed || !matches;
+
+                std::cout << juce::String(kernel.name).paddedRight(' ', 18) << juce::String(getName(isa)).paddedRight(' ', 9)
+                          << juce::String(run.microseconds, 3).paddedLeft(' ', 10)
+                          << juce::String(reference.microseconds / juce::jmax(1.0e-9, run.microseconds), 2).paddedLeft(' ', 9)
+                          << juce::String(error, 9).paddedLeft(' ', 13) << (matches ? "" : "  MISMATCH") << std::endl;
+            }
+        }
+        std::cout << "live set for stereo, " << blockSize << "-sample blocks: " << getName(select(2, blockSize).isa) << std::endl;
+
+        if (failed)
+            juce::ConsoleApplication::fail("A kernel variant differs from the scalar reference");
+    }
+};
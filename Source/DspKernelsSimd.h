@@ -0,0 +1,134 @@
+// The vector kernels, written once over Ops, the operations of one
+// instruction set. DspKernels.h includes this file once per set, inside that
+// set's namespace (which defines Ops) and, for sets above the compiler's
+// baseline, inside a target pragma so that all of it is compiled for the
+// set. It has no include guard on purpose.
+
+struct Impl
+{
+    static void hermiteResample(const float *src, float *dst, int numOut, double start, double ratio)
+    {
+        constexpr int width = Ops::width;
+        alignas(64) float ym1[width], y0[width], y1[width], y2[width], frac[width];
+        int i = 0;
+
+        for (; i + width <= numOut; i += width)
+        {
+            for (int lane = 0; lane < width; ++lane)
+            {
+                auto pos = start + (i + lane) * ratio;
+                auto index = (int)pos;
+                auto *s = src + index;
+                frac[lane] = (float)(pos - index);
+                ym1[lane] = s[-1];
+                y0[lane] = s[0];
+                y1[lane] = s[1];
+                y2[lane] = s[2];
+            }
+
+            auto a = Ops::load(ym1), b = Ops::load(y0), c = Ops::load(y1), d = Ops::load(y2);
+            auto t = Ops::load(frac);
+            auto half = Ops::set1(0.5f);
+            auto c1 = Ops::mul(half, Ops::sub(c, a));
+            auto c2 = Ops::sub(Ops::add(Ops::sub(a, Ops::mul(Ops::set1(2.5f), b)), Ops::add(c, c)), Ops::mul(half, d));
+            auto c3 = Ops::add(Ops::mul(half, Ops::sub(d, a)), Ops::mul(Ops::set1(1.5f), Ops::sub(b, c)));
+            Ops::store(dst + i, Ops::mulAdd(Ops::mulAdd(Ops::mulAdd(c3, t, c2), t, c1), t, b));
+        }
+
+        hermiteResampleScalar(src, dst + i, numOut - i, start + i * ratio, ratio);
+    }
+
+    static void complexMultiplyAccumulate(float *acc, const float *a, const float *b, int numComplex)
+    {
+        constexpr int perVector = Ops::width / 2;
+        int i = 0;
+        for (; i + perVector <= numComplex; i += perVector)
+            Ops::store(acc + 2 * i, Ops::add(Ops::load(acc + 2 * i), Ops::complexMultiply(Ops::load(a + 2 * i), Ops::load(b + 2 * i))));
+
+        complexMultiplyAccumulateScalar(acc + 2 * i, a + 2 * i, b + 2 * i, numComplex - i);
+    }
+
+    static float dotProduct(const float *a, const float *b, int n)
+    {
+        auto acc = Ops::zero();
+        int i = 0;
+        for (; i + Ops::width <= n; i += Ops::width)
+            acc = Ops::mulAdd(Ops::load(a + i), Ops::load(b + i), acc);
+
+        return Ops::sum(acc) + dotProductScalar(a + i, b + i, n - i);
+    }
+
+    // The whole bank's state stays in registers for the block.
+    static void resonatorBank(float *re, float *im, const float *a, const float *b, const float *gain,
+                              const float *input, float *out, int numSamples)
+    {
+        constexpr int numGroups = maxResonators / Ops::width;
+        Ops::V vr[numGroups], vi[numGroups], va[numGroups], vb[numGroups], vg[numGroups];
+        for (int g = 0; g < numGroups; ++g)
+        {
+            vr[g] = Ops::load(re + g * Ops::width);
+            vi[g] = Ops::load(im + g * Ops::width);
+            va[g] = Ops::load(a + g * Ops::width);
+            vb[g] = Ops::load(b + g * Ops::width);
+            vg[g] = Ops::load(gain + g * Ops::width);
+        }
+
+        for (int n = 0; n < numSamples; ++n)
+        {
+            auto x = Ops::set1(input != nullptr ? input[n] : 0.0f);
+            auto sum = Ops::zero();
+            for (int g = 0; g < numGroups; ++g)
+            {
+                auto r = Ops::add(Ops::sub(Ops::mul(va[g], vr[g]), Ops::mul(vb[g], vi[g])), x);
+                vi[g] = Ops::mulAdd(vb[g], vr[g], Ops::mul(va[g], vi[g]));
+                vr[g] = r;
+                sum = Ops::mulAdd(vg[g], vi[g], sum);
+            }
+            out[n] += Ops::sum(sum);
+        }
+
+        for (int g = 0; g < numGroups; ++g)
+        {
+            Ops::store(re + g * Ops::width, vr[g]);
+            Ops::store(im + g * Ops::width, vi[g]);
+        }
+    }
+
+    // numChannels is 1 or 2 for a single pass over the source writing every
+    // destination, or 0 for any count, one channel at a time.
+    template <int numChannels>
+    static void mix(float *const *dst, int numDst, const float *const *src, int numSrc,
+                    int numSamples, float startGain, float endGain)
+    {
+        if (numChannels == 0)
+        {
+            for (int ch = 0; ch < numDst; ++ch)
+                mix<1>(dst + ch, 1, src + juce::jmin(ch, numSrc - 1), 1, numSamples, startGain, endGain);
+            return;
+        }
+
+        auto step = numSamples > 0 ? (endGain - startGain) / (float)numSamples : 0.0f;
+        auto ramp = Ops::mul(Ops::load(laneIndex), Ops::set1(step));
+        auto *d0 = dst[0];
+        auto *d1 = dst[numChannels > 1 ? 1 : 0];
+        auto *s0 = src[0];
+        auto *s1 = src[numChannels > 1 && numSrc > 1 ? 1 : 0];
+        int i = 0;
+
+        for (; i + Ops::width <= numSamples; i += Ops::width)
+        {
+            auto g = Ops::add(Ops::set1(startGain + (float)i * step), ramp);
+            Ops::store(d0 + i, Ops::mulAdd(Ops::load(s0 + i), g, Ops::load(d0 + i)));
+            if (numChannels > 1)
+                Ops::store(d1 + i, Ops::mulAdd(Ops::load(s1 + i), g, Ops::load(d1 + i)));
+        }
+
+        for (; i < numSamples; ++i)
+        {
+            auto g = startGain + (float)i * step;
+            d0[i] += s0[i] * g;
+            if (numChannels > 1)
+                d1[i] += s1[i] * g;
+        }
+    }
+};
@@ -0,0 +1,396 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "SynthUsingMidiInput.h"
+
+// The synth signal chain as AudioProcessor nodes in an AudioProcessorGraph:
+//   MIDI in -> MIDI analyser -> synth -> reverb -> analysis tap -> audio out
+// The synth and reverb nodes wrap the app's own InstrumentSynth and
+// ConvolutionReverb. Every node keeps its own CPU time and may render in
+// smaller blocks than the graph is driven with. With setNonRealtime(true)
+// the graph renders offline, faster than real time.
+//
+// Only offline rendering (--graph-render) uses the graph. The live audio
+// callback still runs SynthAudioSource, which also does the quiz replay and
+// the rhythm clicks that have no node here. Precision is not per node:
+// the DSP is float, so every node and the graph render in float only.
+//
+// juce_audio_processors pulls in the GUI modules, so this is only built
+// into the app, not SenseTrainerCli.
+
+// Base class of the engine's nodes: timing, sub-blocks and the
+// AudioProcessor boilerplate. Subclasses implement render().
+class EngineNode : public juce::AudioProcessor
+{
+public:
+    EngineNode(const juce::String &nodeName, const BusesProperties &buses)
+        : juce::AudioProcessor(buses), name(nodeName)
+    {
+    }
+
+    // Renders in pieces of at most this many samples; 0 renders whole blocks.
+    // A node rendering in pieces may read MIDI but not rewrite it. Set
+    // before the graph is prepared.
+    void setSubBlockSize(int samples) { subBlockSize = juce::jmax(0, samples); }
+
+    struct CpuUsage
+    {
+        double busySeconds = 0.0;
+        double audioSeconds = 0.0;
+        juce::int64 blocks = 0;
+    };
+
+    // Time spent in this node since the previous call.
+    CpuUsage takeCpuUsage()
+    {
+        CpuUsage usage;
+        usage.busySeconds = juce::Time::highResolutionTicksToSeconds(busyTicks.exchange(0));
+        usage.audioSeconds = (double)renderedSamples.exchange(0) / juce::jmax(1.0, getSampleRate());
+        usage.blocks = renderedBlocks.exchange(0);
+        return usage;
+    }
+
+    void prepareToPlay(double sampleRate, int maximumExpectedSamplesPerBlock) final
+    {
+        subBlockMidi.ensureSize(2048);
+        prepare(sampleRate, subBlockSize > 0 ? juce::jmin(subBlockSize, maximumExpectedSamplesPerBlock) : maximumExpectedSamplesPerBlock);
+    }
+
+    void processBlock(juce::AudioBuffer<float> &buffer, juce::MidiBuffer &midi) final
+    {
+        auto start = juce::Time::getHighResolutionTicks();
+        auto numSamples = buffer.getNumSamples();
+        if (subBlockSize <= 0 || numSamples <= subBlockSize)
+        {
+            render(buffer, midi);
+        }
+        else
+        {
+            for (auto pos = 0; pos < numSamples; pos += subBlockSize)
+            {
+                auto n = juce::jmin(subBlockSize, numSamples - pos);
+                juce::AudioBuffer<float> part(buffer.getArrayOfWritePointers(), buffer.getNumChannels(), pos, n);
+                subBlockMidi.clear();
+                subBlockMidi.addEvents(midi, pos, n, -pos);
+                render(part, subBlockMidi);
+            }
+        }
+
+        busyTicks += juce::Time::getHighResolutionTicks() - start;
+        renderedSamples += numSamples;
+        ++renderedBlocks;
+    }
+
+    const juce::String getName() const override { return name; }
+    void releaseResources() override {}
+    double getTailLengthSeconds() const override { return 0.0; }
+    bool acceptsMidi() const override { return false; }
+    bool producesMidi() const override { return false; }
+    juce::AudioProcessorEditor *createEditor() override { return nullptr; }
+    bool hasEditor() const override { return false; }
+    int getNumPrograms() override { return 1; }
+    int getCurrentProgram() override { return 0; }
+    void setCurrentProgram(int) override {}
+    const juce::String getProgramName(int) override { return {}; }
+    void changeProgramName(int, const juce::String &) override {}
+    void getStateInformation(juce::MemoryBlock &) override {}
+    void setStateInformation(const void *, int) override {}
+
+protected:
+    virtual void prepare(double sampleRate, int maxBlockSize) = 0;
+    virtual void render(juce::AudioBuffer<float> &buffer, juce::MidiBuffer &midi) = 0;
+
+private:
+    juce::String name;
+    int subBlockSize = 0;
+    juce::MidiBuffer subBlockMidi;
+    std::atomic<juce::int64> busyTicks{0}, renderedSamples{0}, renderedBlocks{0};
+};
+
+// Watches the incoming notes on their way to the synth.
+class MidiAnalyserNode : public EngineNode
+{
+public:
+    MidiAnalyserNode() : EngineNode("MIDI analyser", BusesProperties()) {}
+
+    struct Stats
+    {
+        int notes = 0;
+        double meanVelocity = 0.0;
+        int lowest = 0, highest = 0;
+    };
+
+    Stats getStats() const
+    {
+        Stats stats;
+        stats.notes = notes.load();
+        stats.meanVelocity = stats.notes > 0 ? (double)velocitySum.load() / stats.notes : 0.0;
+        stats.lowest = lowest.load() < 128 ? lowest.load() : 0;
+        stats.highest = highest.load();
+        return stats;
+    }
+
+    bool acceptsMidi() const override { return true; }
+    bool producesMidi() const override { return true; }
+
+protected:
+    void prepare(double, int) override {}
+
+    void render(juce::AudioBuffer<float> &, juce::MidiBuffer &midi) override
+    {
+        for (const auto metadata : midi)
+        {
+            auto message = metadata.getMessage();
+            if (!message.isNoteOn())
+                continue;
+
+            notes.fetch_add(1, std::memory_order_relaxed);
+            velocitySum.fetch_add(message.getVelocity(), std::memory_order_relaxed);
+            lowest = juce::jmin(lowest.load(), message.getNoteNumber());
+            highest = juce::jmax(highest.load(), message.getNoteNumber());
+        }
+    }
+
+private:
+    std::atomic<int> notes{0}, lowest{128}, highest{0};
+    std::atomic<juce::int64> velocitySum{0};
+};
+
+// The app's instruments, rendered through ParallelSynthesiser.
+class SynthNode : public EngineNode
+{
+public:
+    explicit SynthNode(int numWorkersToUse)
+        : EngineNode("Synth", BusesProperties().withOutput("Output", juce::AudioChannelSet::stereo(), true)),
+          numWorkers(numWorkersToUse)
+    {
+    }
+
+    InstrumentSynth &getInstruments() { return instruments; }
+
+    bool acceptsMidi() const override { return true; }
+
+    void releaseResources() override
+    {
+        instruments.getSynth().stopWorkers();
+    }
+
+protected:
+    void prepare(double sampleRate, int maxBlockSize) override
+    {
+        instruments.getSynth().setCurrentPlaybackSampleRate(sampleRate);
+        instruments.getSynth().prepareWorkers(numWorkers, maxBlockSize, 2);
+    }
+
+    void render(juce::AudioBuffer<float> &buffer, juce::MidiBuffer &midi) override
+    {
+        buffer.clear();
+        instruments.getSynth().renderNextBlock(buffer, midi, 0, buffer.getNumSamples());
+    }
+
+private:
+    InstrumentSynth instruments;
+    int numWorkers;
+};
+
+// ConvolutionReverb in place, with its tail computed inline when offline.
+class ReverbNode : public EngineNode
+{
+public:
+    ReverbNode()
+        : EngineNode("Reverb", BusesProperties()
+                                   .withInput("Input", juce::AudioChannelSet::stereo(), true)
+                                   .withOutput("Output", juce::AudioChannelSet::stereo(), true))
+    {
+        reverb.loadImpulseResponse(ConvolutionReverb::getDefaultImpulseResponse());
+    }
+
+    ConvolutionReverb &getReverb() { return reverb; }
+
+    double getTailLengthSeconds() const override
+    {
+        return reverb.getImpulseResponseLength() / juce::jmax(1.0, getSampleRate());
+    }
+
+protected:
+    void prepare(double, int maxBlockSize) override
+    {
+        reverb.setNonRealtime(isNonRealtime());
+        reverb.prepare(maxBlockSize, 2);
+    }
+
+    void render(juce::AudioBuffer<float> &buffer, juce::MidiBuffer &) override
+    {
+        reverb.process(buffer, 0, buffer.getNumSamples());
+    }
+
+private:
+    ConvolutionReverb reverb;
+};
+
+// Passes audio through and keeps its peak and energy, accumulated in double.
+class AnalysisTapNode : public EngineNode
+{
+public:
+    AnalysisTapNode()
+        : EngineNode("Analysis tap", BusesProperties()
+                                         .withInput("Input", juce::AudioChannelSet::stereo(), true)
+                                         .withOutput("Output", juce::AudioChannelSet::stereo(), true))
+    {
+    }
+
+    struct Levels
+    {
+        float peak = 0.0f;
+        double rms = 0.0;
+    };
+
+    // Levels since the previous call.
+    Levels takeLevels()
+    {
+        Levels levels;
+        levels.peak = peak.exchange(0.0f);
+        auto samples = numSamples.exchange(0);
+        auto energy = sumOfSquares.exchange(0.0);
+        levels.rms = samples > 0 ? std::sqrt(energy / (double)samples) : 0.0;
+        return levels;
+    }
+
+protected:
+    void prepare(double, int) override {}
+
+    void render(juce::AudioBuffer<float> &buffer, juce::MidiBuffer &) override
+    {
+        double energy = 0.0;
+        for (auto ch = 0; ch < buffer.getNumChannels(); ++ch)
+        {
+            auto *data = buffer.getReadPointer(ch);
+            for (auto i = 0; i < buffer.getNumSamples(); ++i)
+                energy += (double)data[i] * data[i];
+        }
+
+        auto blockPeak = buffer.getMagnitude(0, buffer.getNumSamples());
+        if (blockPeak > peak.load())
+            peak = blockPeak;
+        sumOfSquares = sumOfSquares.load() + energy;
+        numSamples += (juce::int64)buffer.getNumSamples() * buffer.getNumChannels();
+    }
+
+private:
+    std::atomic<float> peak{0.0f};
+    std::atomic<double> sumOfSquares{0.0};
+    std::atomic<juce::int64> numSamples{0};
+};
+
+class EngineGraph
+{
+public:
+    explicit EngineGraph(int numSynthWorkers = 0)
+    {
+        using IO = juce::AudioProcessorGraph::AudioGraphIOProcessor;
+        auto midiIn = graph.addNode(std::make_unique<IO>(IO::midiInputNode));
+        auto audioOut = graph.addNode(std::make_unique<IO>(IO::audioOutputNode));
+        auto analyserNode = addNode(new MidiAnalyserNode(), analyser);
+        auto synthNode = addNode(new SynthNode(numSynthWorkers), synth);
+        auto reverbNode = addNode(new ReverbNode(), reverb);
+        auto tapNode = addNode(new AnalysisTapNode(), tap);
+
+        connect(midiIn, analyserNode, juce::AudioProcessorGraph::midiChannelIndex);
+        connect(analyserNode, synthNode, juce::AudioProcessorGraph::midiChannelIndex);
+        for (auto ch = 0; ch < 2; ++ch)
+        {
+            connect(synthNode, reverbNode, ch);
+            connect(reverbNode, tapNode, ch);
+            connect(tapNode, audioOut, ch);
+        }
+    }
+
+    MidiAnalyserNode &getAnalyser() { return *analyser; }
+    SynthNode &getSynth() { return *synth; }
+    ReverbNode &getReverb() { return *reverb; }
+    AnalysisTapNode &getTap() { return *tap; }
+
+    // Message thread: the graph builds its render sequence synchronously there.
+    void prepare(double sampleRate, int blockSize, bool nonRealtime)
+    {
+        graph.releaseResources();
+        graph.setNonRealtime(nonRealtime);
+        graph.setPlayConfigDetails(0, 2, sampleRate, blockSize);
+        graph.prepareToPlay(sampleRate, blockSize);
+        maxBlockSize = blockSize;
+    }
+
+    // buffer must have two channels; it is split into blocks the graph was prepared for.
+    void process(juce::AudioBuffer<float> &buffer, juce::MidiBuffer &midi)
+    {
+        for (auto pos = 0; pos < buffer.getNumSamples(); pos += maxBlockSize)
+        {
+            auto n = juce::jmin(maxBlockSize, buffer.getNumSamples() - pos);
+            juce::AudioBuffer<float> part(buffer.getArrayOfWritePointers(), buffer.getNumChannels(), pos, n);
+            blockMidi.clear();
+            blockMidi.addEvents(midi, pos, n, -pos);
+            graph.processBlock(part, blockMidi);
+        }
+    }
+
+    // Plays sequence (sample-positioned MIDI) through the graph, handing
+    // each block to sink(block, numSamples) as in QuizRenderer. Prepare with
+    // nonRealtime set first. Returns the wall-clock seconds taken.
+    template <typename Sink>
+    double renderOffline(const juce::MidiBuffer &sequence, int totalSamples, Sink &&sink)
+    {
+        juce::AudioBuffer<float> block(2, maxBlockSize);
+        juce::MidiBuffer midi;
+        auto start = juce::Time::getMillisecondCounterHiRes();
+        for (auto pos = 0; pos < totalSamples; pos += maxBlockSize)
+        {
+            auto n = juce::jmin(maxBlockSize, totalSamples - pos);
+            block.setSize(2, n, false, false, true);
+            block.clear();
+            midi.clear();
+            midi.addEvents(sequence, pos, n, -pos);
+            process(block, midi);
+            if (!sink(static_cast<const juce::AudioBuffer<float> &>(block), n))
+                break;
+        }
+        return (juce::Time::getMillisecondCounterHiRes() - start) * 0.001;
+    }
+
+    // One line per node: time spent and its share of the audio rendered.
+    juce::StringArray takeCpuReport()
+    {
+        juce::StringArray lines;
+        for (auto *node : nodes)
+        {
+            auto usage = node->takeCpuUsage();
+            auto load = usage.audioSeconds > 0.0 ? usage.busySeconds / usage.audioSeconds : 0.0;
+            lines.add(node->getName().paddedRight(' ', 14) + juce::String(usage.busySeconds * 1000.0, 2).paddedLeft(' ', 10)
+                      + " ms  " + juce::String(load * 100.0, 3).paddedLeft(' ', 8) + " % of real time  "
+                      + juce::String(usage.blocks) + " blocks");
+        }
+        return lines;
+    }
+
+private:
+    template <typename NodeType>
+    juce::AudioProcessorGraph::Node::Ptr addNode(NodeType *processor, NodeType *&pointer)
+    {
+        pointer = processor;
+        nodes.add(processor);
+        return graph.addNode(std::unique_ptr<juce::AudioProcessor>(processor));
+    }
+
+    void connect(juce::AudioProcessorGraph::Node::Ptr source, juce::AudioProcessorGraph::Node::Ptr destination, int channel)
+    {
+        graph.addConnection({{source->nodeID, channel}, {destination->nodeID, channel}});
+    }
+
+    juce::AudioProcessorGraph graph;
+    MidiAnalyserNode *analyser = nullptr;
+    SynthNode *synth = nullptr;
+    ReverbNode *reverb = nullptr;
+    AnalysisTapNode *tap = nullptr;
+    juce::Array<EngineNode *> nodes;
+    juce::MidiBuffer blockMidi;
+    int maxBlockSize = 512;
+};
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+#if JUCE_MODULE_AVAILABLE_juce_audio_processors
+ #include "HeadlessCommand.h"
+ #include "EngineGraph.h"
+ #include "QuizGenerator.h"
+
+// Headless mode for EngineGraph: offline rendering through the processor graph.
+class EngineGraphCommands : private HeadlessCommand
+{
+public:
+    static void addTo(juce::ConsoleApplication &app)
+    {
+        app.addCommand({"--graph-render",
+                        "--graph-render [--quizzes=N] [--block=N] [--rate=N] [--instrument=N] [--reverb-block=N] [--workers=N] [--out=file.wav]",
+                        "Renders generated quizzes offline through the processor graph and reports the speed and CPU per node.",
+                        "--instrument picks 0 sine, 1 sampled piano, 2 plucked string or 3 modal piano; --reverb-block renders the reverb in smaller sub-blocks.",
+                        [](const juce::ArgumentList &a) { graphRender(a); }});
+    }
+
+private:
+    static void graphRender(const juce::ArgumentList &args)
+    {
+        auto numQuizzes = juce::jmax(1, getIntOption(args, "--quizzes", 100));
+        auto blockSize = juce::jmax(16, getIntOption(args, "--block", 512));
+        auto sampleRate = (double)getIntOption(args, "--rate", 48000);
+        auto instrument = (InstrumentSynth::Instrument)juce::jlimit(0, 3, getIntOption(args, "--instrument", 3));
+
+        EngineGraph engine(juce::jmax(0, getIntOption(args, "--workers", 0)));
+        if (args.containsOption("--instrument") && !engine.getSynth().getInstruments().setInstrument(instrument))
+            juce::ConsoleApplication::fail("That instrument is not available");
+        engine.getReverb().setSubBlockSize(getIntOption(args, "--reverb-block", 0));
+        engine.prepare(sampleRate, blockSize, true);
+
+        // Quizzes back to back with the replay's 0.5 s note spacing.
+        auto noteLength = juce::roundToInt(sampleRate * 0.5);
+        juce::MidiBuffer sequence;
+        auto position = 0;
+        for (auto i = 0; i < numQuizzes; ++i)
+        {
+            int quiz[QuizGenerator::maxQuizLength] = {};
+            QuizGenerator generator(i);
+            generator.generate(i % 5 + 1, 60 + i % 12, quiz);
+            for (auto n = 0; n < QuizGenerator::maxQuizLength && quiz[n]; ++n)
+            {
+                sequence.addEvent(juce::MidiMessage::noteOn(1, quiz[n], (juce::uint8)100), position);
+                sequence.addEvent(juce::MidiMessage::noteOff(1, quiz[n]), position + noteLength);
+                position += noteLength;
+            }
+            position += noteLength;
+        }
+        auto totalSamples = position + juce::roundToInt(engine.getReverb().getTailLengthSeconds() * sampleRate);
+
+        std::unique_ptr<juce::AudioFormatWriter> writer;
+        if (args.containsOption("--out"))
+        {
+            auto file = juce::File::getCurrentWorkingDirectory().getChildFile(args.getValueForOption("--out"));
+            file.deleteFile();
+            std::unique_ptr<juce::OutputStream> stream(file.createOutputStream());
+            if (stream != nullptr)
+                writer.reset(juce::WavAudioFormat().createWriterFor(stream.get(), sampleRate, 2, 24, {}, 0));
+            if (writer == nullptr)
+                juce::ConsoleApplication::fail("Could not write " + file.getFullPathName());
+            stream.release();
+        }
+
+        auto seconds = engine.renderOffline(sequence, totalSamples, [&writer](const juce::AudioSampleBuffer &block, int numSamples)
+                                            { return writer == nullptr || writer->writeFromAudioSampleBuffer(block, 0, numSamples); });
+        writer.reset();
+
+        auto audioSeconds = totalSamples / sampleRate;
+        auto midiStats = engine.getAnalyser().getStats();
+        auto levels = engine.getTap().takeLevels();
+        std::cout << numQuizzes << " quizzes, " << juce::String(audioSeconds, 1) << " s of audio in "
+                  << juce::String(seconds, 2) << " s (" << juce::String(audioSeconds / juce::jmax(1.0e-9, seconds), 1)
+                  << "x real time, block " << blockSize << ")" << std::endl
+                  << midiStats.notes << " notes " << midiStats.lowest << "-" << midiStats.highest << ", mean velocity "
+                  << juce::String(midiStats.meanVelocity, 1) << "; output peak " << juce::String(levels.peak, 3)
+                  << ", rms " << juce::String(levels.rms, 4) << std::endl;
+        for (auto &line : engine.takeCpuReport())
+            std::cout << line << std::endl;
+    }
+};
+
+#endif
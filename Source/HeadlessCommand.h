@@ -0,0 +1,26 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <iostream>
+
+// Base of the headless command groups. Each subsystem's modes live in a
+// <Subsystem>Commands.h next to it, with an addTo() that registers them;
+// HeadlessCommands puts every group into SenseTrainerCli's
+// juce::ConsoleApplication, except EngineGraphCommands, which only the app
+// can build.
+class HeadlessCommand
+{
+protected:
+    static int getIntOption(const juce::ArgumentList &args, const juce::String &option, int defaultValue)
+    {
+        return args.containsOption(option) ? args.getValueForOption(option).getIntValue() : defaultValue;
+    }
+
+    static juce::MidiDeviceInfo findMidiDevice(const juce::Array<juce::MidiDeviceInfo> &devices, const juce::String &name)
+    {
+        for (auto &d : devices)
+            if (name.isEmpty() || d.name.containsIgnoreCase(name))
+                return d;
+        return {};
+    }
+};
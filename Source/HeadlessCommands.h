@@ -0,0 +1,65 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "BatchExporterCommands.h"
+#include "MelodyCorpusCommands.h"
+#include "SampledInstrumentCommands.h"
+#include "ConvolutionReverbCommands.h"
+#include "ParallelSynthesiserCommands.h"
+#include "LockFreeKeyboardStateCommands.h"
+#include "PitchSetCommands.h"
+#include "QuizServerCommands.h"
+#include "RhythmEngineCommands.h"
+#include "LatencyCalibrationCommands.h"
+#include "ReactionTimeCommands.h"
+#include "BufferSizeTunerCommands.h"
+#include "IdlePowerSaverCommands.h"
+#include "RealtimeThreadsCommands.h"
+#include "TracingCommands.h"
+#include "PhysicalVoicesCommands.h"
+#include "DspKernelsCommands.h"
+#include "RegressionSuiteCommands.h"
+
+// The command-line modes of SenseTrainerCli. The modes themselves live with
+// the subsystem each one exercises. The app only has --graph-render, which
+// needs juce_audio_processors (see Main.cpp).
+class HeadlessCommands
+{
+public:
+    // Returns true if the command line selected a headless mode, with the
+    // command's exit code in result.
+    static bool run(const juce::String &commandLine, int &result)
+    {
+        return run(juce::ArgumentList("SenseTrainer", commandLine), result);
+    }
+
+    static bool run(const juce::ArgumentList &args, int &result)
+    {
+        if (args.size() == 0 || !args[0].isLongOption())
+            return false;
+
+        juce::ConsoleApplication app;
+        app.addHelpCommand("--help|-h", "Usage:", true);
+        BatchExporterCommands::addTo(app);
+        MelodyCorpusCommands::addTo(app);
+        SampledInstrumentCommands::addTo(app);
+        ConvolutionReverbCommands::addTo(app);
+        ParallelSynthesiserCommands::addTo(app);
+        LockFreeKeyboardStateCommands::addTo(app);
+        PitchSetCommands::addTo(app);
+        QuizServerCommands::addTo(app);
+        RhythmEngineCommands::addTo(app);
+        LatencyCalibrationCommands::addTo(app);
+        ReactionTimeCommands::addTo(app);
+        BufferSizeTunerCommands::addTo(app);
+        IdlePowerSaverCommands::addTo(app);
+        RealtimeThreadsCommands::addTo(app);
+        TracingCommands::addTo(app);
+        PhysicalVoicesCommands::addTo(app);
+        DspKernelsCommands::addTo(app);
+        RegressionSuiteCommands::addTo(app);
+
+        result = app.findAndRunCommand(args);
+        return true;
+    }
+};
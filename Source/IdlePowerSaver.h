@@ -0,0 +1,149 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+// Lets the audio callback skip all rendering while nothing can sound. The
+// audio path goes idle once no voice is active, nothing is pending and the
+// output (reverb tail included) has been silent for a short while; any
+// input calls wake() from whichever thread it arrives on.
+class IdleDetector
+{
+public:
+    // Call from prepareToPlay.
+    void prepare(double sampleRate)
+    {
+        quietSamplesNeeded = (juce::int64)(tailSeconds * sampleRate);
+        quietSamples = 0;
+        idle = false;
+    }
+
+    void setEnabled(bool shouldSkip) { enabled = shouldSkip; }
+
+    void wake() { pending.store(true, std::memory_order_release); }
+
+    // Audio thread, at the start of a callback. busy is true while a replay
+    // or anything else outside the synth's voices needs the block rendered.
+    bool canSkipBlock(bool busy)
+    {
+        auto woken = pending.exchange(false, std::memory_order_acquire);
+        if (woken || busy || !enabled.load() || quietSamples < quietSamplesNeeded)
+        {
+            idle = false;
+            renderedBlocks.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        if (!idle.load())
+        {
+            idleSince = juce::Time::getMillisecondCounter();
+            idle = true;
+        }
+        skippedBlocks.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Audio thread, after rendering a block that wasn't skipped.
+    void blockRendered(const juce::AudioSampleBuffer &buffer, int startSample, int numSamples, bool voicesActive)
+    {
+        auto sounding = voicesActive || buffer.getMagnitude(startSample, numSamples) > silenceLevel;
+        quietSamples = sounding ? 0 : quietSamples + numSamples;
+    }
+
+    bool isIdle() const { return idle.load(); }
+    bool isWakePending() const { return pending.load(); }
+
+    juce::uint32 getMillisecondsIdle() const
+    {
+        return idle.load() ? juce::Time::getMillisecondCounter() - idleSince.load() : 0;
+    }
+
+    juce::int64 getRenderedBlocks() const { return renderedBlocks.load(); }
+    juce::int64 getSkippedBlocks() const { return skippedBlocks.load(); }
+
+private:
+    static constexpr double tailSeconds = 0.25;
+    static constexpr float silenceLevel = 1.0e-5f; // -100 dB
+
+    std::atomic<bool> enabled{true}, pending{true}, idle{false};
+    std::atomic<juce::uint32> idleSince{0};
+    std::atomic<juce::int64> renderedBlocks{0}, skippedBlocks{0};
+    juce::int64 quietSamples = 0, quietSamplesNeeded = 0;
+};
+
+// Closes the audio device after the detector has been idle for a while
+// and reopens it as soon as anything wakes it. Register it as a MIDI input
+// callback so a key press resumes playback; the note waits in the MIDI
+// collector and plays in the first block after the device restarts.
+class AudioDeviceSuspender : public juce::MidiInputCallback,
+                             private juce::AsyncUpdater,
+                             private juce::Timer
+{
+public:
+    AudioDeviceSuspender(juce::AudioDeviceManager &manager, IdleDetector &idleDetector)
+        : deviceManager(manager), detector(idleDetector)
+    {
+        startTimer(1000);
+    }
+
+    ~AudioDeviceSuspender() override
+    {
+        stopTimer();
+        cancelPendingUpdate();
+    }
+
+    // Zero or less keeps the device open.
+    void setSuspendAfterSeconds(double seconds) { suspendAfterMs = (int)(seconds * 1000.0); }
+
+    bool isSuspended() const { return suspended.load(); }
+    double getLastResumeMs() const { return lastResumeMs; }
+
+    // Any thread.
+    void wake()
+    {
+        detector.wake();
+        if (suspended.load())
+            triggerAsyncUpdate();
+    }
+
+    void handleIncomingMidiMessage(juce::MidiInput *, const juce::MidiMessage &) override { wake(); }
+
+    // Message thread; called once a second by the timer.
+    bool suspendIfIdle()
+    {
+        if (suspended.load() || suspendAfterMs <= 0 || !detector.isIdle()
+            || detector.getMillisecondsIdle() < (juce::uint32)suspendAfterMs)
+            return false;
+
+        // Publish first so a wake from here on schedules a resume.
+        suspended = true;
+        if (detector.isWakePending())
+        {
+            suspended = false;
+            return false;
+        }
+
+        deviceManager.closeAudioDevice();
+        return true;
+    }
+
+    // Message thread.
+    void resume()
+    {
+        if (!suspended.exchange(false))
+            return;
+
+        auto start = juce::Time::getMillisecondCounterHiRes();
+        deviceManager.restartLastAudioDevice();
+        lastResumeMs = juce::Time::getMillisecondCounterHiRes() - start;
+    }
+
+private:
+    void timerCallback() override { suspendIfIdle(); }
+    void handleAsyncUpdate() override { resume(); }
+
+    juce::AudioDeviceManager &deviceManager;
+    IdleDetector &detector;
+    int suspendAfterMs = 60000;
+    std::atomic<bool> suspended{false};
+    double lastResumeMs = 0.0;
+};
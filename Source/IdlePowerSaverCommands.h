@@ -0,0 +1,111 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "HeadlessCommand.h"
+#include "IdlePowerSaver.h"
+#include "SynthLoad.h"
+
+#if JUCE_WINDOWS
+ #include <windows.h>
+#else
+ #include <sys/resource.h>
+#endif
+
+// Headless mode for the idle power saver: CPU and wakeups with each idle strategy.
+class IdlePowerSaverCommands : private HeadlessCommand
+{
+public:
+    static void addTo(juce::ConsoleApplication &app)
+    {
+        app.addCommand({"--idle-power",
+                        "--idle-power [--seconds=N]",
+                        "Compares CPU time and wakeups of an idle audio device with and without the silent fast path.",
+                        "Measures always rendering, skipping silent blocks and a suspended device, then the time to resume.",
+                        [](const juce::ArgumentList &a) { idlePower(a); }});
+    }
+
+private:
+    // CPU time and context switches of the whole process so far.
+    struct ProcessUsage
+    {
+        double cpuSeconds = 0.0;
+        juce::int64 contextSwitches = -1;
+
+        static ProcessUsage now()
+        {
+            ProcessUsage usage;
+#if JUCE_WINDOWS
+            FILETIME creation, exited, kernel, user;
+            if (GetProcessTimes(GetCurrentProcess(), &creation, &exited, &kernel, &user))
+            {
+                auto ticks = [](const FILETIME &t) { return (double)(((juce::uint64)t.dwHighDateTime << 32) | t.dwLowDateTime); };
+                usage.cpuSeconds = (ticks(kernel) + ticks(user)) * 1.0e-7;
+            }
+#else
+            rusage ru;
+            if (getrusage(RUSAGE_SELF, &ru) == 0)
+            {
+                usage.cpuSeconds = ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1.0e-6;
+                usage.contextSwitches = ru.ru_nvcsw + ru.ru_nivcsw;
+            }
+#endif
+            return usage;
+        }
+    };
+
+    static void measureIdlePower(const char *name, SynthLoad &load, int seconds)
+    {
+        auto before = ProcessUsage::now();
+        auto callbacksBefore = load.monitor.snapshot().callbacks;
+        auto skippedBefore = load.idle.getSkippedBlocks();
+        juce::Thread::sleep(seconds * 1000);
+        auto after = ProcessUsage::now();
+
+        std::cout << juce::String(name).paddedRight(' ', 18)
+                  << juce::String((after.cpuSeconds - before.cpuSeconds) * 100.0 / seconds, 2).paddedLeft(' ', 7)
+                  << (after.contextSwitches >= 0 ? juce::String((double)(after.contextSwitches - before.contextSwitches) / seconds, 1)
+                                                 : juce::String("n/a"))
+                         .paddedLeft(' ', 12)
+                  << juce::String((double)(load.monitor.snapshot().callbacks - callbacksBefore) / seconds, 1).paddedLeft(' ', 13)
+                  << juce::String((double)(load.idle.getSkippedBlocks() - skippedBefore) / seconds, 1).paddedLeft(' ', 11)
+                  << std::endl;
+    }
+
+    static void idlePower(const juce::ArgumentList &args)
+    {
+        auto seconds = juce::jmax(1, getIntOption(args, "--seconds", 10));
+        juce::AudioDeviceManager devices;
+        auto error = devices.initialiseWithDefaultDevices(0, 2);
+        if (error.isNotEmpty() || devices.getCurrentAudioDevice() == nullptr)
+            juce::ConsoleApplication::fail("Could not open an audio device: " + error);
+
+        SynthLoad load(16);
+        juce::AudioSourcePlayer player;
+        player.setSource(&load);
+        devices.addAudioCallback(&player);
+
+        // Play briefly so the reverb has a tail to wait out, as after a quiz.
+        load.active = true;
+        juce::Thread::sleep(500);
+        load.active = false;
+
+        std::cout << "mode                CPU %  wakeups/s  callbacks/s  skipped/s" << std::endl;
+        load.idle.setEnabled(false);
+        measureIdlePower("always render", load, seconds);
+
+        load.idle.setEnabled(true);
+        juce::Thread::sleep(500);
+        measureIdlePower("silent fast path", load, seconds);
+
+        AudioDeviceSuspender suspender(devices, load.idle);
+        suspender.setSuspendAfterSeconds(0.001);
+        if (!suspender.suspendIfIdle())
+            juce::ConsoleApplication::fail("Audio path did not go idle");
+        measureIdlePower("device suspended", load, seconds);
+
+        suspender.wake();
+        suspender.resume();
+        std::cout << "resumed in " << juce::String(suspender.getLastResumeMs(), 1) << " ms" << std::endl;
+        devices.removeAudioCallback(&player);
+    }
+};
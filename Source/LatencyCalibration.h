@@ -0,0 +1,429 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <map>
+#include <vector>
+
+// Measured latencies per audio and MIDI device, kept between runs. Audio
+// offsets are what the device really adds, which is often more than it
+// reports; the MIDI input offset is the delay from a key press to its
+// timestamp, and the MIDI output offset from a scheduled send to the note.
+// The tuned buffer size is kept per audio device and sample rate.
+class LatencyProfiles
+{
+public:
+    struct AudioLatency
+    {
+        double outputMs = 0.0, inputMs = 0.0;
+    };
+
+    void load(const juce::File &file)
+    {
+        audio.clear();
+        midi.clear();
+        midiOutputs.clear();
+        buffers.clear();
+
+        auto xml = juce::parseXML(file);
+        if (xml == nullptr || !xml->hasTagName("LatencyProfiles"))
+            return;
+
+        for (auto *e : xml->getChildWithTagNameIterator("Audio"))
+            audio[e->getStringAttribute("name")] = {e->getDoubleAttribute("outputMs"), e->getDoubleAttribute("inputMs")};
+        for (auto *e : xml->getChildWithTagNameIterator("Midi"))
+            midi[e->getStringAttribute("name")] = e->getDoubleAttribute("inputMs");
+        for (auto *e : xml->getChildWithTagNameIterator("MidiOutput"))
+            midiOutputs[e->getStringAttribute("name")] = e->getDoubleAttribute("outputMs");
+        for (auto *e : xml->getChildWithTagNameIterator("Buffer"))
+            buffers[e->getStringAttribute("name")] = {e->getDoubleAttribute("sampleRate"), e->getIntAttribute("size")};
+    }
+
+    bool save(const juce::File &file) const
+    {
+        juce::XmlElement xml("LatencyProfiles");
+        for (auto &a : audio)
+        {
+            auto *e = xml.createNewChildElement("Audio");
+            e->setAttribute("name", a.first);
+            e->setAttribute("outputMs", a.second.outputMs);
+            e->setAttribute("inputMs", a.second.inputMs);
+        }
+        for (auto &m : midi)
+        {
+            auto *e = xml.createNewChildElement("Midi");
+            e->setAttribute("name", m.first);
+            e->setAttribute("inputMs", m.second);
+        }
+        for (auto &m : midiOutputs)
+        {
+            auto *e = xml.createNewChildElement("MidiOutput");
+            e->setAttribute("name", m.first);
+            e->setAttribute("outputMs", m.second);
+        }
+        for (auto &b : buffers)
+        {
+            auto *e = xml.createNewChildElement("Buffer");
+            e->setAttribute("name", b.first);
+            e->setAttribute("sampleRate", b.second.sampleRate);
+            e->setAttribute("size", b.second.size);
+        }
+
+        file.getParentDirectory().createDirectory();
+        return xml.writeTo(file);
+    }
+
+    bool getAudio(const juce::String &deviceName, AudioLatency &latency) const
+    {
+        auto found = audio.find(deviceName);
+        if (found == audio.end())
+            return false;
+
+        latency = found->second;
+        return true;
+    }
+
+    void setAudio(const juce::String &deviceName, AudioLatency latency) { audio[deviceName] = latency; }
+
+    double getMidiInputMs(const juce::String &deviceName) const
+    {
+        auto found = midi.find(deviceName);
+        return found != midi.end() ? found->second : 0.0;
+    }
+
+    void setMidiInputMs(const juce::String &deviceName, double ms) { midi[deviceName] = ms; }
+
+    double getMidiOutputMs(const juce::String &deviceName) const
+    {
+        auto found = midiOutputs.find(deviceName);
+        return found != midiOutputs.end() ? found->second : 0.0;
+    }
+
+    void setMidiOutputMs(const juce::String &deviceName, double ms) { midiOutputs[deviceName] = ms; }
+
+    bool getBufferSize(const juce::String &deviceName, double sampleRate, int &bufferSize) const
+    {
+        auto found = buffers.find(deviceName);
+        if (found == buffers.end() || found->second.sampleRate != sampleRate || found->second.size <= 0)
+            return false;
+
+        bufferSize = found->second.size;
+        return true;
+    }
+
+    void setBufferSize(const juce::String &deviceName, double sampleRate, int bufferSize)
+    {
+        buffers[deviceName] = {sampleRate, bufferSize};
+    }
+
+    static juce::File getDefaultFile()
+    {
+        return juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+            .getChildFile("SenseTrainer")
+            .getChildFile("latency.xml");
+    }
+
+private:
+    struct BufferSetting
+    {
+        double sampleRate = 0.0;
+        int size = 0;
+    };
+
+    std::map<juce::String, AudioLatency> audio;
+    std::map<juce::String, double> midi, midiOutputs;
+    std::map<juce::String, BufferSetting> buffers;
+};
+
+// Plays a train of short chirps and finds them again in the input with a
+// matched filter. With the output cabled (or acoustically coupled) to the
+// input this gives the real round trip, which is compared with what the
+// device reports.
+class AudioLoopbackCalibrator : public juce::AudioIODeviceCallback
+{
+public:
+    static constexpr int numPings = 8;
+
+    struct Result
+    {
+        bool ok = false;
+        double sampleRate = 44100.0;
+        double roundTripSamples = 0.0, reportedSamples = 0.0, spreadSamples = 0.0;
+        int numDetected = 0;
+
+        double roundTripMs() const { return roundTripSamples * 1000.0 / sampleRate; }
+
+        // Splits the unreported part of the round trip evenly between both directions.
+        LatencyProfiles::AudioLatency toLatency(int reportedOutput, int reportedInput) const
+        {
+            auto extra = 0.5 * (roundTripSamples - reportedSamples);
+            return {(reportedOutput + extra) * 1000.0 / sampleRate, (reportedInput + extra) * 1000.0 / sampleRate};
+        }
+    };
+
+    void prepare(double newSampleRate, int newReportedOutput, int newReportedInput)
+    {
+        sampleRate = newSampleRate;
+        reportedOutput = newReportedOutput;
+        reportedInput = newReportedInput;
+
+        // 5 ms Hann-windowed linear chirp from 1 to 8 kHz.
+        auto length = juce::roundToInt(0.005 * sampleRate);
+        chirp.resize((size_t)length);
+        for (auto i = 0; i < length; ++i)
+        {
+            auto t = i / sampleRate;
+            auto sweep = (8000.0 - 1000.0) / (length / sampleRate);
+            auto window = 0.5 - 0.5 * std::cos(2.0 * juce::MathConstants<double>::pi * i / (length - 1));
+            chirp[(size_t)i] = (float)(window * std::sin(2.0 * juce::MathConstants<double>::pi * (1000.0 * t + 0.5 * sweep * t * t)));
+        }
+
+        pingInterval = juce::roundToInt(0.4 * sampleRate);
+        recording.assign((size_t)((numPings + 1) * pingInterval), 0.0f);
+        position = 0;
+        done = false;
+    }
+
+    bool isDone() const { return done.load(); }
+    int getReportedOutput() const { return reportedOutput; }
+    int getReportedInput() const { return reportedInput; }
+
+    void audioDeviceAboutToStart(juce::AudioIODevice *device) override
+    {
+        prepare(device->getCurrentSampleRate(), device->getOutputLatencyInSamples(), device->getInputLatencyInSamples());
+    }
+
+    void audioDeviceStopped() override {}
+
+    void audioDeviceIOCallback(const float **inputs, int numInputs, float **outputs, int numOutputs, int numSamples) override
+    {
+        for (auto i = 0; i < numSamples; ++i)
+        {
+            auto pos = position + i;
+            auto k = pos % pingInterval;
+            auto sample = pos < (juce::int64)numPings * pingInterval && k < (int)chirp.size() ? 0.5f * chirp[(size_t)k] : 0.0f;
+
+            for (auto ch = 0; ch < numOutputs; ++ch)
+                if (outputs[ch] != nullptr)
+                    outputs[ch][i] = sample;
+
+            if (numInputs > 0 && inputs[0] != nullptr && pos < (juce::int64)recording.size())
+                recording[(size_t)pos] = inputs[0][i];
+        }
+
+        position += numSamples;
+        if (position >= (juce::int64)recording.size())
+            done = true;
+    }
+
+    // Call once isDone() is true.
+    Result analyse() const
+    {
+        Result result;
+        result.sampleRate = sampleRate;
+        result.reportedSamples = reportedOutput + reportedInput;
+
+        auto maxLag = pingInterval - (int)chirp.size();
+        juce::Array<int> lags;
+        for (auto p = 0; p < numPings; ++p)
+        {
+            auto *segment = recording.data() + (size_t)p * (size_t)pingInterval;
+            float best = 0.0f, sumAbs = 0.0f;
+            auto bestLag = 0;
+            for (auto lag = 0; lag < maxLag; ++lag)
+            {
+                float corr = 0.0f;
+                for (size_t i = 0; i < chirp.size(); ++i)
+                    corr += chirp[i] * segment[(size_t)lag + i];
+                sumAbs += std::abs(corr);
+                if (std::abs(corr) > best)
+                {
+                    best = std::abs(corr);
+                    bestLag = lag;
+                }
+            }
+
+            // A real echo stands well clear of the correlation floor.
+            if (best > 8.0f * sumAbs / (float)maxLag)
+                lags.add(bestLag);
+        }
+
+        result.numDetected = lags.size();
+        if (lags.size() < numPings / 2)
+            return result;
+
+        lags.sort();
+        result.roundTripSamples = lags[lags.size() / 2];
+        result.spreadSamples = lags.getLast() - lags.getFirst();
+        result.ok = true;
+        return result;
+    }
+
+private:
+    double sampleRate = 44100.0;
+    int reportedOutput = 0, reportedInput = 0;
+    std::vector<float> chirp, recording;
+    int pingInterval = 0;
+    juce::int64 position = 0;
+    std::atomic<bool> done{false};
+};
+
+// Stands in for an audio device whose output is wired to its input with a
+// fixed delay, so calibration can be checked without hardware.
+struct SimulatedLoopbackDevice
+{
+    static void run(juce::AudioIODeviceCallback &callback, int blockSize, int delaySamples, float noiseLevel, int maxBlocks)
+    {
+        juce::AudioSampleBuffer in(1, blockSize), out(2, blockSize);
+        std::vector<float> delayLine((size_t)juce::jmax(1, delaySamples), 0.0f);
+        size_t delayPos = 0;
+        juce::Random random(7);
+
+        for (auto block = 0; block < maxBlocks; ++block)
+        {
+            out.clear();
+            callback.audioDeviceIOCallback(in.getArrayOfReadPointers(), 1, out.getArrayOfWritePointers(), 2, blockSize);
+
+            // Output becomes the next block's input through the delay line.
+            for (auto i = 0; i < blockSize; ++i)
+            {
+                auto delayed = delaySamples > 0 ? delayLine[delayPos] : out.getSample(0, i);
+                if (delaySamples > 0)
+                {
+                    delayLine[delayPos] = out.getSample(0, i);
+                    delayPos = (delayPos + 1) % delayLine.size();
+                }
+                in.setSample(0, i, 0.6f * delayed + noiseLevel * (random.nextFloat() * 2.0f - 1.0f));
+            }
+        }
+    }
+};
+
+// Sends notes to a MIDI output that is looped back to an input and times
+// their return. Half the round trip is taken as the input's latency.
+class MidiLoopbackCalibrator : public juce::MidiInputCallback
+{
+public:
+    struct Result
+    {
+        bool ok = false;
+        double roundTripMs = 0.0, spreadMs = 0.0;
+        int numReceived = 0;
+    };
+
+    Result run(juce::MidiOutput &output, int numNotes)
+    {
+        juce::Array<double> roundTrips;
+        for (auto i = 0; i < numNotes; ++i)
+        {
+            expectedNote = 48 + i % 24;
+            received.reset();
+
+            auto sent = juce::Time::getMillisecondCounterHiRes();
+            output.sendMessageNow(juce::MidiMessage::noteOn(1, expectedNote, (juce::uint8)100));
+            if (received.wait(250))
+                roundTrips.add(arrivalMs.load() - sent);
+
+            output.sendMessageNow(juce::MidiMessage::noteOff(1, expectedNote));
+            juce::Thread::sleep(50);
+        }
+
+        Result result;
+        result.numReceived = roundTrips.size();
+        if (roundTrips.isEmpty())
+            return result;
+
+        roundTrips.sort();
+        result.roundTripMs = roundTrips[roundTrips.size() / 2];
+        result.spreadMs = roundTrips.getLast() - roundTrips.getFirst();
+        result.ok = true;
+        return result;
+    }
+
+    void handleIncomingMidiMessage(juce::MidiInput *, const juce::MidiMessage &message) override
+    {
+        if (message.isNoteOn() && message.getNoteNumber() == expectedNote)
+        {
+            arrivalMs = message.getTimeStamp() * 1000.0;
+            received.signal();
+        }
+    }
+
+private:
+    std::atomic<int> expectedNote{-1};
+    std::atomic<double> arrivalMs{0.0};
+    juce::WaitableEvent received;
+};
+
+// Schedules a train of notes the way quiz prompts are sent, as one block
+// for MidiOutput's background thread, and times their arrival through a
+// loopback (virtual) port. The offset is how late notes leave on average;
+// the jitter is how much that varies from note to note.
+class MidiSendJitterMeter : public juce::MidiInputCallback
+{
+public:
+    struct Result
+    {
+        bool ok = false;
+        int numReceived = 0;
+        double offsetMs = 0.0, jitterRmsMs = 0.0, jitterMaxMs = 0.0;
+    };
+
+    // output must have its background thread running.
+    Result run(juce::MidiOutput &output, int numNotes, int intervalMs)
+    {
+        arrivals.assign((size_t)numNotes, 0.0);
+        numArrived = 0;
+
+        juce::MidiBuffer block;
+        for (auto i = 0; i < numNotes; ++i)
+        {
+            block.addEvent(juce::MidiMessage::noteOn(1, 48 + i % 24, (juce::uint8)100), i * intervalMs);
+            block.addEvent(juce::MidiMessage::noteOff(1, 48 + i % 24), i * intervalMs + intervalMs / 2);
+        }
+
+        auto start = juce::Time::getMillisecondCounter() + 50;
+        output.sendBlockOfMessages(block, start, 1000.0);
+        juce::Thread::sleep(50 + numNotes * intervalMs + 250);
+        output.clearAllPendingMessages();
+
+        Result result;
+        result.numReceived = juce::jmin(numArrived.load(), numNotes);
+        if (result.numReceived == 0)
+            return result;
+
+        juce::Array<double> errors;
+        for (auto i = 0; i < result.numReceived; ++i)
+            errors.add(arrivals[(size_t)i] - (start + (double)i * intervalMs));
+
+        auto mean = 0.0;
+        for (auto e : errors)
+            mean += e;
+        mean /= errors.size();
+
+        auto squares = 0.0;
+        for (auto e : errors)
+        {
+            squares += (e - mean) * (e - mean);
+            result.jitterMaxMs = juce::jmax(result.jitterMaxMs, std::abs(e - mean));
+        }
+        result.offsetMs = mean;
+        result.jitterRmsMs = std::sqrt(squares / errors.size());
+        result.ok = true;
+        return result;
+    }
+
+    void handleIncomingMidiMessage(juce::MidiInput *, const juce::MidiMessage &message) override
+    {
+        if (!message.isNoteOn())
+            return;
+
+        auto index = numArrived.load();
+        if (index < (int)arrivals.size())
+            arrivals[(size_t)index] = message.getTimeStamp() * 1000.0;
+        numArrived = index + 1;
+    }
+
+private:
+    std::vector<double> arrivals;
+    std::atomic<int> numArrived{0};
+};
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "HeadlessCommand.h"
+#include "LatencyCalibration.h"
+
+// Headless modes that measure audio and MIDI latency into LatencyProfiles.
+class LatencyCalibrationCommands : private HeadlessCommand
+{
+public:
+    static void addTo(juce::ConsoleApplication &app)
+    {
+        app.addCommand({"--latency-calibrate",
+                        "--latency-calibrate [--simulate-ms=N] [--block=N]",
+                        "Measures audio round-trip latency with the output looped back to the input.",
+                        "Stores the result for the default audio device; --simulate-ms runs against a simulated loopback instead.",
+                        [](const juce::ArgumentList &a) { latencyCalibrate(a); }});
+        app.addCommand({"--midi-loopback",
+                        "--midi-loopback <output name> [input name]",
+                        "Measures MIDI round-trip latency through a loopback cable and stores the input offset.",
+                        {},
+                        [](const juce::ArgumentList &a) { midiLoopback(a); }});
+        app.addCommand({"--midi-send-jitter",
+                        "--midi-send-jitter <output name> [input name] [--notes=N] [--interval-ms=N]",
+                        "Measures the timing of scheduled MIDI output through a loopback port and stores the output offset.",
+                        "Sends a block of notes through the output's background thread, as quiz prompts are sent, "
+                        "and reports the mean offset and the jitter of their arrival times.",
+                        [](const juce::ArgumentList &a) { midiSendJitter(a); }});
+    }
+
+private:
+    static void printLoopbackResult(const AudioLoopbackCalibrator::Result &result)
+    {
+        std::cout << "detected " << result.numDetected << "/" << AudioLoopbackCalibrator::numPings << " pings, round trip "
+                  << result.roundTripSamples << " samples (" << juce::String(result.roundTripMs(), 2) << " ms), reported "
+                  << result.reportedSamples << ", spread " << result.spreadSamples << " samples" << std::endl;
+    }
+
+    static void latencyCalibrate(const juce::ArgumentList &args)
+    {
+        AudioLoopbackCalibrator calibrator;
+
+        if (args.containsOption("--simulate-ms"))
+        {
+            auto blockSize = juce::jmax(16, getIntOption(args, "--block", 256));
+            auto sampleRate = 48000.0;
+            auto delay = juce::roundToInt(args.getValueForOption("--simulate-ms").getDoubleValue() * 0.001 * sampleRate);
+
+            calibrator.prepare(sampleRate, 0, 0);
+            SimulatedLoopbackDevice::run(calibrator, blockSize, delay, 0.05f,
+                                         (int)((AudioLoopbackCalibrator::numPings + 2) * 0.4 * sampleRate / blockSize));
+            auto result = calibrator.analyse();
+            printLoopbackResult(result);
+            std::cout << "expected " << delay + blockSize << " samples (delay plus one block)" << std::endl;
+            if (!result.ok)
+                juce::ConsoleApplication::fail("Loopback signal not found");
+            return;
+        }
+
+        juce::AudioDeviceManager devices;
+        auto error = devices.initialiseWithDefaultDevices(1, 2);
+        auto *device = devices.getCurrentAudioDevice();
+        if (error.isNotEmpty() || device == nullptr)
+            juce::ConsoleApplication::fail("Could not open an audio device with an input: " + error);
+
+        std::cout << "Playing test pings on " << device->getName() << "; connect its output to its input." << std::endl;
+        devices.addAudioCallback(&calibrator);
+        for (auto waited = 0; !calibrator.isDone() && waited < 10000; waited += 50)
+            juce::Thread::sleep(50);
+        devices.removeAudioCallback(&calibrator);
+
+        auto result = calibrator.analyse();
+        printLoopbackResult(result);
+        if (!result.ok)
+            juce::ConsoleApplication::fail("Loopback signal not found; check the cable and input level");
+
+        auto latency = result.toLatency(calibrator.getReportedOutput(), calibrator.getReportedInput());
+        LatencyProfiles profiles;
+        profiles.load(LatencyProfiles::getDefaultFile());
+        profiles.setAudio(device->getName(), latency);
+        profiles.save(LatencyProfiles::getDefaultFile());
+        std::cout << "stored output " << juce::String(latency.outputMs, 2) << " ms, input "
+                  << juce::String(latency.inputMs, 2) << " ms for " << device->getName() << std::endl;
+    }
+
+    static void midiLoopback(const juce::ArgumentList &args)
+    {
+        args.checkMinNumArguments(2);
+        auto outputInfo = findMidiDevice(juce::MidiOutput::getAvailableDevices(), args[1].text);
+        auto inputInfo = findMidiDevice(juce::MidiInput::getAvailableDevices(), args.size() > 2 ? args[2].text : juce::String());
+        if (outputInfo.identifier.isEmpty() || inputInfo.identifier.isEmpty())
+            juce::ConsoleApplication::fail("MIDI loopback devices not found");
+
+        MidiLoopbackCalibrator calibrator;
+        auto output = juce::MidiOutput::openDevice(outputInfo.identifier);
+        auto input = juce::MidiInput::openDevice(inputInfo.identifier, &calibrator);
+        if (output == nullptr || input == nullptr)
+            juce::ConsoleApplication::fail("Could not open the MIDI devices");
+
+        input->start();
+        auto result = calibrator.run(*output, 20);
+        input->stop();
+
+        std::cout << outputInfo.name << " -> " << inputInfo.name << ": " << result.numReceived << "/20 notes, round trip "
+                  << juce::String(result.roundTripMs, 2) << " ms, spread " << juce::String(result.spreadMs, 2) << " ms" << std::endl;
+        if (!result.ok)
+            juce::ConsoleApplication::fail("No notes came back");
+
+        LatencyProfiles profiles;
+        profiles.load(LatencyProfiles::getDefaultFile());
+        profiles.setMidiInputMs(inputInfo.name, 0.5 * result.roundTripMs);
+        profiles.save(LatencyProfiles::getDefaultFile());
+    }
+
+    static void midiSendJitter(const juce::ArgumentList &args)
+    {
+        args.checkMinNumArguments(2);
+        auto outputInfo = findMidiDevice(juce::MidiOutput::getAvailableDevices(), args[1].text);
+        auto inputName = args.size() > 2 && !args[2].isLongOption() ? args[2].text : juce::String();
+        auto inputInfo = findMidiDevice(juce::MidiInput::getAvailableDevices(), inputName);
+        if (outputInfo.identifier.isEmpty() || inputInfo.identifier.isEmpty())
+            juce::ConsoleApplication::fail("MIDI loopback devices not found");
+
+        auto numNotes = juce::jmax(1, getIntOption(args, "--notes", 50));
+        auto intervalMs = juce::jmax(10, getIntOption(args, "--interval-ms", 100));
+
+        MidiSendJitterMeter meter;
+        auto output = juce::MidiOutput::openDevice(outputInfo.identifier);
+        auto input = juce::MidiInput::openDevice(inputInfo.identifier, &meter);
+        if (output == nullptr || input == nullptr)
+            juce::ConsoleApplication::fail("Could not open the MIDI devices");
+
+        output->startBackgroundThread();
+        input->start();
+        auto result = meter.run(*output, numNotes, intervalMs);
+        input->stop();
+        output->stopBackgroundThread();
+
+        std::cout << outputInfo.name << " -> " << inputInfo.name << ": " << result.numReceived << "/" << numNotes
+                  << " notes, offset " << juce::String(result.offsetMs, 2) << " ms, jitter rms "
+                  << juce::String(result.jitterRmsMs, 2) << " ms, max " << juce::String(result.jitterMaxMs, 2) << " ms" << std::endl;
+        if (!result.ok)
+            juce::ConsoleApplication::fail("No notes came back");
+
+        LatencyProfiles profiles;
+        profiles.load(LatencyProfiles::getDefaultFile());
+        profiles.setMidiOutputMs(outputInfo.name, result.offsetMs);
+        profiles.save(LatencyProfiles::getDefaultFile());
+    }
+};
@@ -0,0 +1,233 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "PitchSet.h"
+#include "Metrics.h"
+#include "Tracing.h"
+
+// Note state shared between the MIDI/audio thread and the message thread
+// without locks. Held notes are an atomic 128-bit bitmap per channel; note
+// changes travel between threads through two single-producer queues:
+//   audio -> GUI  notes from MIDI input, drained by KeyboardStateBridge
+//   GUI -> audio  on-screen keyboard clicks, injected into the next block
+class LockFreeKeyboardState
+{
+public:
+    struct NoteEvent
+    {
+        bool isNoteOn;
+        juce::uint8 channel, note;
+        float velocity;
+    };
+
+    bool isNoteOn(int midiChannel, int note) const
+    {
+        if (!juce::isPositiveAndBelow(note, 128) || !juce::isPositiveAndBelow(midiChannel - 1, 16))
+            return false;
+
+        return (bits[(midiChannel - 1) * 2 + (note >> 6)].load(std::memory_order_relaxed) >> (note & 63)) & 1;
+    }
+
+    bool isNoteOnForChannels(int midiChannelMask, int note) const
+    {
+        for (auto ch = 1; ch <= 16; ++ch)
+            if ((midiChannelMask & (1 << (ch - 1))) != 0 && isNoteOn(ch, note))
+                return true;
+        return false;
+    }
+
+    // Snapshot of the notes held on any of the channels, for chord grading.
+    PitchSet::NoteSet getHeldNotes(int midiChannelMask) const
+    {
+        PitchSet::NoteSet held;
+        for (auto ch = 0; ch < 16; ++ch)
+            if ((midiChannelMask & (1 << ch)) != 0)
+                held = held | PitchSet::NoteSet(bits[ch * 2].load(std::memory_order_relaxed),
+                                                bits[ch * 2 + 1].load(std::memory_order_relaxed));
+        return held;
+    }
+
+    // Audio thread: updates the bitmap from incoming MIDI, forwards note
+    // changes to the GUI, and injects pending on-screen key presses.
+    void processNextMidiBuffer(juce::MidiBuffer &buffer, int startSample, int numSamples, bool injectIndirectEvents)
+    {
+        Metrics::get().midiEvents.add((juce::uint64)buffer.getNumEvents());
+        for (const auto metadata : buffer)
+        {
+            auto message = metadata.getMessage();
+            if (message.isNoteOn())
+            {
+                Tracer::getInstance().noteFlow(message.getNoteNumber(), Tracer::Phase::flowStep, "synth note-on");
+                setNote(message.getChannel(), message.getNoteNumber(), message.getFloatVelocity(), toGui);
+            }
+            else if (message.isNoteOff())
+                setNote(message.getChannel(), message.getNoteNumber(), 0.0f, toGui);
+            else if (message.isAllNotesOff() || message.isAllSoundOff())
+                allNotesOff(message.getChannel());
+        }
+
+        if (injectIndirectEvents)
+        {
+            NoteEvent e;
+            while (toAudio.pop(e))
+            {
+                if (e.isNoteOn)
+                    Tracer::getInstance().noteFlow(e.note, Tracer::Phase::flowStep, "synth note-on");
+                auto message = e.isNoteOn ? juce::MidiMessage::noteOn(e.channel, e.note, e.velocity)
+                                          : juce::MidiMessage::noteOff(e.channel, e.note);
+                buffer.addEvent(message, startSample);
+            }
+        }
+        juce::ignoreUnused(numSamples);
+    }
+
+    // Audio thread: releases every held note, or those on one channel.
+    void allNotesOff(int midiChannel)
+    {
+        for (auto ch = 1; ch <= 16; ++ch)
+        {
+            if (midiChannel > 0 && ch != midiChannel)
+                continue;
+
+            for (auto word = 0; word < 2; ++word)
+            {
+                auto held = bits[(ch - 1) * 2 + word].exchange(0);
+                for (auto bit = 0; held != 0; ++bit, held >>= 1)
+                    if (held & 1)
+                        toGui.push({false, (juce::uint8)ch, (juce::uint8)(word * 64 + bit), 0.0f});
+            }
+        }
+    }
+
+    // Message thread: an on-screen key changed.
+    void noteFromGui(int midiChannel, int note, float velocity, bool isOn)
+    {
+        setBit(midiChannel, note, isOn);
+        toAudio.push({isOn, (juce::uint8)midiChannel, (juce::uint8)note, velocity});
+    }
+
+    // Message thread: takes the next note change that came from MIDI input.
+    bool popGuiEvent(NoteEvent &e) { return toGui.pop(e); }
+
+    // Any thread: note changes from MIDI input are waiting for the GUI.
+    bool hasGuiEvents() const { return toGui.getNumReady() > 0; }
+
+private:
+    class EventQueue
+    {
+    public:
+        // Wait-free; drops the event if the consumer has fallen a full queue behind.
+        bool push(const NoteEvent &e)
+        {
+            int start1, size1, start2, size2;
+            fifo.prepareToWrite(1, start1, size1, start2, size2);
+            if (size1 == 0)
+            {
+                Metrics::get().midiEventsDropped.add();
+                return false;
+            }
+
+            events[start1] = e;
+            fifo.finishedWrite(1);
+            return true;
+        }
+
+        bool pop(NoteEvent &e)
+        {
+            int start1, size1, start2, size2;
+            fifo.prepareToRead(1, start1, size1, start2, size2);
+            if (size1 == 0)
+                return false;
+
+            e = events[start1];
+            fifo.finishedRead(1);
+            return true;
+        }
+
+        int getNumReady() const { return fifo.getNumReady(); }
+
+    private:
+        static constexpr int capacity = 1024;
+        juce::AbstractFifo fifo{capacity};
+        NoteEvent events[capacity];
+    };
+
+    void setNote(int midiChannel, int note, float velocity, EventQueue &queue)
+    {
+        auto isOn = velocity > 0.0f;
+        if (setBit(midiChannel, note, isOn))
+            queue.push({isOn, (juce::uint8)midiChannel, (juce::uint8)note, velocity});
+    }
+
+    // Returns true if the bit actually changed.
+    bool setBit(int midiChannel, int note, bool isOn)
+    {
+        if (!juce::isPositiveAndBelow(note, 128) || !juce::isPositiveAndBelow(midiChannel - 1, 16))
+            return false;
+
+        auto &word = bits[(midiChannel - 1) * 2 + (note >> 6)];
+        auto mask = (juce::uint64)1 << (note & 63);
+        auto previous = isOn ? word.fetch_or(mask) : word.fetch_and(~mask);
+        return ((previous & mask) != 0) != isOn;
+    }
+
+    std::atomic<juce::uint64> bits[32] = {};
+    EventQueue toGui, toAudio;
+};
+
+// Mirrors LockFreeKeyboardState into a juce::MidiKeyboardState that only the
+// message thread touches, so on-screen keyboard input and keyboard listeners keep
+// working while the audio thread never takes its lock. The owner drains it
+// once per GUI frame.
+class KeyboardStateBridge : private juce::MidiKeyboardStateListener
+{
+public:
+    explicit KeyboardStateBridge(LockFreeKeyboardState &s)
+        : state(s)
+    {
+        guiState.addListener(this);
+    }
+
+    ~KeyboardStateBridge() override
+    {
+        guiState.removeListener(this);
+    }
+
+    juce::MidiKeyboardState &getGuiState() { return guiState; }
+
+    // True while guiState listeners are being told about notes from MIDI input.
+    bool isApplyingFromAudio() const { return applyingFromAudio; }
+
+    // Applies pending changes from MIDI input now, notifying guiState's listeners.
+    void drainEvents()
+    {
+        Tracer::Scope traced("drain keyboard queue");
+        LockFreeKeyboardState::NoteEvent e;
+        applyingFromAudio = true;
+        while (state.popGuiEvent(e))
+        {
+            if (e.isNoteOn)
+                guiState.noteOn(e.channel, e.note, e.velocity);
+            else
+                guiState.noteOff(e.channel, e.note, e.velocity);
+        }
+        applyingFromAudio = false;
+    }
+
+private:
+    void handleNoteOn(juce::MidiKeyboardState *, int midiChannel, int midiNoteNumber, float velocity) override
+    {
+        if (!applyingFromAudio)
+            state.noteFromGui(midiChannel, midiNoteNumber, velocity, true);
+    }
+
+    void handleNoteOff(juce::MidiKeyboardState *, int midiChannel, int midiNoteNumber, float velocity) override
+    {
+        if (!applyingFromAudio)
+            state.noteFromGui(midiChannel, midiNoteNumber, velocity, false);
+    }
+
+    LockFreeKeyboardState &state;
+    juce::MidiKeyboardState guiState;
+    bool applyingFromAudio = false;
+};
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <thread>
+#include "HeadlessCommand.h"
+#include "LockFreeKeyboardState.h"
+
+// Headless mode for LockFreeKeyboardState: audio-thread cost under GUI contention.
+class LockFreeKeyboardStateCommands : private HeadlessCommand
+{
+public:
+    static void addTo(juce::ConsoleApplication &app)
+    {
+        app.addCommand({"--keyboard-contention",
+                        "--keyboard-contention [--blocks=N]",
+                        "Compares audio-thread keyboard state cost against juce::MidiKeyboardState under GUI load.",
+                        {},
+                        [](const juce::ArgumentList &a) { keyboardContention(a); }});
+    }
+
+private:
+    // Times the audio-side call while a second thread hammers the GUI side.
+    template <typename AudioCall, typename GuiCall>
+    static void measureContention(const char *name, int numBlocks, AudioCall audioCall, GuiCall guiCall)
+    {
+        std::atomic<bool> running{true};
+        std::thread gui([&]
+                        {
+                            for (auto i = 0; running; ++i)
+                                guiCall(i);
+                        });
+
+        juce::MidiBuffer midi;
+        juce::Random random(1);
+        juce::Array<double> times;
+        times.ensureStorageAllocated(numBlocks);
+
+        for (auto b = 0; b < numBlocks; ++b)
+        {
+            midi.clear();
+            for (auto e = 0; e < 4; ++e)
+            {
+                auto note = 36 + random.nextInt(48);
+                midi.addEvent(random.nextBool() ? juce::MidiMessage::noteOn(1, note, (juce::uint8)100)
+                                                : juce::MidiMessage::noteOff(1, note),
+                              e * 16);
+            }
+
+            auto start = juce::Time::getHighResolutionTicks();
+            audioCall(midi);
+            times.add(juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start) * 1.0e9);
+        }
+
+        running = false;
+        gui.join();
+
+        std::sort(times.begin(), times.end());
+        double total = 0.0;
+        for (auto t : times)
+            total += t;
+
+        std::cout << juce::String(name).paddedRight(' ', 22)
+                  << juce::String(total / numBlocks, 0).paddedLeft(' ', 9)
+                  << juce::String(times[(int)(numBlocks * 0.99)], 0).paddedLeft(' ', 9)
+                  << juce::String(times[(int)(numBlocks * 0.9999)], 0).paddedLeft(' ', 11)
+                  << juce::String(times.getLast(), 0).paddedLeft(' ', 10) << std::endl;
+    }
+
+    static void keyboardContention(const juce::ArgumentList &args)
+    {
+        auto numBlocks = getIntOption(args, "--blocks", 200000);
+
+        std::cout << "implementation          avg ns   p99 ns  p99.99 ns    max ns" << std::endl;
+        {
+            juce::MidiKeyboardState state;
+            measureContention("juce::MidiKeyboardState", numBlocks,
+                              [&](juce::MidiBuffer &midi) { state.processNextMidiBuffer(midi, 0, 64, true); },
+                              [&](int i)
+                              {
+                                  auto note = 36 + i % 48;
+                                  if (state.isNoteOnForChannels(0xffff, note))
+                                      state.noteOff(1, note, 0.0f);
+                                  else if (i % 7 == 0)
+                                      state.noteOn(1, note, 1.0f);
+                              });
+        }
+        {
+            LockFreeKeyboardState state;
+            measureContention("LockFreeKeyboardState", numBlocks,
+                              [&](juce::MidiBuffer &midi) { state.processNextMidiBuffer(midi, 0, 64, true); },
+                              [&](int i)
+                              {
+                                  auto note = 36 + i % 48;
+                                  LockFreeKeyboardState::NoteEvent e;
+                                  while (state.popGuiEvent(e))
+                                  {
+                                  }
+                                  if (state.isNoteOnForChannels(0xffff, note))
+                                      state.noteFromGui(1, note, 0.0f, false);
+                                  else if (i % 7 == 0)
+                                      state.noteFromGui(1, note, 1.0f, true);
+                              });
+        }
+    }
+};
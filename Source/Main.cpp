@@ -8,6 +8,7 @@
 
 #include <JuceHeader.h>
 #include "MainComponent.h"
+#include "EngineGraphCommands.h"
 
 //==============================================================================
 class SenseTrainerApplication  : public juce::JUCEApplication
@@ -24,6 +25,13 @@ public:
     void initialise (const juce::String& commandLine) override
     {
         // This method is where you should put your application's initialisation code..
+        int result = 0;
+        if (runCommand (commandLine, result))
+        {
+            setApplicationReturnValue(result);
+            quit();
+            return;
+        }
 
         mainWindow.reset (new MainWindow (getApplicationName()));
     }
@@ -43,6 +51,23 @@ public:
         quit();
     }
 
+    // The headless modes are in SenseTrainerCli. The app keeps only
+    // --graph-render, since juce_audio_processors needs the GUI modules and
+    // so cannot be part of the console build. --metrics is an option of the
+    // main window, not a mode.
+    static bool runCommand (const juce::String& commandLine, int& result)
+    {
+        juce::ArgumentList args ("SenseTrainer", commandLine);
+        if (args.size() == 0 || ! args[0].isLongOption() || args[0].isLongOption ("--metrics"))
+            return false;
+
+        juce::ConsoleApplication app;
+        app.addHelpCommand ("--help|-h", "Usage:", true);
+        EngineGraphCommands::addTo (app);
+        result = app.findAndRunCommand (args);
+        return true;
+    }
+
     void anotherInstanceStarted (const juce::String& commandLine) override
     {
         // When another instance of the app is launched while this one is running,
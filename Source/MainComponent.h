@@ -3,17 +3,29 @@
 #include <JuceHeader.h>
 #include "SenseComponent.h"
 #include "SynthUsingMidiInput.h"
+#include "AnswerGrader.h"
+#include "LatencyCalibration.h"
+#include "ReactionTime.h"
+#include "BufferSizeTuner.h"
+#include "IdlePowerSaver.h"
+#include "RealtimeThreads.h"
+#include "RepaintTracker.h"
+#include "QuizKeyboard.h"
+#include "UiFrameLoop.h"
+#include "MidiPromptOutput.h"
+#include "Metrics.h"
+#include "Tracing.h"
 
 class MainContentComponent : public juce::AudioAppComponent,
                              private juce::MidiInputCallback,
-                             private juce::MidiKeyboardStateListener,
-                             private juce::MultiTimer
+                             private juce::MidiKeyboardStateListener
 {
 public:
     MainContentComponent()
-        : synthAudioSource(keyboardState, UI),
-          UI(midiMessagesBox),
-          keyboardComponent(keyboardState, juce::MidiKeyboardComponent::horizontalKeyboard),
+        : synthAudioSource(keyboardState, session),
+          UI(midiMessagesBox, session),
+          keyboardBridge(keyboardState),
+          keyboardComponent(keyboardState, keyboardBridge.getGuiState()),
           startTime(juce::Time::getMillisecondCounterHiRes() * 0.001)
     {
 #if JUCE_WINDOWS
@@ -26,10 +38,16 @@ public:
         juce::String typeFaceName = "IPAGothic";
         juce::Desktop::getInstance().getDefaultLookAndFeel().setDefaultSansSerifTypefaceName(typeFaceName);
 #endif
+        session.loadState();
+        latencyProfiles.load(LatencyProfiles::getDefaultFile());
         setAudioChannels(0, 2);
+        RealtimeThreads::getInstance().lockMemory();
 
         setSize(800, 500);
-        startTimer(0, 400);
+        frameLoop.onFrame = [this]
+        { return updateFrame(); };
+        frameLoop.callAfter(400, [this]
+                            { startupComplete(); });
         addAndMakeVisible(midiInputListLabel);
         midiInputListLabel.setText("MIDI Input:", juce::dontSendNotification);
         midiInputListLabel.attachToComponent(&midiInputList, true);
@@ -58,8 +76,38 @@ public:
         if (midiInputList.getSelectedId() == 0)
             setMidiInput(0);
 
+        using Instrument = SynthAudioSource::Instrument;
+        addAndMakeVisible(instrumentList);
+        instrumentList.addItem("Sine", (int)Instrument::sine + 1);
+        instrumentList.addItem("Sampled piano", (int)Instrument::sampledPiano + 1);
+        instrumentList.addItem("Plucked string", (int)Instrument::pluckedString + 1);
+        instrumentList.addItem("Modal piano", (int)Instrument::modalPiano + 1);
+        instrumentList.setItemEnabled((int)Instrument::sampledPiano + 1,
+                                      synthAudioSource.getInstrument() == Instrument::sampledPiano);
+        instrumentList.setSelectedId((int)synthAudioSource.getInstrument() + 1, juce::dontSendNotification);
+        instrumentList.onChange = [this]
+        { synthAudioSource.setInstrument((SynthAudioSource::Instrument)(instrumentList.getSelectedId() - 1)); };
+
+        addAndMakeVisible(promptOutputList);
+        promptOutputList.addItem("Prompts: built-in", 1);
+        promptOutputList.addItemList(getMidiOutputNames(), 2);
+        promptOutputList.setSelectedId(1, juce::dontSendNotification);
+        promptOutputList.onChange = [this]
+        { setPromptOutput(promptOutputList.getSelectedId() - 2); };
+
+        addAndMakeVisible(realtimeToggle);
+        realtimeToggle.setToggleState(RealtimeThreads::getInstance().getSettings().enabled, juce::dontSendNotification);
+        realtimeToggle.onClick = [this]
+        { setRealtimeEnabled(realtimeToggle.getToggleState()); };
+
         addAndMakeVisible(keyboardComponent);
-        keyboardState.addListener(this);
+        keyboardComponent.getPrompted = [this]
+        {
+            auto note = midiPrompts.isOpen() ? midiPrompts.getSoundingNote(juce::Time::getMillisecondCounterHiRes())
+                                             : synthAudioSource.getPromptNote();
+            return note >= 0 ? PitchSet::NoteSet::of(note) : PitchSet::NoteSet();
+        };
+        keyboardBridge.getGuiState().addListener(this);
 
         addAndMakeVisible(midiMessagesBox);
         midiMessagesBox.setMultiLine(true);
@@ -73,36 +121,113 @@ public:
         midiMessagesBox.setColour(juce::TextEditor::shadowColourId, juce::Colour(0x16000000));
 
         addAndMakeVisible(UI);
+        addChildComponent(repaintOverlay);
+        midiMessagesBox.trackedName = "messages";
+        UI.onReplay = [this]
+        {
+            deviceSuspender.wake();
+            frameLoop.wake();
+            if (midiPrompts.isOpen() && !session.isRhythmMode())
+            {
+                // Only the latest replay's timer may end it; an earlier one
+                // would cut a restarted replay short.
+                auto replay = ++midiReplayCount;
+                frameLoop.callAfter(midiPrompts.play(session.quiz), [this, replay]
+                                    {
+                                        if (replay == midiReplayCount && session.replaying.load())
+                                            session.replayCompleted();
+                                    });
+            }
+        };
+        tuneBufferSize();
+        MetricsExporter::Settings metricsSettings;
+        if (MetricsExporter::isRequested(juce::ArgumentList("SenseTrainer", juce::JUCEApplicationBase::getCommandLineParameters()),
+                                         metricsSettings))
+            metricsExporter.start(metricsSettings);
     }
 
     ~MainContentComponent() override
     {
+        // deviceSuspender and answerTimestamps are destroyed before
+        // deviceManager, so a note arriving during shutdown must not reach them.
+        auto input = juce::MidiInput::getAvailableDevices()[lastInputIndex].identifier;
+        deviceManager.removeMidiInputDeviceCallback(input, &answerTimestamps);
+        deviceManager.removeMidiInputDeviceCallback(input, &deviceSuspender);
         shutdownAudio();
+        session.saveState();
     }
 
     void paint(juce::Graphics &g) override
     {
+        RepaintTracker::ScopedPaint tracked("main window");
         g.fillAll(juce::Colours::cadetblue);
     }
 
+    bool keyPressed(const juce::KeyPress &key) override
+    {
+        if (key == juce::KeyPress('r', juce::ModifierKeys::commandModifier | juce::ModifierKeys::shiftModifier, 0))
+        {
+            repaintOverlay.setShowing(!repaintOverlay.isVisible());
+            return true;
+        }
+        if (key == juce::KeyPress('t', juce::ModifierKeys::commandModifier | juce::ModifierKeys::shiftModifier, 0))
+        {
+            toggleTracing();
+            return true;
+        }
+        return false;
+    }
+
     void resized() override
     {
         auto area = getLocalBounds();
 
-        midiInputList.setBounds(area.removeFromTop(36).removeFromRight(getWidth() - 80).reduced(8));
+        auto top = area.removeFromTop(36);
+        realtimeToggle.setBounds(top.removeFromRight(100).reduced(8));
+        instrumentList.setBounds(top.removeFromRight(160).reduced(8));
+        promptOutputList.setBounds(top.removeFromRight(180).reduced(8));
+        midiInputList.setBounds(top.removeFromRight(top.getWidth() - 80).reduced(8));
         keyboardComponent.setBounds(area.removeFromBottom(110).reduced(8));
         midiMessagesBox.setBounds(area.removeFromRight(getWidth() - 400).reduced(8));
         UI.setBounds(area.removeFromLeft(400).reduced(8));
+        repaintOverlay.setBounds(getWidth() - 330, 40, 320, 110);
     }
 
     void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override
     {
         synthAudioSource.prepareToPlay(samplesPerBlockExpected, sampleRate);
+        callbackMonitor.prepare(samplesPerBlockExpected, sampleRate);
+        audioThreadConfigured = false;
+        Metrics::get().sampleRate.set(sampleRate);
+        Metrics::get().bufferSize.set(samplesPerBlockExpected);
+
+        // A block rendered now is heard one buffer plus the device latency later.
+        if (auto *device = juce::AudioAppComponent::deviceManager.getCurrentAudioDevice())
+            synthAudioSource.getRhythmEngine().setLatencyCompensation(getOutputLatency(*device, sampleRate) + samplesPerBlockExpected);
     }
 
     void getNextAudioBlock(const juce::AudioSourceChannelInfo &bufferToFill) override
     {
+        // A restarted device may call back on a new thread.
+        if (!audioThreadConfigured)
+        {
+            RealtimeThreads::getInstance().enterRealtime(RealtimeThreads::Role::audio, 0);
+            Tracer::getInstance().setThreadName("audio");
+            audioThreadConfigured = true;
+        }
+
+        Tracer::Scope traced("audio callback");
+        auto started = callbackMonitor.begin();
         synthAudioSource.getNextAudioBlock(bufferToFill);
+        callbackMonitor.end(started, bufferToFill.numSamples);
+
+        // Anything for the GUI restarts its frames; a flag store while they run.
+        if (keyboardState.hasGuiEvents() || session.isCompletionPending() || synthAudioSource.getRhythmEngine().isFinished())
+            frameLoop.wake();
+
+        auto &metrics = Metrics::get();
+        metrics.audioCallbacks.add();
+        metrics.audioCallbackSeconds.recordTicks(juce::Time::getHighResolutionTicks() - started);
     }
 
     void releaseResources() override
@@ -111,21 +236,165 @@ public:
     }
 
 private:
-    void timerCallback(int timerID) override
+    // A calibrated latency replaces what the driver reports.
+    int getOutputLatency(juce::AudioIODevice &device, double sampleRate) const
+    {
+        LatencyProfiles::AudioLatency measured;
+        return latencyProfiles.getAudio(device.getName(), measured) ? juce::roundToInt(measured.outputMs * 0.001 * sampleRate)
+                                                                    : device.getOutputLatencyInSamples();
+    }
+
+    // Uses the buffer size stored for this device, or finds one by stepping
+    // down while the synth plays a test load.
+    void tuneBufferSize()
     {
-        switch (timerID)
+        auto &audioDevices = juce::AudioAppComponent::deviceManager;
+        auto *device = audioDevices.getCurrentAudioDevice();
+        if (device == nullptr)
+            return;
+
+        auto stored = 0;
+        if (latencyProfiles.getBufferSize(device->getName(), device->getCurrentSampleRate(), stored))
+        {
+            auto setup = audioDevices.getAudioDeviceSetup();
+            setup.bufferSize = stored;
+            audioDevices.setAudioDeviceSetup(setup, true);
+            showKeyToSoundLatency();
+            return;
+        }
+
+        bufferTuner.onLoadChanged = [this](bool on)
+        { synthAudioSource.setLoadTest(on); };
+        bufferTuner.onFinished = [this](const BufferSizeTuner::Result &result)
         {
-        case 0:
-            keyboardComponent.grabKeyboardFocus();
-            stopTimer(0);
-            break;
-        case 1:
+            midiMessagesBox.moveCaretToEnd();
+            midiMessagesBox.insertTextAtCaret(result.describe());
+            if (result.ok)
+            {
+                latencyProfiles.setBufferSize(result.deviceName, result.sampleRate, result.bufferSize);
+                latencyProfiles.save(LatencyProfiles::getDefaultFile());
+            }
             UI.setEnabled(true);
-            UI.nextQuiz();
-            stopTimer(1);
-            mistakes = 0;
-            count = 0;
-            break;
+            showKeyToSoundLatency();
+        };
+
+        UI.setEnabled(false);
+        midiMessagesBox.moveCaretToEnd();
+        midiMessagesBox.insertTextAtCaret("Finding the smallest stable audio buffer size..." + juce::String(juce::newLine));
+        bufferTuner.start();
+    }
+
+    void showKeyToSoundLatency()
+    {
+        auto *device = juce::AudioAppComponent::deviceManager.getCurrentAudioDevice();
+        if (device == nullptr)
+            return;
+
+        auto sampleRate = device->getCurrentSampleRate();
+        auto bufferSize = device->getCurrentBufferSizeSamples();
+        auto midiInput = juce::MidiInput::getAvailableDevices()[lastInputIndex].name;
+        auto latency = BufferSizeTuner::keyToSoundMs(bufferSize, getOutputLatency(*device, sampleRate), sampleRate,
+                                                     latencyProfiles.getMidiInputMs(midiInput));
+
+        midiMessagesBox.moveCaretToEnd();
+        midiMessagesBox.insertTextAtCaret("Audio buffer " + juce::String(bufferSize) + " samples, key-to-sound latency about "
+                                          + juce::String(latency, 1) + " ms" + juce::newLine);
+    }
+
+    // Ctrl/Cmd+Shift+T starts a trace; pressing it again saves it.
+    void toggleTracing()
+    {
+        auto &tracer = Tracer::getInstance();
+        juce::String text;
+        if (!tracer.isEnabled())
+        {
+            tracer.setEnabled(true);
+            text = "Tracing started";
+        }
+        else
+        {
+            tracer.setEnabled(false);
+            auto file = Tracer::getDefaultFile();
+            text = tracer.exportChromeJson(file) ? "Trace saved to " + file.getFullPathName() : juce::String("Could not save the trace");
+            if (auto dropped = tracer.getNumDroppedEvents())
+                text << " (" << (juce::int64)dropped << " events dropped: too many threads)";
+        }
+
+        midiMessagesBox.moveCaretToEnd();
+        midiMessagesBox.insertTextAtCaret(text + juce::newLine);
+    }
+
+    // One GUI frame: applies everything the engine and the input produced
+    // since the last one. Returns true while a replay or a rhythm take is
+    // changing the display without queuing anything.
+    bool updateFrame()
+    {
+        keyboardBridge.drainEvents();
+        session.dispatchReplayCompleted();
+        showRhythmResult();
+        flushMessageList();
+        keyboardComponent.refresh();
+        return session.replaying.load() || !synthAudioSource.getRhythmEngine().isIdle();
+    }
+
+    void startupComplete()
+    {
+        Tracer::Scope traced("startup");
+        keyboardComponent.grabKeyboardFocus();
+        if (RealtimeThreads::getInstance().getSettings().enabled)
+        {
+            midiMessagesBox.moveCaretToEnd();
+            midiMessagesBox.insertTextAtCaret(RealtimeThreads::getInstance().getReport().joinIntoString(juce::newLine)
+                                              + juce::newLine);
+        }
+    }
+
+    // A second after a correct answer, so the result can be read.
+    void scheduleNextQuiz()
+    {
+        frameLoop.callAfter(1000, [this]
+                            {
+                                Tracer::Scope traced("next quiz");
+                                UI.setEnabled(true);
+                                UI.nextQuiz();
+                                grader.reset();
+                                keyboardComponent.clearMarks();
+                            });
+    }
+
+    void showRhythmResult()
+    {
+        auto &rhythm = synthAudioSource.getRhythmEngine();
+        if (!rhythm.isFinished())
+            return;
+
+        session.replayCompleted();
+        RhythmEngine::TakeResult result;
+        rhythm.takeFinished(result);
+        auto timing = rhythm.getTimingReport();
+
+        midiMessagesBox.moveCaretToEnd();
+        midiMessagesBox.insertTextAtCaret("Taps " + juce::String(result.numTaps) + "/" + juce::String(result.numExpected)
+                                          + ", mean " + juce::String(result.meanErrorMs, 1) + " ms, spread "
+                                          + juce::String(result.spreadMs, 1) + " ms, worst "
+                                          + juce::String(result.worstErrorMs, 1) + " ms" + juce::newLine);
+        midiMessagesBox.insertTextAtCaret("Callback jitter " + juce::String(timing.callbackJitterRmsUs, 0) + " us rms, "
+                                          + juce::String(timing.callbackJitterMaxUs, 0) + " us max; note placement "
+                                          + juce::String(timing.eventPlacementMaxUs, 1) + " us; latency compensation "
+                                          + juce::String(timing.latencyCompensationMs, 1) + " ms" + juce::newLine);
+
+        if (result.passed)
+        {
+            midiMessagesBox.setColour(juce::TextEditor::textColourId, juce::Colours::yellow);
+            midiMessagesBox.insertTextAtCaret(juce::String::fromUTF8(u8"Correct! (mistakes: ") + juce::String(grader.getMistakes()) + ")" + juce::newLine);
+            midiMessagesBox.setColour(juce::TextEditor::textColourId, juce::Colours::white);
+            session.quizAnswered(grader.getMistakes());
+            UI.setEnabled(false);
+            scheduleNextQuiz();
+        }
+        else
+        {
+            grader.countMistake();
         }
     }
 
@@ -135,6 +404,10 @@ private:
 
         deviceManager.removeMidiInputDeviceCallback(list[lastInputIndex].identifier,
                                                     synthAudioSource.getMidiCollector());
+        deviceManager.removeMidiInputDeviceCallback(list[lastInputIndex].identifier,
+                                                    &synthAudioSource.getRhythmEngine());
+        deviceManager.removeMidiInputDeviceCallback(list[lastInputIndex].identifier, &answerTimestamps);
+        deviceManager.removeMidiInputDeviceCallback(list[lastInputIndex].identifier, &deviceSuspender);
 
         auto newInput = list[index];
 
@@ -142,102 +415,205 @@ private:
             deviceManager.setMidiInputDeviceEnabled(newInput.identifier, true);
 
         deviceManager.addMidiInputDeviceCallback(newInput.identifier, synthAudioSource.getMidiCollector());
+        deviceManager.addMidiInputDeviceCallback(newInput.identifier, &synthAudioSource.getRhythmEngine());
+        deviceManager.addMidiInputDeviceCallback(newInput.identifier, &answerTimestamps);
+        deviceManager.addMidiInputDeviceCallback(newInput.identifier, &deviceSuspender);
+
+        auto midiLatency = latencyProfiles.getMidiInputMs(newInput.name);
+        answerTimestamps.setInputLatencyMs(midiLatency);
+        synthAudioSource.getRhythmEngine().setMidiInputLatencyMs(midiLatency);
         midiInputList.setSelectedId(index + 1, juce::dontSendNotification);
 
         lastInputIndex = index;
     }
-    void handleIncomingMidiMessage(juce::MidiInput *source, const juce::MidiMessage &message) override
+    static juce::StringArray getMidiOutputNames()
     {
+        juce::StringArray names;
+        for (auto &output : juce::MidiOutput::getAvailableDevices())
+            names.add(output.name);
+        return names;
     }
 
-    void handleNoteOn(juce::MidiKeyboardState *, int midiChannel, int midiNoteNumber, float velocity) override
+    // Threads take the setting as they start, so it applies from the next launch.
+    void setRealtimeEnabled(bool enabled)
+    {
+        auto settings = RealtimeThreads::getInstance().getSettings();
+        settings.enabled = enabled;
+        RealtimeThreads::getInstance().setSettings(settings);
+
+        auto file = RealtimeThreads::getDefaultFile();
+        midiMessagesBox.moveCaretToEnd();
+        if (settings.save(file))
+            midiMessagesBox.insertTextAtCaret(juce::String("Real-time audio ") + (enabled ? "on" : "off")
+                                              + " from the next start" + juce::newLine);
+        else
+            midiMessagesBox.insertTextAtCaret("Could not write " + file.getFullPathName() + juce::newLine);
+    }
+
+    // index -1 plays prompts on the built-in synth.
+    void setPromptOutput(int index)
     {
-        if (!isAddingFromMidiInput && UI.buttonflag == false && UI.answerflag == true && UI.quiz[count])
+        midiPrompts.close();
+        auto outputs = juce::MidiOutput::getAvailableDevices();
+        if (juce::isPositiveAndBelow(index, outputs.size()))
         {
-            auto m = juce::MidiMessage::noteOn(midiChannel, midiNoteNumber, velocity);
-            m.setTimeStamp(juce::Time::getMillisecondCounterHiRes() * 0.001);
-            const juce::MessageManagerLock messageManagerLock;
-            if (previousNoteNumber == midiNoteNumber)
+            if (midiPrompts.open(outputs[index]))
             {
-                return;
+                midiPrompts.setLatencyMs(latencyProfiles.getMidiOutputMs(outputs[index].name));
             }
-            if ((midiNoteNumber % 12 != UI.quiz[count] % 12) || (count ? (midiNoteNumber - previousNoteNumber != UI.quiz[count] - UI.quiz[count - 1]) : 0))
+            else
             {
-                midiMessagesBox.setColour(juce::TextEditor::textColourId, juce::Colours::orangered);
+                midiMessagesBox.moveCaretToEnd();
+                midiMessagesBox.insertTextAtCaret("Could not open " + outputs[index].name + juce::newLine);
+                promptOutputList.setSelectedId(1, juce::dontSendNotification);
             }
-            previousNoteNumber = midiNoteNumber;
-            count++;
-            postMessageToList(m, juce::MidiMessage::getMidiNoteName(m.getNoteNumber(), true, true, 3));
         }
+        synthAudioSource.setExternalPrompts(midiPrompts.isOpen());
     }
 
-    void handleNoteOff(juce::MidiKeyboardState *, int midiChannel, int midiNoteNumber, float) override
+    void handleIncomingMidiMessage(juce::MidiInput *source, const juce::MidiMessage &message) override
     {
     }
-    class IncomingMessageCallback : public juce::CallbackMessage
+
+    void handleNoteOn(juce::MidiKeyboardState *, int midiChannel, int midiNoteNumber, float velocity) override
     {
-    public:
-        IncomingMessageCallback(MainContentComponent *o, const juce::MidiMessage &m, const juce::String &s)
-            : owner(o), message(m), source(s)
+        deviceSuspender.wake();
+        Metrics::get().notesReceived.add();
+        Tracer::Scope traced("handleNoteOn");
+        if (keyboardBridge.isApplyingFromAudio())
+            Tracer::getInstance().noteFlow(midiNoteNumber, Tracer::Phase::flowStep, "grade");
+        else
+            Tracer::getInstance().beginNoteFlow(midiNoteNumber);
+        if (session.isRhythmMode())
         {
+            // Taps from MIDI input are timestamped by the device callback instead.
+            if (session.replaying.load() && !keyboardBridge.isApplyingFromAudio())
+                synthAudioSource.getRhythmEngine().tapAt(juce::Time::getMillisecondCounterHiRes() * 0.001);
+            return;
         }
 
-        void messageCallback() override
+        if (isAddingFromMidiInput || !grader.isExpectingNote())
+            return;
+
+        // Notes from MIDI input carry the time the key was pressed.
+        auto now = juce::Time::getMillisecondCounterHiRes() * 0.001;
+        auto pressed = keyboardBridge.isApplyingFromAudio() ? answerTimestamps.getPressTime(midiNoteNumber, now) : now;
+        auto firstNote = grader.getPosition() == 0 && grader.getMistakes() == 0;
+        auto result = grader.grade(midiNoteNumber);
+        if (result == AnswerGrader::Result::ignored)
+            return;
+
+        if (result == AnswerGrader::Result::wrong)
+            keyboardComponent.markWrong(midiNoteNumber);
+        else
+            keyboardComponent.markCorrect(midiNoteNumber);
+
+        if (firstNote)
         {
-            if (owner != nullptr)
-                owner->addMessageToList(message, source);
+            auto reaction = midiPrompts.isOpen() ? midiPrompts.getTimeSincePrompt(pressed)
+                                                 : synthAudioSource.getTimeSincePrompt(pressed);
+            reactionMs = reaction >= 0.0 ? reaction * 1000.0 : -1.0;
         }
+        auto m = juce::MidiMessage::noteOn(midiChannel, midiNoteNumber, velocity);
+        m.setTimeStamp(pressed);
+        postMessageToList(m, juce::MidiMessage::getMidiNoteName(m.getNoteNumber(), true, true, 3), result);
+    }
 
-        Component::SafePointer<MainContentComponent> owner;
+    void handleNoteOff(juce::MidiKeyboardState *, int midiChannel, int midiNoteNumber, float) override
+    {
+        deviceSuspender.wake();
+    }
+    struct PendingMessage
+    {
         juce::MidiMessage message;
         juce::String source;
+        AnswerGrader::Result result;
     };
 
-    void postMessageToList(const juce::MidiMessage &message, const juce::String &source)
+    // Graded notes are shown by the next frame, all in one go.
+    void postMessageToList(const juce::MidiMessage &message, const juce::String &source, AnswerGrader::Result result)
     {
-        (new IncomingMessageCallback(this, message, source))->post();
+        pendingMessages.push_back({message, source, result});
+        frameLoop.wake();
     }
 
-    void addMessageToList(const juce::MidiMessage &message, const juce::String &source)
+    void flushMessageList()
     {
-        juce::String displayText;
-        UI.quiz[count] ? displayText = source + juce::String::fromUTF8(u8"->") : displayText = source;
+        for (auto &pending : pendingMessages)
+            addMessageToList(pending.message, pending.source, pending.result);
+        pendingMessages.clear();
+    }
+
+    void addMessageToList(const juce::MidiMessage &message, const juce::String &source, AnswerGrader::Result result)
+    {
+        Tracer::Scope traced("addMessageToList");
+        Tracer::getInstance().noteFlow(message.getNoteNumber(), Tracer::Phase::flowEnd, "message list");
+        auto &metrics = Metrics::get();
+        metrics.feedbackSeconds.recordSeconds(juce::Time::getMillisecondCounterHiRes() * 0.001 - message.getTimeStamp());
+
         midiMessagesBox.moveCaretToEnd();
-        midiMessagesBox.insertTextAtCaret(displayText);
-        if (!UI.quiz[count] && midiMessagesBox.findColour(midiMessagesBox.textColourId) == juce::Colours::white)
+        if (result == AnswerGrader::Result::wrong)
         {
-            midiMessagesBox.setColour(juce::TextEditor::textColourId, juce::Colours::yellow);
-            displayText = juce::String::fromUTF8(u8" Correct! (mistakes: ") + juce::String::String(mistakes) + juce::String::fromUTF8(u8")");
-            midiMessagesBox.moveCaretToEnd();
-            midiMessagesBox.insertTextAtCaret(displayText + juce::newLine);
+            midiMessagesBox.setColour(juce::TextEditor::textColourId, juce::Colours::orangered);
+            midiMessagesBox.insertTextAtCaret(source + juce::newLine);
             midiMessagesBox.setColour(juce::TextEditor::textColourId, juce::Colours::white);
-            const juce::MessageManagerLock messageManagerLock;
-            UI.setEnabled(false);
-            startTimer(1, 1000);
+            metrics.answerMistakes.add();
+            return;
         }
-        else if (midiMessagesBox.findColour(midiMessagesBox.textColourId) == juce::Colours::orangered)
+        if (result == AnswerGrader::Result::step)
         {
-            midiMessagesBox.insertTextAtCaret(juce::newLine);
-            midiMessagesBox.setColour(juce::TextEditor::textColourId, juce::Colours::white);
-            mistakes++;
-            count = 0;
+            midiMessagesBox.insertTextAtCaret(source + juce::String::fromUTF8(u8"->"));
+            return;
+        }
+
+        midiMessagesBox.insertTextAtCaret(source);
+        midiMessagesBox.setColour(juce::TextEditor::textColourId, juce::Colours::yellow);
+        metrics.answersCorrect.add();
+        auto displayText = juce::String::fromUTF8(u8" Correct! (mistakes: ") + juce::String(grader.getMistakes()) + juce::String::fromUTF8(u8")");
+        if (reactionMs >= 0.0)
+        {
+            displayText << " " << juce::roundToInt(reactionMs) << " ms";
+            UI.recordReaction(reactionMs);
+            reactionMs = -1.0;
         }
+        midiMessagesBox.moveCaretToEnd();
+        midiMessagesBox.insertTextAtCaret(displayText + juce::newLine);
+        midiMessagesBox.setColour(juce::TextEditor::textColourId, juce::Colours::white);
+        session.quizAnswered(grader.getMistakes());
+        UI.setEnabled(false);
+        scheduleNextQuiz();
     }
 
-    juce::MidiKeyboardState keyboardState;
+    QuizSession session;
+    AnswerGrader grader{session};
+    LockFreeKeyboardState keyboardState;
     SynthAudioSource synthAudioSource;
-    juce::MidiKeyboardComponent keyboardComponent;
+    KeyboardStateBridge keyboardBridge;
+    QuizKeyboardComponent keyboardComponent;
     juce::ComboBox midiInputList;
     juce::Label midiInputListLabel;
+    juce::ComboBox instrumentList;
+    juce::ComboBox promptOutputList;
+    juce::ToggleButton realtimeToggle{"Real-time"};
+    MidiPromptOutput midiPrompts;
+    int midiReplayCount = 0;
     int lastInputIndex = 0;
-    int count = 0;
-    int mistakes = 0;
-    int previousNoteNumber = 0;
     juce::AudioDeviceManager deviceManager;
     bool isAddingFromMidiInput = false;
-    juce::TextEditor midiMessagesBox;
+    RepaintTracker::Tracked<juce::TextEditor> midiMessagesBox;
     double startTime;
+    LatencyProfiles latencyProfiles;
+    CallbackMonitor callbackMonitor;
+    bool audioThreadConfigured = false;
+    BufferSizeTuner bufferTuner{juce::AudioAppComponent::deviceManager, callbackMonitor};
+    AudioDeviceSuspender deviceSuspender{juce::AudioAppComponent::deviceManager, synthAudioSource.getIdleDetector()};
+    RepaintOverlay repaintOverlay;
+    MetricsExporter metricsExporter;
+    AnswerTimestamps answerTimestamps;
+    double reactionMs = -1.0;
+    std::vector<PendingMessage> pendingMessages;
     UserInterface UI;
+    UiFrameLoop frameLoop;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MainContentComponent)
 };
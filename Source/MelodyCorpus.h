@@ -0,0 +1,429 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+// Read-only, memory-mapped corpus of monophonic phrases. Everything the quiz
+// generator needs is precomputed by MelodyCorpusBuilder, so a lookup only
+// touches a couple of index tables and never parses MIDI.
+//
+// File layout (little-endian, every section 4-byte aligned):
+//   Header, PhraseRecord[numPhrases], uint8 notes[numNotes] (padded),
+//   uint32 bucketOffsets[numBuckets + 1], uint32 bucketIds[numPhrases],
+//   uint32 ngramOffsets[numNgrams + 1], uint32 postings[numPostings]
+class MelodyCorpus
+{
+public:
+    static constexpr juce::uint32 fileMagic = 0x4d43524f;
+    // Version 2 phrases never repeat a note straight after itself.
+    static constexpr juce::uint32 fileVersion = 2;
+    static constexpr int minPhraseLength = 3;
+    static constexpr int maxPhraseLength = 16;
+    static constexpr int numDifficultyBuckets = 16;
+    static constexpr int numBuckets = (maxPhraseLength + 1) * numDifficultyBuckets;
+    static constexpr int maxNgramInterval = 12;
+    static constexpr int ngramRadix = 2 * maxNgramInterval + 1;
+    static constexpr int numNgrams = ngramRadix * ngramRadix * ngramRadix;
+
+    struct Header
+    {
+        juce::uint32 magic, version, numPhrases, numNotes, numPostings, reserved;
+    };
+
+    struct PhraseRecord
+    {
+        juce::uint32 firstNote;
+        juce::uint8 length;
+        juce::uint8 difficulty;
+        juce::int8 lowOffset;  // lowest note relative to the first one
+        juce::int8 highOffset; // highest note relative to the first one
+    };
+
+    struct Query
+    {
+        int length = 5;
+        int minDifficulty = 0, maxDifficulty = 255;
+        int maxBelow = 12, maxAbove = 12;
+    };
+
+    bool open(const juce::File &file)
+    {
+        mapped.reset(new juce::MemoryMappedFile(file, juce::MemoryMappedFile::readOnly));
+        auto *data = static_cast<const juce::uint8 *>(mapped->getData());
+        auto size = mapped->getSize();
+
+        if (data == nullptr || size < sizeof(Header))
+            return close();
+
+        header = reinterpret_cast<const Header *>(data);
+        if (header->magic != fileMagic || header->version != fileVersion)
+            return close();
+
+        size_t offset = sizeof(Header);
+        records = reinterpret_cast<const PhraseRecord *>(data + offset);
+        offset += sizeof(PhraseRecord) * header->numPhrases;
+        notes = data + offset;
+        offset += alignedSize(header->numNotes);
+        bucketOffsets = reinterpret_cast<const juce::uint32 *>(data + offset);
+        offset += sizeof(juce::uint32) * (numBuckets + 1);
+        bucketIds = reinterpret_cast<const juce::uint32 *>(data + offset);
+        offset += sizeof(juce::uint32) * header->numPhrases;
+        ngramOffsets = reinterpret_cast<const juce::uint32 *>(data + offset);
+        offset += sizeof(juce::uint32) * (numNgrams + 1);
+        postings = reinterpret_cast<const juce::uint32 *>(data + offset);
+        offset += sizeof(juce::uint32) * header->numPostings;
+
+        if (offset > size || !isConsistent())
+            return close();
+
+        return true;
+    }
+
+    bool close()
+    {
+        mapped.reset();
+        header = nullptr;
+        return false;
+    }
+
+    bool isOpen() const { return header != nullptr; }
+    int getNumPhrases() const { return isOpen() ? (int)header->numPhrases : 0; }
+    const PhraseRecord &getPhrase(int index) const { return records[index]; }
+    const juce::uint8 *getNotes(int index) const { return notes + records[index].firstNote; }
+
+    // Picks a random phrase that satisfies the query, or returns -1.
+    int findPhrase(const Query &q, juce::Random &random) const
+    {
+        if (!isOpen() || q.length < 0 || q.length > maxPhraseLength)
+            return -1;
+
+        auto firstBucket = q.length * numDifficultyBuckets + juce::jlimit(0, 255, q.minDifficulty) / 16;
+        auto lastBucket = q.length * numDifficultyBuckets + juce::jlimit(0, 255, q.maxDifficulty) / 16;
+        auto begin = bucketOffsets[firstBucket];
+        auto count = bucketOffsets[lastBucket + 1] - begin;
+
+        return scan(bucketIds + begin, count, random, [&](const PhraseRecord &r)
+                    { return r.difficulty >= q.minDifficulty && r.difficulty <= q.maxDifficulty
+                             && -r.lowOffset <= q.maxBelow && r.highOffset <= q.maxAbove; });
+    }
+
+    // Picks a random phrase containing the given three consecutive intervals.
+    int findPhraseWithIntervals(int i1, int i2, int i3, const Query &q, juce::Random &random) const
+    {
+        auto key = ngramKey(i1, i2, i3);
+        if (!isOpen() || key < 0)
+            return -1;
+
+        auto begin = ngramOffsets[key];
+        return scan(postings + begin, ngramOffsets[key + 1] - begin, random, [&](const PhraseRecord &r)
+                    { return r.length == q.length && -r.lowOffset <= q.maxBelow && r.highOffset <= q.maxAbove; });
+    }
+
+    static int ngramKey(int i1, int i2, int i3)
+    {
+        if (std::abs(i1) > maxNgramInterval || std::abs(i2) > maxNgramInterval || std::abs(i3) > maxNgramInterval)
+            return -1;
+
+        return ((i1 + maxNgramInterval) * ngramRadix + (i2 + maxNgramInterval)) * ngramRadix + (i3 + maxNgramInterval);
+    }
+
+    static size_t alignedSize(size_t size) { return (size + 3) & ~(size_t)3; }
+
+    static juce::File getDefaultFile()
+    {
+        return juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+            .getChildFile("SenseTrainer")
+            .getChildFile("corpus.bin");
+    }
+
+private:
+    // Every offset and id in the tables must stay inside the mapping, since
+    // lookups follow them without checks.
+    bool isConsistent() const
+    {
+        for (juce::uint32 id = 0; id < header->numPhrases; ++id)
+        {
+            auto &r = records[id];
+            if (r.length > maxPhraseLength || r.firstNote > header->numNotes || r.length > header->numNotes - r.firstNote)
+                return false;
+        }
+
+        return isOffsetTable(bucketOffsets, numBuckets, header->numPhrases) && areIds(bucketIds, header->numPhrases)
+               && isOffsetTable(ngramOffsets, numNgrams, header->numPostings) && areIds(postings, header->numPostings);
+    }
+
+    // Starts at zero, never decreases and ends at total.
+    static bool isOffsetTable(const juce::uint32 *offsets, int numEntries, juce::uint32 total)
+    {
+        if (offsets[0] != 0 || offsets[numEntries] != total)
+            return false;
+
+        for (auto i = 0; i < numEntries; ++i)
+            if (offsets[i] > offsets[i + 1])
+                return false;
+        return true;
+    }
+
+    bool areIds(const juce::uint32 *ids, juce::uint32 count) const
+    {
+        for (juce::uint32 i = 0; i < count; ++i)
+            if (ids[i] >= header->numPhrases)
+                return false;
+        return true;
+    }
+
+    // Starts at a random candidate and takes the first match, giving up after
+    // a bounded number of probes so a lookup never walks a whole bucket.
+    template <typename Predicate>
+    int scan(const juce::uint32 *ids, juce::uint32 count, juce::Random &random, Predicate matches) const
+    {
+        if (count == 0)
+            return -1;
+
+        auto start = (juce::uint32)random.nextInt((int)count);
+        auto probes = juce::jmin(count, (juce::uint32)maxProbes);
+        for (juce::uint32 i = 0; i < probes; ++i)
+        {
+            auto id = ids[(start + i) % count];
+            if (matches(records[id]))
+                return (int)id;
+        }
+        return -1;
+    }
+
+    static constexpr int maxProbes = 512;
+
+    std::unique_ptr<juce::MemoryMappedFile> mapped;
+    const Header *header = nullptr;
+    const PhraseRecord *records = nullptr;
+    const juce::uint8 *notes = nullptr;
+    const juce::uint32 *bucketOffsets = nullptr, *bucketIds = nullptr;
+    const juce::uint32 *ngramOffsets = nullptr, *postings = nullptr;
+};
+
+// Collects phrases from Standard MIDI Files and writes the indexed corpus.
+class MelodyCorpusBuilder
+{
+public:
+    void addPhrase(const juce::uint8 *phrase, int length)
+    {
+        if (length < MelodyCorpus::minPhraseLength || length > MelodyCorpus::maxPhraseLength)
+            return;
+
+        // AnswerGrader ignores a key played again straight away, so such a
+        // phrase could never be answered.
+        for (auto i = 1; i < length; ++i)
+            if (phrase[i] == phrase[i - 1])
+                return;
+
+        MelodyCorpus::PhraseRecord r;
+        r.firstNote = (juce::uint32)notes.size();
+        r.length = (juce::uint8)length;
+        r.difficulty = (juce::uint8)difficultyOf(phrase, length);
+        int low = 0, high = 0;
+        for (auto i = 1; i < length; ++i)
+        {
+            low = juce::jmin(low, phrase[i] - phrase[0]);
+            high = juce::jmax(high, phrase[i] - phrase[0]);
+        }
+        r.lowOffset = (juce::int8)juce::jmax(-127, low);
+        r.highOffset = (juce::int8)juce::jmin(127, high);
+
+        records.push_back(r);
+        notes.insert(notes.end(), phrase, phrase + length);
+    }
+
+    int getNumPhrases() const { return (int)records.size(); }
+
+    // Parses the files on a thread pool; phrases are merged as each file finishes.
+    void importMidiFiles(const juce::Array<juce::File> &files, int numThreads)
+    {
+        juce::ThreadPool pool(juce::jmax(1, numThreads));
+        std::atomic<int> next{0}, numRunning{pool.getNumThreads()};
+        juce::WaitableEvent finished;
+        juce::CriticalSection lock;
+
+        for (auto t = 0; t < pool.getNumThreads(); ++t)
+        {
+            pool.addJob([&]
+                        {
+                            std::vector<juce::uint8> phrases;
+                            std::vector<int> lengths;
+                            for (auto index = next++; index < files.size(); index = next++)
+                            {
+                                phrases.clear();
+                                lengths.clear();
+                                extractPhrases(files.getReference(index), phrases, lengths);
+
+                                const juce::ScopedLock sl(lock);
+                                auto *p = phrases.data();
+                                for (auto length : lengths)
+                                {
+                                    addPhrase(p, length);
+                                    p += length;
+                                }
+                            }
+
+                            if (--numRunning == 0)
+                                finished.signal(); });
+        }
+
+        finished.wait(-1);
+    }
+
+    bool write(const juce::File &file) const
+    {
+        using juce::uint32;
+        auto numPhrases = (uint32)records.size();
+
+        // Phrase ids grouped by (length, difficulty bucket).
+        std::vector<uint32> bucketOffsets(MelodyCorpus::numBuckets + 1, 0), bucketIds(numPhrases);
+        for (auto &r : records)
+            ++bucketOffsets[(size_t)bucketOf(r) + 1];
+        for (size_t i = 1; i < bucketOffsets.size(); ++i)
+            bucketOffsets[i] += bucketOffsets[i - 1];
+        {
+            auto fill = bucketOffsets;
+            for (uint32 id = 0; id < numPhrases; ++id)
+                bucketIds[fill[(size_t)bucketOf(records[id])]++] = id;
+        }
+
+        // Interval trigram postings, one entry per distinct trigram per phrase.
+        std::vector<uint32> ngramOffsets(MelodyCorpus::numNgrams + 1, 0), postings;
+        std::vector<std::pair<int, uint32>> pairs;
+        std::vector<int> keys;
+        for (uint32 id = 0; id < numPhrases; ++id)
+        {
+            keys.clear();
+            auto *p = notes.data() + records[id].firstNote;
+            for (auto i = 0; i + 3 < records[id].length; ++i)
+            {
+                auto key = MelodyCorpus::ngramKey(p[i + 1] - p[i], p[i + 2] - p[i + 1], p[i + 3] - p[i + 2]);
+                if (key >= 0)
+                    keys.push_back(key);
+            }
+            std::sort(keys.begin(), keys.end());
+            keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+            for (auto key : keys)
+                pairs.push_back({key, id});
+        }
+        std::sort(pairs.begin(), pairs.end());
+        postings.reserve(pairs.size());
+        for (auto &pair : pairs)
+        {
+            ++ngramOffsets[(size_t)pair.first + 1];
+            postings.push_back(pair.second);
+        }
+        for (size_t i = 1; i < ngramOffsets.size(); ++i)
+            ngramOffsets[i] += ngramOffsets[i - 1];
+
+        file.deleteFile();
+        juce::FileOutputStream out(file);
+        if (!out.openedOk())
+            return false;
+
+        MelodyCorpus::Header header = {MelodyCorpus::fileMagic, MelodyCorpus::fileVersion, numPhrases,
+                                       (uint32)notes.size(), (uint32)postings.size(), 0};
+        out.write(&header, sizeof(header));
+        out.write(records.data(), records.size() * sizeof(MelodyCorpus::PhraseRecord));
+        out.write(notes.data(), notes.size());
+        out.writeRepeatedByte(0, MelodyCorpus::alignedSize(notes.size()) - notes.size());
+        out.write(bucketOffsets.data(), bucketOffsets.size() * sizeof(uint32));
+        out.write(bucketIds.data(), bucketIds.size() * sizeof(uint32));
+        out.write(ngramOffsets.data(), ngramOffsets.size() * sizeof(uint32));
+        out.write(postings.data(), postings.size() * sizeof(uint32));
+        out.flush();
+        return out.getStatus().wasOk();
+    }
+
+    // Takes the top voice of each non-drum track and splits it at rests, at
+    // repeated notes or when a phrase reaches the maximum length.
+    static void extractPhrases(const juce::File &file, std::vector<juce::uint8> &phrases, std::vector<int> &lengths)
+    {
+        juce::FileInputStream in(file);
+        juce::MidiFile midi;
+        if (!in.openedOk() || !midi.readFrom(in))
+            return;
+
+        midi.convertTimestampTicksToSeconds();
+
+        for (auto t = 0; t < midi.getNumTracks(); ++t)
+        {
+            auto &track = *midi.getTrack(t);
+            std::vector<juce::uint8> phrase;
+            double lastOnset = -1.0, lastEnd = -1.0;
+
+            // Repeats are cut here rather than as notes arrive, since keeping
+            // a chord's top note can also make one.
+            auto flush = [&]
+            {
+                size_t start = 0;
+                for (size_t i = 1; i <= phrase.size(); ++i)
+                {
+                    if (i < phrase.size() && phrase[i] != phrase[i - 1])
+                        continue;
+
+                    if ((int)(i - start) >= MelodyCorpus::minPhraseLength)
+                    {
+                        phrases.insert(phrases.end(), phrase.begin() + (std::ptrdiff_t)start, phrase.begin() + (std::ptrdiff_t)i);
+                        lengths.push_back((int)(i - start));
+                    }
+                    start = i;
+                }
+                phrase.clear();
+            };
+
+            for (auto i = 0; i < track.getNumEvents(); ++i)
+            {
+                auto &m = track.getEventPointer(i)->message;
+                if (!m.isNoteOn() || m.getChannel() == 10)
+                    continue;
+
+                auto time = m.getTimeStamp();
+                auto note = (juce::uint8)m.getNoteNumber();
+
+                // Simultaneous onsets form a chord: keep the highest note.
+                if (!phrase.empty() && time - lastOnset < 0.02)
+                {
+                    phrase.back() = juce::jmax(phrase.back(), note);
+                    continue;
+                }
+
+                if (!phrase.empty() && (time - lastEnd > restThreshold || (int)phrase.size() >= MelodyCorpus::maxPhraseLength))
+                    flush();
+
+                phrase.push_back(note);
+                lastOnset = time;
+                auto *noteOff = track.getEventPointer(i)->noteOffObject;
+                lastEnd = noteOff != nullptr ? noteOff->message.getTimeStamp() : time;
+            }
+            flush();
+        }
+    }
+
+    // 0-255: larger leaps and notes outside the major scale of the first
+    // note both make a phrase harder to take down.
+    static int difficultyOf(const juce::uint8 *phrase, int length)
+    {
+        static constexpr bool inScale[12] = {true, false, true, false, true, true, false, true, false, true, false, true};
+        auto score = 0;
+        for (auto i = 1; i < length; ++i)
+        {
+            auto leap = std::abs(phrase[i] - phrase[i - 1]);
+            score += leap <= 2 ? 1 : leap <= 5 ? 2 : leap <= 7 ? 3 : leap <= 12 ? 5 : 9;
+            if (!inScale[((phrase[i] - phrase[0]) % 12 + 12) % 12])
+                score += 2;
+        }
+        return juce::jlimit(0, 255, score * 24 / (length - 1));
+    }
+
+private:
+    static int bucketOf(const MelodyCorpus::PhraseRecord &r)
+    {
+        return r.length * MelodyCorpus::numDifficultyBuckets + r.difficulty / 16;
+    }
+
+    static constexpr double restThreshold = 0.4;
+
+    std::vector<MelodyCorpus::PhraseRecord> records;
+    std::vector<juce::uint8> notes;
+};
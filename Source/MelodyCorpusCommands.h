@@ -0,0 +1,107 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "HeadlessCommand.h"
+#include "MelodyCorpus.h"
+
+// Headless modes for the melody corpus: importing MIDI files and timing queries.
+class MelodyCorpusCommands : private HeadlessCommand
+{
+public:
+    static void addTo(juce::ConsoleApplication &app)
+    {
+        app.addCommand({"--build-corpus",
+                        "--build-corpus <midi directory> [output file] [--threads=N]",
+                        "Imports Standard MIDI Files into the melody corpus.",
+                        "Defaults to the corpus file the application loads at startup.",
+                        [](const juce::ArgumentList &a) { buildCorpus(a); }});
+        app.addCommand({"--corpus-bench",
+                        "--corpus-bench [--phrases=N]",
+                        "Measures corpus build and query times on synthetic phrases.",
+                        {},
+                        [](const juce::ArgumentList &a) { corpusBench(a); }});
+    }
+
+private:
+    static void buildCorpus(const juce::ArgumentList &args)
+    {
+        args.checkMinNumArguments(2);
+        auto directory = args[1].resolveAsExistingFolder();
+        auto output = args.size() > 2 && !args[2].isOption() ? args[2].resolveAsFile() : MelodyCorpus::getDefaultFile();
+
+        auto files = directory.findChildFiles(juce::File::findFiles, true, "*.mid;*.midi;*.smf");
+        auto start = juce::Time::getMillisecondCounterHiRes();
+
+        MelodyCorpusBuilder builder;
+        builder.importMidiFiles(files, getIntOption(args, "--threads", juce::SystemStats::getNumCpus()));
+        auto parsed = juce::Time::getMillisecondCounterHiRes();
+
+        output.getParentDirectory().createDirectory();
+        if (!builder.write(output))
+            juce::ConsoleApplication::fail("Could not write " + output.getFullPathName());
+
+        std::cout << files.size() << " files, " << builder.getNumPhrases() << " phrases; parsed in "
+                  << (parsed - start) * 0.001 << " s, indexed in "
+                  << (juce::Time::getMillisecondCounterHiRes() - parsed) * 0.001 << " s" << std::endl;
+    }
+
+    static void corpusBench(const juce::ArgumentList &args)
+    {
+        auto numPhrases = getIntOption(args, "--phrases", 100000);
+        juce::Random random(1);
+        MelodyCorpusBuilder builder;
+        juce::uint8 phrase[MelodyCorpus::maxPhraseLength];
+
+        for (auto i = 0; i < numPhrases; ++i)
+        {
+            auto length = MelodyCorpus::minPhraseLength + random.nextInt(MelodyCorpus::maxPhraseLength - MelodyCorpus::minPhraseLength + 1);
+            phrase[0] = (juce::uint8)(48 + random.nextInt(24));
+            for (auto n = 1; n < length; ++n)
+            {
+                // A step of 1 to 7 semitones either way, turned back at the ends of the keyboard.
+                auto step = random.nextInt(7) + 1;
+                step = random.nextBool() ? step : -step;
+                if (phrase[n - 1] + step < 21 || phrase[n - 1] + step > 108)
+                    step = -step;
+                phrase[n] = (juce::uint8)(phrase[n - 1] + step);
+            }
+            builder.addPhrase(phrase, length);
+        }
+
+        auto file = juce::File::createTempFile("corpus");
+        auto start = juce::Time::getMillisecondCounterHiRes();
+        builder.write(file);
+        auto built = juce::Time::getMillisecondCounterHiRes();
+
+        MelodyCorpus corpus;
+        if (!corpus.open(file))
+            juce::ConsoleApplication::fail("Could not map " + file.getFullPathName());
+        auto opened = juce::Time::getMillisecondCounterHiRes();
+
+        const int numQueries = 1000000;
+        int found = 0;
+        MelodyCorpus::Query query;
+        for (auto i = 0; i < numQueries; ++i)
+        {
+            query.length = 5;
+            query.minDifficulty = random.nextInt(200);
+            query.maxDifficulty = query.minDifficulty + 55;
+            found += corpus.findPhrase(query, random) >= 0;
+        }
+        auto queried = juce::Time::getMillisecondCounterHiRes();
+
+        for (auto i = 0; i < numQueries; ++i)
+            found += corpus.findPhraseWithIntervals(random.nextInt(5) - 2, random.nextInt(5) - 2, random.nextInt(5) - 2, query, random) >= 0;
+        auto ngramQueried = juce::Time::getMillisecondCounterHiRes();
+
+        std::cout << corpus.getNumPhrases() << " phrases, " << file.getSize() / 1024 << " KiB" << std::endl
+                  << "build + write: " << (built - start) << " ms" << std::endl
+                  << "map: " << (opened - built) << " ms" << std::endl
+                  << "range/difficulty query: " << (queried - opened) * 1.0e6 / numQueries << " ns" << std::endl
+                  << "interval n-gram query: " << (ngramQueried - queried) * 1.0e6 / numQueries << " ns" << std::endl
+                  << "hits: " << found << " / " << 2 * numQueries << std::endl;
+
+        corpus.close();
+        file.deleteFile();
+    }
+};
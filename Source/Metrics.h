@@ -0,0 +1,394 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <vector>
+
+// Counters, gauges and log-linear histograms that any thread can update
+// without waiting. Each metric keeps a cache-line-aligned slot per shard and
+// every live thread owns a shard of its own, so the audio, MIDI and message
+// threads don't share lines; a scrape sums the shards.
+class Metrics
+{
+public:
+    static constexpr int numShards = 32;
+
+    static Metrics &get()
+    {
+        static Metrics instance;
+        return instance;
+    }
+
+    class Metric
+    {
+    public:
+        Metric(Metrics &owner, const char *metricName, const char *metricHelp)
+            : name(metricName), help(metricHelp)
+        {
+            owner.metrics.push_back(this);
+        }
+
+        virtual ~Metric() = default;
+        virtual void write(juce::String &out) const = 0;
+
+    protected:
+        void writeHeader(juce::String &out, const char *type) const
+        {
+            out << "# HELP " << name << " " << help << "\n# TYPE " << name << " " << type << "\n";
+        }
+
+        const char *name, *help;
+    };
+
+    class Counter : public Metric
+    {
+    public:
+        using Metric::Metric;
+
+        void add(juce::uint64 n = 1) { slots[shardIndex()].value.fetch_add(n, std::memory_order_relaxed); }
+
+        juce::uint64 total() const
+        {
+            juce::uint64 sum = 0;
+            for (auto &s : slots)
+                sum += s.value.load(std::memory_order_relaxed);
+            return sum;
+        }
+
+        void write(juce::String &out) const override
+        {
+            writeHeader(out, "counter");
+            out << name << " " << (juce::int64)total() << "\n";
+        }
+
+    private:
+        struct alignas(64) Slot
+        {
+            std::atomic<juce::uint64> value{0};
+        };
+
+        Slot slots[numShards];
+    };
+
+    // Last value set, from whichever thread set it.
+    class Gauge : public Metric
+    {
+    public:
+        using Metric::Metric;
+
+        void set(double newValue) { value.store(newValue, std::memory_order_relaxed); }
+
+        void write(juce::String &out) const override
+        {
+            writeHeader(out, "gauge");
+            out << name << " " << value.load(std::memory_order_relaxed) << "\n";
+        }
+
+    private:
+        std::atomic<double> value{0.0};
+    };
+
+    // Durations in microseconds, bucketed HDR-style: exact below 32, then 16
+    // buckets per power of two (about 6% resolution) up to 2^44 us. Exposed
+    // as a Prometheus summary with quantiles computed at scrape time.
+    class Histogram : public Metric
+    {
+    public:
+        using Metric::Metric;
+
+        void recordMicroseconds(juce::uint64 us)
+        {
+            auto &shard = shards[shardIndex()];
+            shard.buckets[bucketFor(us)].fetch_add(1, std::memory_order_relaxed);
+            shard.count.fetch_add(1, std::memory_order_relaxed);
+            shard.sumMicroseconds.fetch_add(us, std::memory_order_relaxed);
+        }
+
+        void recordSeconds(double seconds) { recordMicroseconds((juce::uint64)juce::jmax(0.0, seconds * 1.0e6)); }
+
+        void recordTicks(juce::int64 ticks) { recordSeconds(juce::Time::highResolutionTicksToSeconds(ticks)); }
+
+        void write(juce::String &out) const override
+        {
+            std::vector<juce::uint64> buckets(numBuckets, 0);
+            juce::uint64 count = 0, sum = 0;
+            for (auto &shard : shards)
+            {
+                for (auto b = 0; b < numBuckets; ++b)
+                    buckets[(size_t)b] += shard.buckets[b].load(std::memory_order_relaxed);
+                count += shard.count.load(std::memory_order_relaxed);
+                sum += shard.sumMicroseconds.load(std::memory_order_relaxed);
+            }
+
+            writeHeader(out, "summary");
+            for (auto q : {0.5, 0.9, 0.99, 0.999})
+                out << name << "{quantile=\"" << q << "\"} " << quantile(buckets, count, q) * 1.0e-6 << "\n";
+            out << name << "_sum " << (double)sum * 1.0e-6 << "\n"
+                << name << "_count " << (juce::int64)count << "\n";
+        }
+
+    private:
+        static constexpr int subBuckets = 16;
+        static constexpr int maxShift = 40;
+        static constexpr int numBuckets = subBuckets * (maxShift + 2);
+
+        static int bucketFor(juce::uint64 us)
+        {
+            if (us < 2 * subBuckets)
+                return (int)us;
+
+            auto msb = 63;
+            while (((us >> msb) & 1) == 0)
+                --msb;
+
+            auto shift = juce::jmin(maxShift, msb - 4);
+            return juce::jmin(numBuckets - 1, subBuckets * shift + (int)(us >> shift));
+        }
+
+        // Midpoint of the bucket, in microseconds.
+        static double bucketValue(int bucket)
+        {
+            if (bucket < 2 * subBuckets)
+                return bucket;
+
+            auto shift = bucket / subBuckets - 1;
+            auto low = (double)((juce::uint64)(bucket % subBuckets + subBuckets) << shift);
+            return low + 0.5 * (double)((juce::uint64)1 << shift);
+        }
+
+        static double quantile(const std::vector<juce::uint64> &buckets, juce::uint64 count, double q)
+        {
+            if (count == 0)
+                return 0.0;
+
+            auto rank = (juce::uint64)std::ceil(q * (double)count);
+            juce::uint64 seen = 0;
+            for (size_t b = 0; b < buckets.size(); ++b)
+            {
+                seen += buckets[b];
+                if (seen >= rank)
+                    return bucketValue((int)b);
+            }
+            return bucketValue(numBuckets - 1);
+        }
+
+        struct alignas(64) Shard
+        {
+            std::atomic<juce::uint64> buckets[numBuckets] = {};
+            std::atomic<juce::uint64> count{0}, sumMicroseconds{0};
+        };
+
+        Shard shards[numShards];
+    };
+
+    struct ScopedTimer
+    {
+        explicit ScopedTimer(Histogram &h) : histogram(h), start(juce::Time::getHighResolutionTicks()) {}
+        ~ScopedTimer() { histogram.recordTicks(juce::Time::getHighResolutionTicks() - start); }
+
+        Histogram &histogram;
+        juce::int64 start;
+    };
+
+    // Prometheus text exposition format, version 0.0.4.
+    juce::String exposition() const
+    {
+        juce::String out;
+        out.preallocateBytes(8192);
+        for (auto *m : metrics)
+            m->write(out);
+        return out;
+    }
+
+private:
+    std::vector<Metric *> metrics;
+
+public:
+    Counter notesReceived{*this, "sensetrainer_notes_received_total", "Note-ons seen by the answer checker."};
+    Counter quizzesGenerated{*this, "sensetrainer_quizzes_generated_total", "Quizzes generated."};
+    Counter replays{*this, "sensetrainer_replays_total", "Quiz replays started."};
+    Counter answersCorrect{*this, "sensetrainer_answers_correct_total", "Quizzes answered correctly."};
+    Counter answerMistakes{*this, "sensetrainer_answer_mistakes_total", "Wrong notes played while answering."};
+    Counter audioCallbacks{*this, "sensetrainer_audio_callbacks_total", "Audio device callbacks."};
+    Counter audioBlocksSkipped{*this, "sensetrainer_audio_blocks_skipped_total", "Callbacks left silent by the idle fast path."};
+    Counter midiEvents{*this, "sensetrainer_midi_events_total", "MIDI events reaching the synth."};
+    Counter uiFrames{*this, "sensetrainer_ui_frames_total", "GUI frames run; flat while the window is idle."};
+    Counter midiEventsDropped{*this, "sensetrainer_midi_events_dropped_total", "Note changes dropped because a keyboard queue was full."};
+    Gauge sampleRate{*this, "sensetrainer_audio_sample_rate_hz", "Current audio device sample rate."};
+    Gauge bufferSize{*this, "sensetrainer_audio_buffer_samples", "Current audio device buffer size."};
+    Histogram audioCallbackSeconds{*this, "sensetrainer_audio_callback_seconds", "Time spent in each audio callback."};
+    Histogram gradingSeconds{*this, "sensetrainer_grading_seconds", "Time to grade a played note."};
+    Histogram feedbackSeconds{*this, "sensetrainer_feedback_delay_seconds", "From a note being played to its grade being shown."};
+    Histogram quizGenerationSeconds{*this, "sensetrainer_quiz_generation_seconds", "Time to generate a quiz."};
+
+private:
+    Metrics() = default;
+
+    // A thread takes the lowest free shard on its first update and frees it
+    // when it exits, for the next thread to carry on counting in. Beyond
+    // numShards live threads the extras share the last shard, which still
+    // counts correctly since every slot is atomic.
+    class ShardLease
+    {
+    public:
+        ShardLease()
+        {
+            auto &owner = get();
+            auto used = owner.shardsInUse.load(std::memory_order_relaxed);
+            for (;;)
+            {
+                auto free = 0;
+                while (free < numShards && (used & (1u << free)) != 0)
+                    ++free;
+
+                if (free == numShards)
+                {
+                    index = numShards - 1;
+                    return;
+                }
+                if (owner.shardsInUse.compare_exchange_weak(used, used | (1u << free), std::memory_order_relaxed))
+                {
+                    index = free;
+                    owned = true;
+                    return;
+                }
+            }
+        }
+
+        ~ShardLease()
+        {
+            if (owned)
+                get().shardsInUse.fetch_and(~(1u << index), std::memory_order_relaxed);
+        }
+
+        int index = 0;
+        bool owned = false;
+    };
+
+    static int shardIndex()
+    {
+        thread_local ShardLease lease;
+        return lease.index;
+    }
+
+    static_assert(numShards <= 32, "shardsInUse has a bit per shard");
+    std::atomic<juce::uint32> shardsInUse{0};
+
+    JUCE_DECLARE_NON_COPYABLE(Metrics)
+};
+
+// Serves Metrics::get() on http://127.0.0.1:<port>/metrics, or, when the
+// port is 0 or couldn't be bound, writes the same text to a file every few
+// seconds. Nothing is exported unless asked for: the main window starts an
+// exporter only when launched with --metrics[=port].
+class MetricsExporter : private juce::Thread
+{
+public:
+    struct Settings
+    {
+        int port = 9464;
+        int dumpSeconds = 30;
+        juce::File dumpFile = getDefaultDumpFile();
+    };
+
+    // Returns true if the command line asks for --metrics[=port]; 0 as the
+    // port means write the file only.
+    static bool isRequested(const juce::ArgumentList &args, Settings &settings)
+    {
+        if (!args.containsOption("--metrics"))
+            return false;
+
+        auto port = args.getValueForOption("--metrics");
+        if (port.isNotEmpty())
+            settings.port = port.getIntValue();
+        return true;
+    }
+
+    MetricsExporter() : juce::Thread("Metrics exporter") {}
+
+    ~MetricsExporter() override
+    {
+        stop();
+    }
+
+    void start(const Settings &newSettings)
+    {
+        stop();
+        settings = newSettings;
+        listening = settings.port > 0 && listener.createListener(settings.port, "127.0.0.1");
+        startThread(3);
+    }
+
+    void stop()
+    {
+        signalThreadShouldExit();
+        listener.close();
+        stopThread(2000);
+        listening = false;
+    }
+
+    bool isListening() const { return listening; }
+
+    static juce::File getDefaultDumpFile()
+    {
+        return juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+            .getChildFile("SenseTrainer")
+            .getChildFile("metrics.prom");
+    }
+
+private:
+    // Sleeps in accept() while serving, since stop() closing the listener
+    // releases it; otherwise sleeps until the next dump is due.
+    void run() override
+    {
+        if (listening)
+        {
+            while (!threadShouldExit())
+            {
+                std::unique_ptr<juce::StreamingSocket> client(listener.waitForNextConnection());
+                if (client != nullptr && !threadShouldExit())
+                    serve(*client);
+            }
+            return;
+        }
+
+        if (settings.dumpSeconds <= 0)
+            return;
+
+        while (!threadShouldExit())
+        {
+            wait(settings.dumpSeconds * 1000);
+            dump();
+        }
+    }
+
+    void serve(juce::StreamingSocket &client)
+    {
+        char request[1024] = {};
+        if (client.waitUntilReady(true, 1000) != 1 || client.read(request, sizeof(request) - 1, false) <= 0)
+            return;
+
+        auto requestLine = juce::String(request).upToFirstOccurrenceOf("\r\n", false, false);
+        auto found = requestLine.startsWith("GET /metrics ") || requestLine.startsWith("GET / ");
+        auto body = found ? Metrics::get().exposition() : juce::String("not found\n");
+
+        juce::String response;
+        response << "HTTP/1.1 " << (found ? "200 OK" : "404 Not Found") << "\r\n"
+                 << "Content-Type: text/plain; version=0.0.4\r\n"
+                 << "Content-Length: " << (int)body.getNumBytesAsUTF8() << "\r\n"
+                 << "Connection: close\r\n\r\n"
+                 << body;
+        client.write(response.toRawUTF8(), (int)response.getNumBytesAsUTF8());
+    }
+
+    void dump()
+    {
+        settings.dumpFile.getParentDirectory().createDirectory();
+        juce::TemporaryFile temp(settings.dumpFile);
+        if (temp.getFile().replaceWithText(Metrics::get().exposition()))
+            temp.overwriteTargetFileWithTemporary();
+    }
+
+    Settings settings;
+    juce::StreamingSocket listener;
+    std::atomic<bool> listening{false};
+};
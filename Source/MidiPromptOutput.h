@@ -0,0 +1,110 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+// Plays quiz prompts on an external MIDI instrument, such as the digital
+// piano the answers come from. A whole replay goes to
+// MidiOutput::sendBlockOfMessages at once, stamped a little ahead, and the
+// output's own background thread sends each note at its time, so the note
+// spacing follows neither the GUI nor the audio callback. The output
+// latency (LatencyProfiles, measured by --midi-send-jitter) moves the times
+// the prompts are taken to sound for reaction timing. Message thread only.
+class MidiPromptOutput
+{
+public:
+    // The same spacing as the built-in synth's replay.
+    static constexpr int noteMs = 500;
+    // Margin for the block to reach the background thread before its first note.
+    static constexpr int scheduleAheadMs = 20;
+
+    ~MidiPromptOutput()
+    {
+        close();
+    }
+
+    bool open(const juce::MidiDeviceInfo &device)
+    {
+        close();
+        output = juce::MidiOutput::openDevice(device.identifier);
+        if (output == nullptr)
+            return false;
+
+        output->startBackgroundThread();
+        return true;
+    }
+
+    void close()
+    {
+        if (output == nullptr)
+            return;
+
+        output->clearAllPendingMessages();
+        output->stopBackgroundThread();
+        for (auto ch = 1; ch <= 16; ++ch)
+            output->sendMessageNow(juce::MidiMessage::allNotesOff(ch));
+        output.reset();
+        startMs = -1.0;
+    }
+
+    bool isOpen() const { return output != nullptr; }
+
+    void setLatencyMs(double ms) { latencyMs = ms; }
+
+    // Schedules the quiz notes (terminated by 0) and returns the milliseconds
+    // until the last one has finished.
+    int play(const int *notes)
+    {
+        if (output == nullptr)
+            return 0;
+
+        // Dropping the pending messages would leave a prompt that is still
+        // sounding without its note-off.
+        output->clearAllPendingMessages();
+        for (auto i = 0; i < numNotes; ++i)
+            output->sendMessageNow(juce::MidiMessage::noteOff(channel, promptNotes[i]));
+
+        juce::MidiBuffer block;
+        numNotes = 0;
+        for (; numNotes < maxNotes && notes[numNotes] != 0; ++numNotes)
+        {
+            // The note-off goes in first at the next note's time, so a repeated note restrikes.
+            block.addEvent(juce::MidiMessage::noteOn(channel, notes[numNotes], (juce::uint8)100), numNotes * noteMs);
+            block.addEvent(juce::MidiMessage::noteOff(channel, notes[numNotes]), (numNotes + 1) * noteMs);
+            promptNotes[numNotes] = notes[numNotes];
+        }
+
+        auto start = juce::Time::getMillisecondCounter() + scheduleAheadMs;
+        output->sendBlockOfMessages(block, start, 1000.0);
+        startMs = start + latencyMs;
+        return scheduleAheadMs + juce::roundToInt(latencyMs) + numNotes * noteMs;
+    }
+
+    // The prompt sounding at the given Time::getMillisecondCounterHiRes() time, or -1.
+    int getSoundingNote(double timeMs) const
+    {
+        if (startMs < 0.0 || timeMs < startMs)
+            return -1;
+
+        auto index = (int)((timeMs - startMs) / noteMs);
+        return index < numNotes ? promptNotes[index] : -1;
+    }
+
+    // Seconds from the last prompt note sounding to the given
+    // Time::getMillisecondCounterHiRes() time, or -1 if nothing has played.
+    double getTimeSincePrompt(double timeSeconds) const
+    {
+        if (startMs < 0.0 || numNotes == 0)
+            return -1.0;
+
+        return timeSeconds - (startMs + (numNotes - 1) * noteMs) * 0.001;
+    }
+
+private:
+    static constexpr int channel = 1;
+    static constexpr int maxNotes = 8;
+
+    std::unique_ptr<juce::MidiOutput> output;
+    double latencyMs = 0.0, startMs = -1.0;
+    int promptNotes[maxNotes] = {};
+    int numNotes = 0;
+};
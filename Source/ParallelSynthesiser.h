@@ -0,0 +1,290 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "RealtimeThreads.h"
+#include "Tracing.h"
+
+#if JUCE_INTEL
+ #include <emmintrin.h>
+#endif
+
+// A Synthesiser that splits its active voices across a pool of real-time
+// worker threads. The audio thread renders one share itself, waits on a
+// spin-then-park barrier, and sums the workers' private buffers into the
+// output. Voices are balanced by their measured render cost. A worker
+// claims its share before rendering it; a share still unclaimed a quarter
+// of a block after publishing is rendered by the audio thread, so a worker
+// the scheduler has not run cannot hold up the callback.
+class ParallelSynthesiser : public juce::Synthesiser
+{
+public:
+    ~ParallelSynthesiser() override
+    {
+        stopWorkers();
+    }
+
+    // Call from prepareToPlay. With numWorkers == 0 rendering stays serial.
+    void prepareWorkers(int numWorkers, int maxBlockSize, int numChannels)
+    {
+        stopWorkers();
+
+        voiceCost.assign((size_t)juce::jmax(maxVoices, getNumVoices()), 0.0);
+        for (auto i = 0; i < juce::jmin(numWorkers, maxShares - 1); ++i)
+            workers.add(new Worker(*this, i + 1, numChannels, maxBlockSize));
+
+        for (auto *w : workers)
+            w->startThread(9);
+    }
+
+    void stopWorkers()
+    {
+        for (auto *w : workers)
+            w->signalThreadShouldExit();
+        for (auto *w : workers)
+            w->notify();
+        workers.clear();
+    }
+
+    int getNumWorkers() const { return workers.size(); }
+
+    // Any thread. While off, blocks render serially and the prepared workers
+    // stay parked, so switching to a cheaper sound needs no re-prepare.
+    void setUsingWorkers(bool shouldUse) { usingWorkers.store(shouldUse, std::memory_order_relaxed); }
+
+    bool isAnyVoiceActive() const
+    {
+        for (auto *v : voices)
+            if (v->isVoiceActive())
+                return true;
+        return false;
+    }
+
+    // Shares the audio thread rendered because their worker had not started in time.
+    int getStolenShares() const { return numStolenShares.load(); }
+
+    // Average time between publishing a block and the last worker picking it up.
+    double getAverageWakeMicroseconds() const
+    {
+        auto blocks = numParallelBlocks.load();
+        return blocks > 0 ? juce::Time::highResolutionTicksToSeconds(totalWakeTicks.load()) * 1.0e6 / blocks : 0.0;
+    }
+
+protected:
+    using juce::Synthesiser::renderVoices;
+
+    void renderVoices(juce::AudioBuffer<float> &outputAudio, int startSample, int numSamples) override
+    {
+        auto numActive = 0;
+        for (auto i = 0; i < juce::jmin(voices.size(), maxVoices); ++i)
+            if (voices.getUnchecked(i)->isVoiceActive())
+                active[numActive++] = i;
+
+        if (workers.isEmpty() || !usingWorkers.load(std::memory_order_relaxed) || numActive < 2 || voices.size() > maxVoices
+            || numSamples > workers.getFirst()->buffer.getNumSamples()
+            || outputAudio.getNumChannels() > workers.getFirst()->buffer.getNumChannels())
+        {
+            juce::Synthesiser::renderVoices(outputAudio, startSample, numSamples);
+            return;
+        }
+
+        assignVoices(numActive);
+
+        job.numSamples = numSamples;
+        job.numChannels = outputAudio.getNumChannels();
+        job.publishTicks = juce::Time::getHighResolutionTicks();
+        lastWakeTicks = 0;
+        finished.store(0, std::memory_order_relaxed);
+
+        // Sequentially consistent, pairing with the worker's park: either it
+        // sees the new generation or this sees it parked and wakes it.
+        auto current = generation.fetch_add(1) + 1;
+        for (auto *w : workers)
+            if (w->parked.load())
+                w->notify();
+
+        renderShare(0, outputAudio, startSample, numSamples);
+
+        auto deadline = job.publishTicks + (juce::int64)(juce::Time::getHighResolutionTicksPerSecond() * numSamples
+                                                         / juce::jmax(1.0, getSampleRate()) * 0.25);
+        bool renderedHere[maxShares] = {};
+        while (finished.load(std::memory_order_acquire) < workers.size())
+        {
+            if (juce::Time::getHighResolutionTicks() < deadline)
+            {
+                pause();
+                continue;
+            }
+
+            // Past the deadline: take every share no worker has started. Any
+            // claimed share is being rendered and is waited for.
+            for (auto i = 0; i < workers.size(); ++i)
+            {
+                auto *w = workers.getUnchecked(i);
+                if (w->claim(current))
+                {
+                    renderShare(w->share, outputAudio, startSample, numSamples);
+                    renderedHere[i] = true;
+                    finished.fetch_add(1, std::memory_order_relaxed);
+                    ++numStolenShares;
+                }
+            }
+            deadline = std::numeric_limits<juce::int64>::max();
+        }
+
+        for (auto i = 0; i < workers.size(); ++i)
+            if (!renderedHere[i])
+                for (auto ch = 0; ch < job.numChannels; ++ch)
+                    juce::FloatVectorOperations::add(outputAudio.getWritePointer(ch, startSample),
+                                                     workers.getUnchecked(i)->buffer.getReadPointer(ch), numSamples);
+
+        totalWakeTicks += lastWakeTicks.load();
+        ++numParallelBlocks;
+    }
+
+private:
+    static constexpr int maxVoices = 256;
+    static constexpr int maxShares = 16;
+
+    struct Job
+    {
+        int numSamples = 0, numChannels = 0;
+        juce::int64 publishTicks = 0;
+        int shareSize[maxShares] = {};
+        int shareVoices[maxShares][maxVoices] = {};
+    };
+
+    class Worker : public juce::Thread
+    {
+    public:
+        Worker(ParallelSynthesiser &o, int s, int numChannels, int maxBlockSize)
+            : juce::Thread("Voice worker " + juce::String(s)), owner(o), share(s),
+              buffer(numChannels, maxBlockSize)
+        {
+        }
+
+        ~Worker() override
+        {
+            stopThread(1000);
+        }
+
+        void run() override
+        {
+            RealtimeThreads::getInstance().enterRealtime(RealtimeThreads::Role::voiceWorker, share - 1);
+            auto seen = owner.generation.load();
+            while (!threadShouldExit())
+            {
+                auto current = owner.generation.load(std::memory_order_acquire);
+                if (current != seen)
+                {
+                    seen = current;
+                    // A worker preempted for a few blocks may only now be
+                    // looking at an old generation, whose block is done.
+                    if (!claim(current) || owner.generation.load(std::memory_order_acquire) != current)
+                        continue; // the audio thread took this share, or it is stale
+
+                    auto wake = juce::Time::getHighResolutionTicks() - owner.job.publishTicks;
+                    auto previous = owner.lastWakeTicks.load();
+                    while (wake > previous && !owner.lastWakeTicks.compare_exchange_weak(previous, wake))
+                    {
+                    }
+
+                    Tracer::Scope traced("render share");
+                    buffer.clear(0, owner.job.numSamples);
+                    owner.renderShare(share, buffer, 0, owner.job.numSamples);
+                    owner.finished.fetch_add(1, std::memory_order_release);
+                    continue;
+                }
+
+                // Spin briefly, since the next block is usually close; then park.
+                for (auto i = 0; i < spinIterations && owner.generation.load(std::memory_order_acquire) == seen; ++i)
+                    pause();
+
+                // Both sequentially consistent, pairing with renderVoices():
+                // the store must be ordered before the load.
+                if (owner.generation.load(std::memory_order_acquire) == seen)
+                {
+                    parked.store(true);
+                    if (owner.generation.load() == seen)
+                        wait(-1);
+                    parked.store(false, std::memory_order_relaxed);
+                }
+            }
+        }
+
+        // Moves claimed forward to the given generation. Fails if its share
+        // has been taken or a later generation's has; an exchange could move
+        // claimed back and let two threads render the same voices.
+        bool claim(juce::uint32 current)
+        {
+            auto previous = claimed.load(std::memory_order_relaxed);
+            while ((juce::int32)(current - previous) > 0)
+                if (claimed.compare_exchange_weak(previous, current, std::memory_order_acq_rel, std::memory_order_relaxed))
+                    return true;
+            return false;
+        }
+
+        ParallelSynthesiser &owner;
+        const int share;
+        juce::AudioBuffer<float> buffer;
+        std::atomic<bool> parked{false};
+        // The generation whose share has been taken, by this worker or the audio thread.
+        std::atomic<juce::uint32> claimed{0};
+
+    private:
+        static constexpr int spinIterations = 4000;
+    };
+
+    static void pause()
+    {
+#if JUCE_INTEL
+        _mm_pause();
+#endif
+    }
+
+    // Longest-processing-time-first: heaviest voices go to the least loaded share.
+    void assignVoices(int numActive)
+    {
+        auto numShares = workers.size() + 1;
+        std::sort(active, active + numActive, [this](int a, int b)
+                  { return voiceCost[(size_t)a] > voiceCost[(size_t)b]; });
+
+        double load[maxShares] = {};
+        for (auto s = 0; s < numShares; ++s)
+            job.shareSize[s] = 0;
+
+        for (auto i = 0; i < numActive; ++i)
+        {
+            auto target = 0;
+            for (auto s = 1; s < numShares; ++s)
+                if (load[s] < load[target])
+                    target = s;
+
+            job.shareVoices[target][job.shareSize[target]++] = active[i];
+            load[target] += juce::jmax(voiceCost[(size_t)active[i]], 1.0);
+        }
+    }
+
+    void renderShare(int share, juce::AudioBuffer<float> &buffer, int startSample, int numSamples)
+    {
+        for (auto i = 0; i < job.shareSize[share]; ++i)
+        {
+            auto index = job.shareVoices[share][i];
+            auto start = juce::Time::getHighResolutionTicks();
+            voices.getUnchecked(index)->renderNextBlock(buffer, startSample, numSamples);
+            auto ticks = (double)(juce::Time::getHighResolutionTicks() - start) / numSamples;
+
+            auto &cost = voiceCost[(size_t)index];
+            cost += 0.1 * (ticks - cost);
+        }
+    }
+
+    juce::OwnedArray<Worker> workers;
+    Job job;
+    int active[maxVoices] = {};
+    std::vector<double> voiceCost;
+    std::atomic<juce::uint32> generation{0};
+    std::atomic<int> finished{0};
+    std::atomic<juce::int64> lastWakeTicks{0}, totalWakeTicks{0};
+    std::atomic<int> numParallelBlocks{0}, numStolenShares{0};
+    std::atomic<bool> usingWorkers{true};
+};
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "HeadlessCommand.h"
+#include "ParallelSynthesiser.h"
+#include "SynthUsingMidiInput.h"
+
+// Headless mode for ParallelSynthesiser: speedup against worker count.
+class ParallelSynthesiserCommands : private HeadlessCommand
+{
+public:
+    static void addTo(juce::ConsoleApplication &app)
+    {
+        app.addCommand({"--voice-scaling",
+                        "--voice-scaling [--voices=N] [--blocks=N]",
+                        "Measures parallel voice rendering speedup and fork/join latency.",
+                        {},
+                        [](const juce::ArgumentList &a) { voiceScaling(a); }});
+    }
+
+private:
+    static void voiceScaling(const juce::ArgumentList &args)
+    {
+        auto numVoices = getIntOption(args, "--voices", 64);
+        auto numBlocks = getIntOption(args, "--blocks", 20000);
+        auto maxWorkers = juce::jmin(7, juce::SystemStats::getNumCpus() - 1);
+
+        std::cout << "block  workers  avg us  speedup  wake us  stolen" << std::endl;
+        for (auto blockSize : {64, 128})
+        {
+            double serial = 0.0;
+            for (auto numWorkers = 0; numWorkers <= maxWorkers; ++numWorkers)
+            {
+                ParallelSynthesiser synth;
+                for (auto i = 0; i < numVoices; ++i)
+                    synth.addVoice(new SineWaveVoice());
+                synth.addSound(new SineWaveSound());
+                synth.setCurrentPlaybackSampleRate(48000.0);
+                synth.prepareWorkers(numWorkers, blockSize, 2);
+
+                juce::AudioSampleBuffer buffer(2, blockSize);
+                juce::MidiBuffer midi;
+                for (auto i = 0; i < numVoices; ++i)
+                    midi.addEvent(juce::MidiMessage::noteOn(1 + i / 64, 36 + i % 64, (juce::uint8)100), 0);
+                synth.renderNextBlock(buffer, midi, 0, blockSize);
+                midi.clear();
+
+                auto start = juce::Time::getHighResolutionTicks();
+                for (auto b = 0; b < numBlocks; ++b)
+                {
+                    buffer.clear();
+                    synth.renderNextBlock(buffer, midi, 0, blockSize);
+                }
+                auto average = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start) * 1.0e6 / numBlocks;
+                if (numWorkers == 0)
+                    serial = average;
+
+                std::cout << juce::String(blockSize).paddedLeft(' ', 5)
+                          << juce::String(numWorkers).paddedLeft(' ', 9)
+                          << juce::String(average, 1).paddedLeft(' ', 8)
+                          << juce::String(serial / average, 2).paddedLeft(' ', 9)
+                          << juce::String(synth.getAverageWakeMicroseconds(), 1).paddedLeft(' ', 9)
+                          << juce::String(synth.getStolenShares()).paddedLeft(' ', 8) << std::endl;
+            }
+        }
+    }
+};
@@ -0,0 +1,281 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <vector>
+#include "DspKernels.h"
+
+// Synthesised instruments for machines without the sampled library: a
+// Karplus-Strong plucked string and a modal piano. Each voice's cost is
+// fixed when the note starts (one delay line, or one bank of at most
+// DspKernels::maxResonators modes) and a voice stops itself once it has
+// decayed below audibility, so the synth's worst case is its voice count
+// times the per-voice cost that --voice-cost reports.
+
+struct PluckedStringSound : public juce::SynthesiserSound
+{
+    bool appliesToNote(int) override { return true; }
+    bool appliesToChannel(int) override { return true; }
+};
+
+struct ModalPianoSound : public juce::SynthesiserSound
+{
+    bool appliesToNote(int) override { return true; }
+    bool appliesToChannel(int) override { return true; }
+};
+
+// Level below which a decaying voice is switched off.
+constexpr float physicalVoiceSilence = 1.0e-4f;
+
+// Noise burst circulating in a delay line, with a two-point average and a
+// loss gain in the loop and a first-order allpass for the fractional part of
+// the period (Jaffe and Smith's extensions).
+class PluckedStringVoice : public juce::SynthesiserVoice
+{
+public:
+    // Longest period held, enough for A0 at 96 kHz.
+    static constexpr int maxDelay = 4096;
+
+    PluckedStringVoice() : line(maxDelay, 0.0f) {}
+
+    bool canPlaySound(juce::SynthesiserSound *sound) override
+    {
+        return dynamic_cast<PluckedStringSound *>(sound) != nullptr;
+    }
+
+    void startNote(int midiNoteNumber, float velocity, juce::SynthesiserSound *, int) override
+    {
+        auto frequency = juce::MidiMessage::getMidiNoteInHertz(midiNoteNumber);
+        auto period = getSampleRate() / frequency - 0.5; // the average delays by half a sample
+        length = juce::jlimit(2, maxDelay, (int)(period - 0.1));
+        auto fraction = juce::jlimit(0.1, 1.1, period - length);
+        allpass = (float)((1.0 - fraction) / (1.0 + fraction));
+
+        // Low strings ring for seconds, high ones for a fraction of a second.
+        auto t60 = juce::jmap((double)juce::jlimit(28, 100, midiNoteNumber), 28.0, 100.0, 6.0, 0.6);
+        loss = (float)std::pow(0.001, 1.0 / (frequency * t60));
+        releaseLoss = (float)std::pow(0.001, 1.0 / (frequency * 0.08));
+
+        // Softer plucks are darker: the burst is low-passed harder. Plucking
+        // at an eighth of the length notches every eighth harmonic.
+        auto smoothing = 0.15f + 0.7f * (1.0f - velocity);
+        auto pluckOffset = juce::jmax(1, length / 8);
+        float lowPassed = 0.0f, mean = 0.0f;
+        for (auto i = 0; i < length; ++i)
+        {
+            lowPassed += (1.0f - smoothing) * (random.nextFloat() * 2.0f - 1.0f - lowPassed);
+            line[(size_t)i] = lowPassed;
+        }
+        for (auto i = length; --i >= pluckOffset;)
+            line[(size_t)i] -= line[(size_t)(i - pluckOffset)];
+        for (auto i = 0; i < length; ++i)
+            mean += line[(size_t)i];
+        mean /= (float)length;
+
+        auto peak = 0.0f;
+        for (auto i = 0; i < length; ++i)
+            peak = juce::jmax(peak, std::abs(line[(size_t)i] -= mean));
+        auto scale = peak > 0.0f ? velocity * 0.3f / peak : 0.0f;
+        for (auto i = 0; i < length; ++i)
+            line[(size_t)i] *= scale;
+
+        position = 0;
+        previous = apIn = apOut = 0.0f;
+        currentLoss = loss;
+    }
+
+    void stopNote(float, bool allowTailOff) override
+    {
+        if (allowTailOff)
+        {
+            currentLoss = releaseLoss;
+        }
+        else
+        {
+            clearCurrentNote();
+            length = 0;
+        }
+    }
+
+    void pitchWheelMoved(int) override {}
+    void controllerMoved(int, int) override {}
+
+    void renderNextBlock(juce::AudioSampleBuffer &outputBuffer, int startSample, int numSamples) override
+    {
+        if (length == 0)
+            return;
+
+        auto *data = line.data();
+        auto blockPeak = 0.0f;
+        const float *source = output;
+        for (auto done = 0; done < numSamples;)
+        {
+            auto count = juce::jmin(numSamples - done, chunkSize);
+            for (auto n = 0; n < count; ++n)
+            {
+                auto delayed = data[position];
+                auto averaged = 0.5f * (delayed + previous);
+                previous = delayed;
+                apOut = allpass * (averaged - apOut) + apIn;
+                apIn = averaged;
+
+                auto sample = apOut * currentLoss;
+                data[position] = sample;
+                if (++position == length)
+                    position = 0;
+
+                output[n] = sample;
+                blockPeak = juce::jmax(blockPeak, std::abs(sample));
+            }
+
+            DspKernels::current().addTo(outputBuffer, startSample + done, &source, 1, count);
+            done += count;
+        }
+
+        if (blockPeak < physicalVoiceSilence)
+        {
+            clearCurrentNote();
+            length = 0;
+        }
+    }
+
+private:
+    static constexpr int chunkSize = 256;
+
+    std::vector<float> line;
+    float output[chunkSize] = {};
+    juce::Random random;
+    int length = 0, position = 0;
+    float allpass = 0.0f, loss = 1.0f, releaseLoss = 1.0f, currentLoss = 1.0f;
+    float previous = 0.0f, apIn = 0.0f, apOut = 0.0f;
+};
+
+// Piano tone as a bank of damped partials struck by a hammer pulse. Partial
+// k sits at k * f0 * sqrt(1 + B k^2) for the string's inharmonicity B, and
+// higher partials decay faster. The bank runs through DspKernels::resonatorBank
+// in the widest vectors the CPU has.
+class ModalPianoVoice : public juce::SynthesiserVoice
+{
+public:
+    static constexpr int numModes = DspKernels::maxResonators;
+
+    bool canPlaySound(juce::SynthesiserSound *sound) override
+    {
+        return dynamic_cast<ModalPianoSound *>(sound) != nullptr;
+    }
+
+    void startNote(int midiNoteNumber, float velocity, juce::SynthesiserSound *, int) override
+    {
+        auto sampleRate = getSampleRate();
+        auto f0 = juce::MidiMessage::getMidiNoteInHertz(midiNoteNumber);
+        auto key = (double)juce::jlimit(21, 108, midiNoteNumber) - 21.0;
+        auto inharmonicity = 0.00015 * std::pow(2.0, key / 24.0);
+        auto t60 = 14.0 * std::pow(0.1, key / 87.0); // 14 s at A0 down to 1.4 s at C8
+        releaseRadius = (float)std::pow(0.001, 1.0 / (0.12 * sampleRate));
+
+        auto total = 0.0f;
+        for (auto k = 0; k < numModes; ++k)
+        {
+            auto partial = k + 1.0;
+            auto frequency = partial * f0 * std::sqrt(1.0 + inharmonicity * partial * partial);
+            re[k] = im[k] = 0.0f;
+            if (frequency >= 0.45 * sampleRate)
+            {
+                radius[k] = a[k] = b[k] = gain[k] = 0.0f;
+                continue;
+            }
+
+            auto decay = t60 / (1.0 + frequency / 1500.0);
+            auto w = juce::MathConstants<double>::twoPi * frequency / sampleRate;
+            radius[k] = (float)std::pow(0.001, 1.0 / (decay * sampleRate));
+            a[k] = (float)(radius[k] * std::cos(w));
+            b[k] = (float)(radius[k] * std::sin(w));
+            // Struck an eighth of the way along, so every eighth partial is weak.
+            gain[k] = (float)(std::abs(std::sin(juce::MathConstants<double>::pi * partial / 8.0)) / std::pow(partial, 0.6));
+            total += gain[k];
+        }
+
+        // A unit-area half-sine force; harder strikes are shorter and so brighter.
+        hammerLength = juce::jmax(2, juce::roundToInt(sampleRate * (0.004 - 0.003 * velocity)));
+        hammerPosition = 0;
+        hammerScale = (float)(juce::MathConstants<double>::pi / (2.0 * hammerLength));
+
+        // A unit impulse rings each partial at amplitude gain; keep the sum near velocity * 0.15.
+        auto level = velocity * 0.15f / juce::jmax(1.0e-6f, total);
+        for (auto k = 0; k < numModes; ++k)
+            gain[k] *= level;
+
+        playing = true;
+    }
+
+    void stopNote(float, bool allowTailOff) override
+    {
+        if (allowTailOff)
+        {
+            // The damper comes down.
+            for (auto k = 0; k < numModes; ++k)
+            {
+                if (radius[k] > releaseRadius)
+                {
+                    auto scale = releaseRadius / radius[k];
+                    radius[k] = releaseRadius;
+                    a[k] *= scale;
+                    b[k] *= scale;
+                }
+            }
+        }
+        else
+        {
+            clearCurrentNote();
+            playing = false;
+        }
+    }
+
+    void pitchWheelMoved(int) override {}
+    void controllerMoved(int, int) override {}
+
+    void renderNextBlock(juce::AudioSampleBuffer &outputBuffer, int startSample, int numSamples) override
+    {
+        if (!playing)
+            return;
+
+        auto blockPeak = 0.0f;
+        for (auto done = 0; done < numSamples;)
+        {
+            auto n = juce::jmin(numSamples - done, chunkSize);
+            const float *force = nullptr;
+            if (hammerPosition < hammerLength)
+            {
+                for (auto i = 0; i < n; ++i, ++hammerPosition)
+                    input[i] = hammerPosition < hammerLength
+                                   ? hammerScale * std::sin((hammerPosition + 0.5f) * 2.0f * hammerScale)
+                                   : 0.0f;
+                force = input;
+            }
+
+            juce::FloatVectorOperations::clear(output, n);
+            DspKernels::resonatorBank(re, im, a, b, gain, force, output, n);
+
+            const float *source = output;
+            DspKernels::current().addTo(outputBuffer, startSample + done, &source, 1, n);
+            auto range = juce::FloatVectorOperations::findMinAndMax(output, n);
+            blockPeak = juce::jmax(blockPeak, -range.getStart(), range.getEnd());
+            done += n;
+        }
+
+        if (hammerPosition >= hammerLength && blockPeak < physicalVoiceSilence)
+        {
+            clearCurrentNote();
+            playing = false;
+        }
+    }
+
+private:
+    static constexpr int chunkSize = 256;
+
+    alignas(16) float re[numModes] = {}, im[numModes] = {};
+    alignas(16) float a[numModes] = {}, b[numModes] = {}, gain[numModes] = {}, radius[numModes] = {};
+    alignas(16) float input[chunkSize] = {}, output[chunkSize] = {};
+    float releaseRadius = 0.0f, hammerScale = 0.0f;
+    int hammerLength = 0, hammerPosition = 0;
+    bool playing = false;
+};
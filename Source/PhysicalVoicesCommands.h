@@ -0,0 +1,74 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <type_traits>
+#include "HeadlessCommand.h"
+#include "PhysicalVoices.h"
+#include "SynthUsingMidiInput.h"
+
+// Headless mode for the synthesised voices: CPU and memory per voice.
+class PhysicalVoicesCommands : private HeadlessCommand
+{
+public:
+    static void addTo(juce::ConsoleApplication &app)
+    {
+        app.addCommand({"--voice-cost",
+                        "--voice-cost [--voices=N] [--block=N] [--seconds=N]",
+                        "Measures the CPU time and memory of one voice of each synthesised instrument.",
+                        "Time is per sounding voice per block, and the share of the block's real-time budget it uses.",
+                        [](const juce::ArgumentList &a) { voiceCost(a); }});
+    }
+
+private:
+    template <typename Voice, typename Sound>
+    static void measureVoiceCost(const char *name, int numVoices, int blockSize, int seconds)
+    {
+        const double sampleRate = 48000.0;
+        juce::Synthesiser synth;
+        for (auto i = 0; i < numVoices; ++i)
+            synth.addVoice(new Voice());
+        synth.addSound(new Sound());
+        synth.setCurrentPlaybackSampleRate(sampleRate);
+
+        juce::AudioSampleBuffer buffer(2, blockSize);
+        juce::MidiBuffer midi;
+        for (auto i = 0; i < numVoices; ++i)
+            midi.addEvent(juce::MidiMessage::noteOn(1, 36 + (i * 7) % 49, (juce::uint8)100), 0);
+
+        auto numBlocks = (int)(seconds * sampleRate / blockSize);
+        juce::int64 ticks = 0, voiceBlocks = 0;
+        for (auto b = 0; b < numBlocks; ++b)
+        {
+            auto sounding = 0;
+            for (auto i = 0; i < synth.getNumVoices(); ++i)
+                sounding += synth.getVoice(i)->isVoiceActive() ? 1 : 0;
+
+            buffer.clear();
+            auto start = juce::Time::getHighResolutionTicks();
+            synth.renderNextBlock(buffer, midi, 0, blockSize);
+            ticks += juce::Time::getHighResolutionTicks() - start;
+            voiceBlocks += b == 0 ? numVoices : sounding;
+            midi.clear();
+        }
+
+        auto perVoice = juce::Time::highResolutionTicksToSeconds(ticks) * 1.0e6 / (double)juce::jmax((juce::int64)1, voiceBlocks);
+        auto budget = blockSize * 1.0e6 / sampleRate;
+        auto bytes = sizeof(Voice) + (std::is_same<Voice, PluckedStringVoice>::value ? PluckedStringVoice::maxDelay * sizeof(float) : 0);
+        std::cout << juce::String(name).paddedRight(' ', 15) << juce::String(perVoice, 2).paddedLeft(' ', 8)
+                  << juce::String(perVoice * 100.0 / budget, 3).paddedLeft(' ', 10)
+                  << juce::String((int)(budget * 0.5 / juce::jmax(1.0e-3, perVoice))).paddedLeft(' ', 12)
+                  << juce::String((int)bytes).paddedLeft(' ', 10) << std::endl;
+    }
+
+    static void voiceCost(const juce::ArgumentList &args)
+    {
+        auto numVoices = juce::jmax(1, getIntOption(args, "--voices", 16));
+        auto blockSize = juce::jmax(16, getIntOption(args, "--block", 128));
+        auto seconds = juce::jmax(1, getIntOption(args, "--seconds", 4));
+
+        std::cout << "voice          us/block  budget %  voices/50%  bytes" << std::endl;
+        measureVoiceCost<SineWaveVoice, SineWaveSound>("sine", numVoices, blockSize, seconds);
+        measureVoiceCost<PluckedStringVoice, PluckedStringSound>("plucked string", numVoices, blockSize, seconds);
+        measureVoiceCost<ModalPianoVoice, ModalPianoSound>("modal piano", numVoices, blockSize, seconds);
+    }
+};
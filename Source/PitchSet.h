@@ -0,0 +1,241 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+// Pitch sets as bit masks: NoteSet covers all 128 MIDI notes, a 12-bit
+// pitch-class mask covers one octave. Every scale, mode and chord quality is
+// a constexpr table indexed by key, so grading is a handful of bit operations.
+namespace PitchSet
+{
+using PitchClassMask = juce::uint16;
+
+constexpr int popCount(juce::uint64 x)
+{
+    x = x - ((x >> 1) & 0x5555555555555555ull);
+    x = (x & 0x3333333333333333ull) + ((x >> 2) & 0x3333333333333333ull);
+    x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0full;
+    return (int)((x * 0x0101010101010101ull) >> 56);
+}
+
+// Index of the lowest set bit; 64 for zero.
+constexpr int countTrailingZeros(juce::uint64 x)
+{
+    return x == 0 ? 64 : popCount((x & (~x + 1)) - 1);
+}
+
+constexpr PitchClassMask rotate(PitchClassMask mask, int semitones)
+{
+    semitones = ((semitones % 12) + 12) % 12;
+    return (PitchClassMask)(((mask << semitones) | (mask >> (12 - semitones))) & 0xfff);
+}
+
+struct NoteSet
+{
+    juce::uint64 lo = 0, hi = 0;
+
+    constexpr NoteSet() {}
+    constexpr NoteSet(juce::uint64 l, juce::uint64 h) : lo(l), hi(h) {}
+
+    static constexpr NoteSet of(int note)
+    {
+        return note < 64 ? NoteSet((juce::uint64)1 << note, 0) : NoteSet(0, (juce::uint64)1 << (note - 64));
+    }
+
+    constexpr NoteSet with(int note) const { return *this | of(note); }
+    constexpr bool contains(int note) const { return ((note < 64 ? lo >> note : hi >> (note - 64)) & 1) != 0; }
+    constexpr bool isEmpty() const { return (lo | hi) == 0; }
+    constexpr int size() const { return popCount(lo) + popCount(hi); }
+    constexpr int lowest() const { return lo != 0 ? countTrailingZeros(lo) : 64 + countTrailingZeros(hi); }
+
+    constexpr NoteSet operator|(NoteSet o) const { return {lo | o.lo, hi | o.hi}; }
+    constexpr NoteSet operator&(NoteSet o) const { return {lo & o.lo, hi & o.hi}; }
+    constexpr NoteSet operator^(NoteSet o) const { return {lo ^ o.lo, hi ^ o.hi}; }
+    constexpr bool operator==(NoteSet o) const { return lo == o.lo && hi == o.hi; }
+    constexpr bool operator!=(NoteSet o) const { return !(*this == o); }
+
+    // Folds every octave onto one 12-bit pitch-class mask.
+    constexpr PitchClassMask pitchClasses() const
+    {
+        juce::uint64 folded = 0;
+        for (auto octave = 0; octave < 11; ++octave)
+        {
+            auto shift = octave * 12;
+            auto chunk = shift < 64 ? (lo >> shift) | (shift == 0 ? 0 : hi << (64 - shift)) : hi >> (shift - 64);
+            folded |= chunk;
+        }
+        return (PitchClassMask)(folded & 0xfff);
+    }
+};
+
+enum Mode
+{
+    major,
+    naturalMinor,
+    harmonicMinor,
+    melodicMinor,
+    dorian,
+    phrygian,
+    lydian,
+    mixolydian,
+    locrian,
+    majorPentatonic,
+    minorPentatonic,
+    blues,
+    wholeTone,
+    chromatic,
+    numModes
+};
+
+enum ChordQuality
+{
+    majorTriad,
+    minorTriad,
+    diminishedTriad,
+    augmentedTriad,
+    sus2,
+    sus4,
+    majorSeventh,
+    dominantSeventh,
+    minorSeventh,
+    halfDiminishedSeventh,
+    diminishedSeventh,
+    minorMajorSeventh,
+    augmentedSeventh,
+    majorSixth,
+    minorSixth,
+    numChordQualities
+};
+
+constexpr PitchClassMask maskOf(std::initializer_list<int> degrees)
+{
+    PitchClassMask mask = 0;
+    for (auto d : degrees)
+        mask = (PitchClassMask)(mask | (1 << d));
+    return mask;
+}
+
+constexpr PitchClassMask modeRoots[numModes] = {
+    maskOf({0, 2, 4, 5, 7, 9, 11}),
+    maskOf({0, 2, 3, 5, 7, 8, 10}),
+    maskOf({0, 2, 3, 5, 7, 8, 11}),
+    maskOf({0, 2, 3, 5, 7, 9, 11}),
+    maskOf({0, 2, 3, 5, 7, 9, 10}),
+    maskOf({0, 1, 3, 5, 7, 8, 10}),
+    maskOf({0, 2, 4, 6, 7, 9, 11}),
+    maskOf({0, 2, 4, 5, 7, 9, 10}),
+    maskOf({0, 1, 3, 5, 6, 8, 10}),
+    maskOf({0, 2, 4, 7, 9}),
+    maskOf({0, 3, 5, 7, 10}),
+    maskOf({0, 3, 5, 6, 7, 10}),
+    maskOf({0, 2, 4, 6, 8, 10}),
+    0xfff,
+};
+
+constexpr PitchClassMask chordRoots[numChordQualities] = {
+    maskOf({0, 4, 7}),
+    maskOf({0, 3, 7}),
+    maskOf({0, 3, 6}),
+    maskOf({0, 4, 8}),
+    maskOf({0, 2, 7}),
+    maskOf({0, 5, 7}),
+    maskOf({0, 4, 7, 11}),
+    maskOf({0, 4, 7, 10}),
+    maskOf({0, 3, 7, 10}),
+    maskOf({0, 3, 6, 10}),
+    maskOf({0, 3, 6, 9}),
+    maskOf({0, 3, 7, 11}),
+    maskOf({0, 4, 8, 10}),
+    maskOf({0, 4, 7, 9}),
+    maskOf({0, 3, 7, 9}),
+};
+
+template <int N>
+struct MaskTable
+{
+    PitchClassMask masks[N][12];
+
+    constexpr const PitchClassMask *operator[](int row) const { return masks[row]; }
+};
+
+template <int N>
+constexpr MaskTable<N> transposeAll(const PitchClassMask (&roots)[N])
+{
+    MaskTable<N> table{};
+    for (auto m = 0; m < N; ++m)
+        for (auto key = 0; key < 12; ++key)
+            table.masks[m][key] = rotate(roots[m], key);
+    return table;
+}
+
+constexpr auto scaleMasks = transposeAll(modeRoots);
+constexpr auto chordMasks = transposeAll(chordRoots);
+
+constexpr PitchClassMask scale(Mode mode, int key) { return scaleMasks[mode][key % 12]; }
+constexpr PitchClassMask chord(ChordQuality quality, int root) { return chordMasks[quality][root % 12]; }
+
+static_assert(scale(major, 2) == maskOf({2, 4, 6, 7, 9, 11, 1}), "D major");
+static_assert(chord(minorTriad, 9) == maskOf({9, 0, 4}), "A minor");
+
+//==============================================================================
+// One step of a melodic quiz: same pitch class as the target and, after the
+// first note, the same interval from the previous answer.
+constexpr bool matchesMelodicStep(int note, int previousNote, int target, int previousTarget, bool hasPrevious)
+{
+    return ((note - target) % 12 == 0) & (!hasPrevious | (note - previousNote == target - previousTarget));
+}
+
+constexpr bool matchesExactly(NoteSet held, NoteSet target) { return held == target; }
+
+// Same pitch classes in any voicing or octave.
+constexpr bool matchesVoicing(NoteSet held, NoteSet target) { return held.pitchClasses() == target.pitchClasses(); }
+
+constexpr bool matchesChord(NoteSet held, ChordQuality quality, int root)
+{
+    return held.pitchClasses() == chord(quality, root);
+}
+
+// Right chord, with the given chord tone (0 = root, 1 = third, ...) in the bass.
+constexpr bool matchesInversion(NoteSet held, ChordQuality quality, int root, int inversion)
+{
+    auto mask = chord(quality, root);
+    auto rotated = rotate(mask, -root);
+    auto bassInterval = 0;
+    for (auto i = 0, found = -1; i < 12; ++i)
+    {
+        found += (rotated >> i) & 1;
+        bassInterval = (found == inversion && bassInterval == 0 && ((rotated >> i) & 1)) ? i : bassInterval;
+    }
+    return (held.pitchClasses() == mask) & (held.lowest() % 12 == (root + bassInterval) % 12);
+}
+
+// 1-based scale degree of note in the scale, or 0 if it is not a scale tone.
+constexpr int scaleDegree(int note, Mode mode, int key)
+{
+    auto mask = scale(mode, key);
+    auto pc = note % 12;
+    auto below = rotate(mask, -key) & ((1 << ((pc - key + 12) % 12)) - 1);
+    return ((mask >> pc) & 1) * (popCount(below) + 1);
+}
+
+struct ChordName
+{
+    int root = -1;
+    ChordQuality quality = numChordQualities;
+};
+
+// Tries every quality at every root: a fixed 180 mask compares.
+constexpr ChordName identifyChord(NoteSet held)
+{
+    ChordName result;
+    auto pcs = held.pitchClasses();
+    for (auto q = 0; q < numChordQualities; ++q)
+        for (auto root = 0; root < 12; ++root)
+            if (chordMasks[q][root] == pcs && result.root < 0)
+                result = {root, (ChordQuality)q};
+    return result;
+}
+
+static_assert(matchesInversion(NoteSet::of(64).with(67).with(72), majorTriad, 0, 1), "C/E");
+static_assert(scaleDegree(62, major, 0) == 2, "D is degree 2 of C major");
+static_assert(identifyChord(NoteSet::of(57).with(60).with(64)).quality == minorTriad, "A minor");
+} // namespace PitchSet
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <vector>
+#include "HeadlessCommand.h"
+#include "PitchSet.h"
+
+// Headless mode for PitchSet: grading throughput.
+class PitchSetCommands : private HeadlessCommand
+{
+public:
+    static void addTo(juce::ConsoleApplication &app)
+    {
+        app.addCommand({"--grading-bench",
+                        "--grading-bench [--count=N]",
+                        "Measures chord, inversion and scale-degree grading throughput.",
+                        {},
+                        [](const juce::ArgumentList &a) { gradingBench(a); }});
+    }
+
+private:
+    template <typename Grade>
+    static void measureGrading(const char *name, const std::vector<PitchSet::NoteSet> &held, int count, Grade grade)
+    {
+        auto matches = 0;
+        auto start = juce::Time::getHighResolutionTicks();
+        for (auto i = 0; i < count; ++i)
+            matches += grade(held[(size_t)i & (held.size() - 1)], i) ? 1 : 0;
+        auto seconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start);
+
+        std::cout << juce::String(name).paddedRight(' ', 18)
+                  << juce::String(count / seconds * 1.0e-6, 1).paddedLeft(' ', 12)
+                  << juce::String(seconds * 1.0e9 / count, 2).paddedLeft(' ', 10)
+                  << juce::String(matches).paddedLeft(' ', 10) << std::endl;
+    }
+
+    static void gradingBench(const juce::ArgumentList &args)
+    {
+        using namespace PitchSet;
+        auto count = juce::jmax(1, getIntOption(args, "--count", 20000000));
+
+        // Half of the sets are real chords in some voicing, the rest random notes.
+        juce::Random random(1);
+        std::vector<NoteSet> held(4096);
+        for (size_t i = 0; i < held.size(); ++i)
+        {
+            if (i % 2 == 0)
+            {
+                auto mask = chord((ChordQuality)random.nextInt(numChordQualities), random.nextInt(12));
+                auto bass = 36 + random.nextInt(24);
+                for (auto pc = 0; pc < 12; ++pc)
+                    if ((mask >> pc) & 1)
+                        held[i] = held[i].with(bass + (pc - bass % 12 + 12) % 12 + 12 * random.nextInt(2));
+            }
+            else
+            {
+                auto numNotes = 3 + random.nextInt(3);
+                for (auto n = 0; n < numNotes; ++n)
+                    held[i] = held[i].with(36 + random.nextInt(48));
+            }
+        }
+
+        std::cout << "grading             Mgrades/s   ns each   matches" << std::endl;
+        measureGrading("chord", held, count, [](NoteSet h, int i)
+                       { return matchesChord(h, (ChordQuality)(i % numChordQualities), i % 12); });
+        measureGrading("inversion", held, count, [](NoteSet h, int i)
+                       { return matchesInversion(h, (ChordQuality)(i % numChordQualities), i % 12, i % 3); });
+        measureGrading("voicing", held, count, [&](NoteSet h, int i)
+                       { return matchesVoicing(h, held[(size_t)(i * 7) & (held.size() - 1)]); });
+        measureGrading("scale degree", held, count, [](NoteSet h, int i)
+                       { return scaleDegree(h.lowest(), (Mode)(i % numModes), i % 12) > 0; });
+        measureGrading("melodic step", held, count, [](NoteSet h, int i)
+                       { return matchesMelodicStep(h.lowest(), 60, 48 + i % 36, 60, true); });
+        measureGrading("identify chord", held, count / 10, [](NoteSet h, int)
+                       { return identifyChord(h).root >= 0; });
+    }
+};
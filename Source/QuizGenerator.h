@@ -0,0 +1,119 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "MelodyCorpus.h"
+
+// Builds the note sequences for each difficulty level. Kept free of any GUI
+// state so quizzes can also be produced offline and on worker threads.
+class QuizGenerator
+{
+public:
+    static constexpr int maxQuizLength = 6;
+    static constexpr int numIntervals = 14;
+    static constexpr int numLevels = 5;
+
+    QuizGenerator() {}
+    explicit QuizGenerator(juce::int64 seed) : random(seed) {}
+
+    // Fills quiz with a zero-terminated sequence of MIDI notes around center.
+    void generate(int difficulty, int center, int *quiz)
+    {
+        // Function-local, so it has storage without an out-of-line definition under C++14.
+        static constexpr int interval[numIntervals] = {-12, -10, -8, -7, -5, -3, -1, 2, 4, 5, 7, 9, 11, 12};
+        int rand;
+        int i;
+        switch (difficulty)
+        {
+        case 1:
+            rand = nextInterval(14);
+            quiz[0] = center;
+            quiz[1] = center + interval[rand];
+            quiz[2] = 0;
+            break;
+        case 2:
+            rand = nextInterval(14);
+            quiz[0] = center + interval[rand];
+            quiz[1] = center;
+            quiz[2] = 0;
+            break;
+        case 3:
+            rand = nextInterval(12, 1) + 1;
+            quiz[0] = center;
+            quiz[1] = center + interval[rand];
+            interval[rand] > 0
+                ? quiz[2] = center + interval[rand + (random.nextInt(14 - 1 - rand) + 1)]
+                : quiz[2] = center + interval[rand - (random.nextInt(rand) + 1)];
+            quiz[3] = 0;
+            break;
+        case 4:
+            quiz[0] = center + interval[nextInterval(14)];
+            quiz[1] = center;
+            quiz[2] = center + interval[generateRand(14)];
+            quiz[3] = 0;
+            break;
+        case 5:
+            if (takeCorpusPhrase(5, center, quiz))
+                break;
+            rand = random.nextInt(5);
+            for (i = 0; i < 5; i++)
+            {
+                i == rand ? quiz[i] = center : quiz[i] = center + interval[nextInterval(14)];
+            }
+            quiz[i] = 0;
+            break;
+        }
+    }
+
+    // Level 5 draws real melodies from the corpus while one is available.
+    void setCorpus(const MelodyCorpus *c) { corpus = c; }
+
+    // Forces the first interval drawn by the next generate() call.
+    void setFocusInterval(int index) { focusInterval = index; }
+
+    int generateRand(int range)
+    {
+        int rand = random.nextInt(range);
+        if (previousRand == rand)
+        {
+            rand = generateRand(range);
+        }
+        previousRand = rand;
+        return rand;
+    }
+
+private:
+    bool takeCorpusPhrase(int length, int center, int *quiz)
+    {
+        if (corpus == nullptr || !corpus->isOpen())
+            return false;
+
+        MelodyCorpus::Query query;
+        query.length = length;
+        auto phrase = corpus->findPhrase(query, random);
+        if (phrase < 0)
+            return false;
+
+        auto *notes = corpus->getNotes(phrase);
+        for (auto i = 0; i < length; ++i)
+            quiz[i] = center + notes[i] - notes[0];
+        quiz[length] = 0;
+        return true;
+    }
+
+    int nextInterval(int range, int offset = 0)
+    {
+        if (focusInterval < 0)
+        {
+            return generateRand(range);
+        }
+        int rand = juce::jlimit(0, range - 1, focusInterval - offset);
+        focusInterval = -1;
+        previousRand = rand;
+        return rand;
+    }
+
+    int previousRand = -1;
+    int focusInterval = -1;
+    const MelodyCorpus *corpus = nullptr;
+    juce::Random random;
+};
@@ -0,0 +1,307 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <vector>
+#include "LockFreeKeyboardState.h"
+#include "PitchSet.h"
+#include "RepaintTracker.h"
+
+// On-screen keyboard for quizzes. Once per GUI frame refresh() takes a
+// snapshot of the held notes from LockFreeKeyboardState, so no lock is
+// shared with the MIDI thread, and repaints only the keys whose state
+// changed. Keys are blits of images rendered once per key size, state and
+// display scale, as SpeakerIcon does. Besides held notes it shows the note
+// being prompted and the answers graded correct and wrong. Clicks and the
+// computer keyboard play into a juce::MidiKeyboardState, which
+// KeyboardStateBridge forwards to the synth.
+class QuizKeyboardComponent : public juce::Component
+{
+public:
+    QuizKeyboardComponent(LockFreeKeyboardState &displayedState, juce::MidiKeyboardState &inputState)
+        : state(displayedState), input(inputState)
+    {
+        setOpaque(true);
+        setWantsKeyboardFocus(true);
+    }
+
+    // Notes being prompted, polled by refresh().
+    std::function<PitchSet::NoteSet()> getPrompted;
+
+    void setRange(int lowest, int highest)
+    {
+        lowestNote = lowest;
+        highestNote = highest;
+        resized();
+    }
+
+    // A graded answer. A correct step clears earlier wrong marks; a wrong
+    // one restarts the attempt, so it clears the correct marks too.
+    void markCorrect(int note)
+    {
+        wrong = {};
+        correct = correct.with(note);
+        refresh();
+    }
+
+    void markWrong(int note)
+    {
+        correct = {};
+        wrong = PitchSet::NoteSet::of(note);
+        refresh();
+    }
+
+    void clearMarks()
+    {
+        correct = wrong = {};
+        refresh();
+    }
+
+    // Takes a new snapshot and repaints the keys that changed.
+    void refresh()
+    {
+        auto held = state.getHeldNotes(0xffff);
+        auto prompted = getPrompted != nullptr ? getPrompted() : PitchSet::NoteSet();
+        if (held == lastHeld && prompted == lastPrompted && correct == lastCorrect && wrong == lastWrong)
+            return;
+
+        auto changed = (held ^ lastHeld) | (prompted ^ lastPrompted) | (correct ^ lastCorrect) | (wrong ^ lastWrong);
+        lastHeld = held;
+        lastPrompted = prompted;
+        lastCorrect = correct;
+        lastWrong = wrong;
+
+        for (auto note = lowestNote; note <= highestNote; ++note)
+        {
+            auto shown = getKeyState(note);
+            if (changed.contains(note) && shown != shownStates[(size_t)note])
+            {
+                shownStates[(size_t)note] = shown;
+                repaint(getKeyBounds(note));
+            }
+        }
+    }
+
+    void paint(juce::Graphics &g) override
+    {
+        RepaintTracker::ScopedPaint tracked("keyboard");
+        g.fillAll(juce::Colours::darkgrey);
+
+        auto scale = g.getInternalContext().getPhysicalPixelScaleFactor();
+        auto clip = g.getClipBounds();
+        for (auto black : {false, true})
+        {
+            for (auto note = lowestNote; note <= highestNote; ++note)
+            {
+                if (isBlack(note) != black)
+                    continue;
+
+                auto bounds = getKeyBounds(note);
+                if (bounds.intersects(clip))
+                    g.drawImageTransformed(getImage(black, shownStates[(size_t)note], scale),
+                                           juce::AffineTransform::scale(1.0f / scale).translated(bounds.getPosition()));
+            }
+        }
+    }
+
+    void resized() override
+    {
+        auto numWhite = 0;
+        for (auto note = lowestNote; note <= highestNote; ++note)
+        {
+            whiteBefore[(size_t)note] = numWhite;
+            numWhite += isBlack(note) ? 0 : 1;
+        }
+
+        // Whole-pixel keys, so every key of a colour shares one image.
+        whiteWidth = juce::jmax(4, getWidth() / juce::jmax(1, numWhite));
+        blackWidth = juce::jmax(2, whiteWidth * 3 / 5);
+        blackHeight = getHeight() * 5 / 8;
+        left = (getWidth() - whiteWidth * numWhite) / 2;
+        images.clear();
+        repaint();
+    }
+
+    void mouseDown(const juce::MouseEvent &e) override { pressAt(e.getPosition()); }
+    void mouseDrag(const juce::MouseEvent &e) override { pressAt(e.getPosition()); }
+
+    void mouseUp(const juce::MouseEvent &) override
+    {
+        if (mouseNote >= 0)
+            input.noteOff(midiChannel, mouseNote, 0.0f);
+        mouseNote = -1;
+        refresh();
+    }
+
+    bool keyStateChanged(bool) override
+    {
+        auto used = false;
+        for (auto i = 0; i < keyMap.length(); ++i)
+        {
+            auto note = keyMapBase + i;
+            auto down = juce::KeyPress::isKeyCurrentlyDown(keyMap[i]);
+            if (down == keysDown.contains(note))
+            {
+                used = used || down;
+                continue;
+            }
+
+            keysDown = down ? keysDown.with(note) : keysDown ^ PitchSet::NoteSet::of(note);
+            if (down)
+                input.noteOn(midiChannel, note, 0.8f);
+            else
+                input.noteOff(midiChannel, note, 0.0f);
+            used = true;
+        }
+        refresh();
+        return used;
+    }
+
+    void focusLost(FocusChangeType) override
+    {
+        for (auto note = 0; note < 128; ++note)
+            if (keysDown.contains(note))
+                input.noteOff(midiChannel, note, 0.0f);
+        keysDown = {};
+        refresh();
+    }
+
+private:
+    enum class KeyState
+    {
+        normal,
+        prompted,
+        held,
+        correct,
+        wrong
+    };
+    static constexpr int numKeyStates = 5;
+
+    static bool isBlack(int note)
+    {
+        return juce::MidiMessage::isMidiNoteBlack(note);
+    }
+
+    KeyState getKeyState(int note) const
+    {
+        if (lastWrong.contains(note))
+            return KeyState::wrong;
+        if (lastCorrect.contains(note))
+            return KeyState::correct;
+        if (lastHeld.contains(note))
+            return KeyState::held;
+        if (lastPrompted.contains(note))
+            return KeyState::prompted;
+        return KeyState::normal;
+    }
+
+    juce::Rectangle<int> getKeyBounds(int note) const
+    {
+        auto x = left + whiteBefore[(size_t)note] * whiteWidth;
+        if (isBlack(note))
+            return {x - blackWidth / 2, 0, blackWidth, blackHeight};
+        return {x, 0, whiteWidth, getHeight()};
+    }
+
+    // Black keys first, as they lie on top.
+    int getNoteAt(juce::Point<int> position) const
+    {
+        for (auto black : {true, false})
+            for (auto note = lowestNote; note <= highestNote; ++note)
+                if (isBlack(note) == black && getKeyBounds(note).contains(position))
+                    return note;
+        return -1;
+    }
+
+    // Harder towards the front of the key, as on MidiKeyboardComponent.
+    void pressAt(juce::Point<int> position)
+    {
+        auto note = getNoteAt(position);
+        if (note == mouseNote)
+            return;
+
+        if (mouseNote >= 0)
+            input.noteOff(midiChannel, mouseNote, 0.0f);
+        mouseNote = note;
+        if (note >= 0)
+        {
+            auto height = isBlack(note) ? blackHeight : getHeight();
+            input.noteOn(midiChannel, note, juce::jlimit(0.1f, 1.0f, (float)position.y / (float)juce::jmax(1, height)));
+        }
+        refresh();
+    }
+
+    static juce::Colour getColour(bool black, KeyState keyState)
+    {
+        switch (keyState)
+        {
+        case KeyState::prompted:
+            return black ? juce::Colour(0xff2a5a9a) : juce::Colour(0xff9ec5f0);
+        case KeyState::held:
+            return black ? juce::Colour(0xff5a5a70) : juce::Colour(0xffc8c8d8);
+        case KeyState::correct:
+            return black ? juce::Colour(0xff2a7a3a) : juce::Colour(0xff9ee0a8);
+        case KeyState::wrong:
+            return black ? juce::Colour(0xff9a2a2a) : juce::Colour(0xfff0a09e);
+        case KeyState::normal:
+            break;
+        }
+        return black ? juce::Colour(0xff202020) : juce::Colours::white;
+    }
+
+    struct KeyImage
+    {
+        bool black;
+        KeyState keyState;
+        juce::Image image;
+    };
+
+    const juce::Image &getImage(bool black, KeyState keyState, float scale)
+    {
+        auto width = juce::jmax(1, juce::roundToInt((black ? blackWidth : whiteWidth) * scale));
+        auto height = juce::jmax(1, juce::roundToInt((black ? blackHeight : getHeight()) * scale));
+        for (auto &k : images)
+            if (k.black == black && k.keyState == keyState && k.image.getWidth() == width && k.image.getHeight() == height)
+                return k.image;
+
+        // Two key colours times the states, at a couple of display scales at most.
+        if (images.size() >= 4 * numKeyStates)
+            images.clear();
+
+        juce::Image image(juce::Image::RGB, width, height, false);
+        juce::Graphics g(image);
+        auto area = image.getBounds().toFloat();
+        auto colour = getColour(black, keyState);
+        g.setGradientFill(juce::ColourGradient(colour, 0.0f, 0.0f, colour.darker(black ? 0.3f : 0.08f), 0.0f, area.getBottom(), false));
+        g.fillAll();
+        g.setColour(juce::Colours::black.withAlpha(0.5f));
+        if (black)
+        {
+            g.drawRect(area, scale);
+            g.setColour(colour.brighter(0.4f));
+            g.fillRect(area.reduced(scale * 2.0f).removeFromBottom(area.getHeight() * 0.08f));
+        }
+        else
+        {
+            g.fillRect(area.removeFromRight(scale));
+        }
+
+        images.push_back({black, keyState, image});
+        return images.back().image;
+    }
+
+    // The letters MidiKeyboardComponent uses, from the C an octave above middle C.
+    const juce::String keyMap{"awsedftgyhujkolp;"};
+    static constexpr int keyMapBase = 72;
+    static constexpr int midiChannel = 1;
+
+    LockFreeKeyboardState &state;
+    juce::MidiKeyboardState &input;
+    int lowestNote = 36, highestNote = 96;
+    int whiteWidth = 16, blackWidth = 10, blackHeight = 60, left = 0;
+    PitchSet::NoteSet correct, wrong, keysDown;
+    PitchSet::NoteSet lastHeld, lastPrompted, lastCorrect, lastWrong;
+    KeyState shownStates[128] = {};
+    int whiteBefore[128] = {};
+    int mouseNote = -1;
+    std::vector<KeyImage> images;
+};
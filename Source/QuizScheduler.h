@@ -0,0 +1,253 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <queue>
+
+// Binary indexed tree over non-negative weights: O(log n) update and
+// O(log n) weighted sampling by descending the implicit tree.
+class FenwickTree
+{
+public:
+    void reset(int size)
+    {
+        values.assign((size_t)size, 0.0);
+        tree.assign((size_t)size + 1, 0.0);
+        topBit = 1;
+        while (topBit * 2 <= size)
+            topBit *= 2;
+        updatesSinceRebuild = 0;
+    }
+
+    int size() const { return (int)values.size(); }
+    double get(int index) const { return values[(size_t)index]; }
+
+    void set(int index, double value)
+    {
+        auto delta = value - values[(size_t)index];
+        values[(size_t)index] = value;
+
+        for (auto i = index + 1; i < (int)tree.size(); i += i & -i)
+            tree[(size_t)i] += delta;
+
+        // Repeated add/subtract accumulates rounding error in the partial sums.
+        if (++updatesSinceRebuild >= 4096)
+            rebuild();
+    }
+
+    double total() const
+    {
+        double sum = 0.0;
+        for (auto i = size(); i > 0; i -= i & -i)
+            sum += tree[(size_t)i];
+        return sum;
+    }
+
+    // Returns the index whose cumulative weight range contains target.
+    int find(double target) const
+    {
+        int pos = 0;
+        for (auto step = topBit; step > 0; step >>= 1)
+        {
+            if (pos + step < (int)tree.size() && tree[(size_t)(pos + step)] <= target)
+            {
+                pos += step;
+                target -= tree[(size_t)pos];
+            }
+        }
+        return juce::jmin(pos, size() - 1);
+    }
+
+    void rebuild()
+    {
+        std::fill(tree.begin(), tree.end(), 0.0);
+        for (auto i = 1; i < (int)tree.size(); ++i)
+        {
+            tree[(size_t)i] += values[(size_t)i - 1];
+            auto parent = i + (i & -i);
+            if (parent < (int)tree.size())
+                tree[(size_t)parent] += tree[(size_t)i];
+        }
+        updatesSinceRebuild = 0;
+    }
+
+private:
+    std::vector<double> values, tree;
+    int topBit = 1;
+    int updatesSinceRebuild = 0;
+};
+
+struct ExerciseItem
+{
+    int level;     // 0-based, matches QuizSession::generate difficulty - 1
+    int interval;  // index into the interval table
+    int key;       // semitones above C
+    int octave;    // register offset, -1 .. 1
+};
+
+// Adaptive scheduler over level x interval x key x register. Each item is
+// weighted by its smoothed error rate and boosted once its spaced-repetition
+// due time has passed. Picking and answering are both O(log n).
+class QuizScheduler
+{
+public:
+    static constexpr int numLevels = 5;
+    static constexpr int numIntervals = 14;
+    static constexpr int numKeys = 12;
+    static constexpr int numOctaves = 3;
+    static constexpr int numItems = numLevels * numIntervals * numKeys * numOctaves;
+
+    QuizScheduler()
+    {
+        weights.reset(numItems);
+        stats.resize(numItems);
+        rebuildWeights(0.0);
+    }
+
+    static ExerciseItem decode(int item)
+    {
+        ExerciseItem e;
+        e.octave = item % numOctaves - 1;
+        item /= numOctaves;
+        e.key = item % numKeys;
+        item /= numKeys;
+        e.interval = item % numIntervals;
+        e.level = item / numIntervals;
+        return e;
+    }
+
+    static int encode(const ExerciseItem &e)
+    {
+        return ((e.level * numIntervals + e.interval) * numKeys + e.key) * numOctaves + (e.octave + 1);
+    }
+
+    // Level 3 walks outwards from the first interval, so the outermost
+    // intervals can never be its first step.
+    static bool isValid(int item)
+    {
+        auto e = decode(item);
+        return !(e.level == 2 && (e.interval == 0 || e.interval == numIntervals - 1));
+    }
+
+    int pickNext(double now)
+    {
+        promoteDueItems(now);
+
+        auto total = weights.total();
+        if (total <= 0.0)
+            return random.nextInt(numItems);
+
+        return weights.find(random.nextDouble() * total);
+    }
+
+    void recordAnswer(int item, int mistakes, double now)
+    {
+        auto &s = stats[(size_t)item];
+        s.attempts = (juce::uint16)juce::jmin(s.attempts + 1, 0xffff);
+        s.mistakes = (juce::uint16)juce::jmin(s.mistakes + mistakes, 0xffff);
+
+        if (mistakes == 0)
+            s.dueInterval = juce::jmin(s.dueInterval * 2.5f, maxDueInterval);
+        else
+            s.dueInterval = minDueInterval;
+
+        s.dueTime = now + s.dueInterval;
+        pending.push({s.dueTime, item});
+        weights.set(item, weightFor(s, false));
+    }
+
+    void load(const juce::File &file)
+    {
+        juce::FileInputStream in(file);
+        if (!in.openedOk() || in.readInt() != fileMagic || in.readInt() != numItems)
+            return;
+
+        for (auto &s : stats)
+        {
+            s.attempts = (juce::uint16)in.readShort();
+            s.mistakes = (juce::uint16)in.readShort();
+            s.dueInterval = in.readFloat();
+            s.dueTime = in.readDouble();
+        }
+        rebuildWeights(juce::Time::currentTimeMillis() * 0.001);
+    }
+
+    void save(const juce::File &file) const
+    {
+        file.getParentDirectory().createDirectory();
+        juce::FileOutputStream out(file);
+        if (!out.openedOk())
+            return;
+
+        out.setPosition(0);
+        out.truncate();
+        out.writeInt(fileMagic);
+        out.writeInt(numItems);
+        for (auto &s : stats)
+        {
+            out.writeShort((short)s.attempts);
+            out.writeShort((short)s.mistakes);
+            out.writeFloat(s.dueInterval);
+            out.writeDouble(s.dueTime);
+        }
+    }
+
+    static juce::File getDefaultStatsFile()
+    {
+        return juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+            .getChildFile("SenseTrainer")
+            .getChildFile("stats_" + juce::File::createLegalFileName(juce::SystemStats::getLogonName()) + ".dat");
+    }
+
+private:
+    struct ItemStats
+    {
+        juce::uint16 attempts = 0, mistakes = 0;
+        float dueInterval = minDueInterval;
+        double dueTime = 0.0;
+    };
+
+    static double weightFor(const ItemStats &s, bool due)
+    {
+        auto errorRate = (s.mistakes + 1.0) / (s.attempts + s.mistakes + 2.0);
+        return errorRate * (due ? dueBoost : 1.0);
+    }
+
+    void promoteDueItems(double now)
+    {
+        while (!pending.empty() && pending.top().first <= now)
+        {
+            auto entry = pending.top();
+            pending.pop();
+
+            // Entries are never removed from the heap, only superseded.
+            auto &s = stats[(size_t)entry.second];
+            if (s.dueTime == entry.first)
+                weights.set(entry.second, weightFor(s, true));
+        }
+    }
+
+    void rebuildWeights(double now)
+    {
+        pending = {};
+        for (auto i = 0; i < numItems; ++i)
+        {
+            auto &s = stats[(size_t)i];
+            auto due = s.dueTime <= now;
+            weights.set(i, isValid(i) ? weightFor(s, due) : 0.0);
+            if (!due && isValid(i))
+                pending.push({s.dueTime, i});
+        }
+        weights.rebuild();
+    }
+
+    static constexpr int fileMagic = 0x53545331;
+    static constexpr float minDueInterval = 60.0f;
+    static constexpr float maxDueInterval = 30.0f * 24.0f * 3600.0f;
+    static constexpr double dueBoost = 4.0;
+
+    using DueEntry = std::pair<double, int>;
+    std::priority_queue<DueEntry, std::vector<DueEntry>, std::greater<DueEntry>> pending;
+    std::vector<ItemStats> stats;
+    FenwickTree weights;
+    juce::Random random;
+};
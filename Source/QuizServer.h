@@ -0,0 +1,953 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <deque>
+#include <functional>
+#include <map>
+#include "BatchExporter.h"
+#include "PitchSet.h"
+
+#if JUCE_WINDOWS
+ #include <winsock2.h>
+#else
+ #include <cerrno>
+ #include <cstring>
+ #include <fcntl.h>
+ #include <poll.h>
+ #include <sys/resource.h>
+ #include <sys/socket.h>
+#endif
+
+// Binary protocol between quiz clients and the headless server. Every frame
+// is a little-endian uint32 payload length, a uint8 message type and the
+// payload. Notes are single bytes.
+//   newQuiz  level, key, flags (bit 0: also send audio)
+//   answer   count, notes...
+//   quiz     count, notes...
+//   audio    uint32 sample rate, 16-bit mono PCM
+//   grade    mistakes, count, expected notes...
+//   error    UTF-8 text
+namespace QuizProtocol
+{
+enum MessageType : juce::uint8
+{
+    newQuiz = 0x01,
+    answer = 0x02,
+    quiz = 0x81,
+    audio = 0x82,
+    grade = 0x83,
+    error = 0xff
+};
+
+static constexpr int headerSize = 5;
+static constexpr juce::uint32 maxPayloadSize = 1 << 20;
+// Client requests are a few bytes; the server refuses anything longer.
+static constexpr juce::uint32 maxRequestPayloadSize = 256;
+static constexpr juce::uint8 wantAudio = 1;
+
+template <typename IntType>
+inline void writeLittleEndian(void *dest, IntType value)
+{
+    value = juce::ByteOrder::swapIfBigEndian(value);
+    std::memcpy(dest, &value, sizeof(value));
+}
+
+inline void appendFrame(juce::MemoryBlock &out, MessageType type, const void *payload, size_t size)
+{
+    juce::uint8 header[headerSize];
+    writeLittleEndian(header, (juce::uint32)size);
+    header[4] = type;
+    out.append(header, headerSize);
+    if (size > 0)
+        out.append(payload, size);
+}
+
+// Reassembles frames from a byte stream.
+class FrameReader
+{
+public:
+    explicit FrameReader(juce::uint32 maxPayload = maxPayloadSize) : maxSize(maxPayload) {}
+
+    void append(const void *data, size_t size)
+    {
+        auto *bytes = static_cast<const char *>(data);
+        pending.insert(pending.end(), bytes, bytes + size);
+    }
+
+    // Returns false when no complete frame is buffered; sets corrupt on a
+    // frame larger than the reader allows.
+    bool next(juce::uint8 &type, juce::MemoryBlock &payload)
+    {
+        if (pending.size() - readPos < (size_t)headerSize)
+            return compact();
+
+        auto size = juce::ByteOrder::littleEndianInt(pending.data() + readPos);
+        if (size > maxSize)
+        {
+            corrupt = true;
+            return false;
+        }
+
+        if (pending.size() - readPos < headerSize + (size_t)size)
+            return compact();
+
+        type = (juce::uint8)pending[readPos + 4];
+        payload.replaceAll(pending.data() + readPos + headerSize, size);
+        readPos += headerSize + (size_t)size;
+        return true;
+    }
+
+    bool corrupt = false;
+
+private:
+    bool compact()
+    {
+        pending.erase(pending.begin(), pending.begin() + (std::ptrdiff_t)readPos);
+        readPos = 0;
+        return false;
+    }
+
+    juce::uint32 maxSize;
+    std::vector<char> pending;
+    size_t readPos = 0;
+};
+
+// Readiness polling over StreamingSocket handles, since JUCE only waits on
+// one socket at a time.
+#if JUCE_WINDOWS
+using PollDescriptor = WSAPOLLFD;
+
+inline int pollSockets(std::vector<PollDescriptor> &fds, int timeoutMs)
+{
+    return WSAPoll(fds.data(), (ULONG)fds.size(), timeoutMs);
+}
+#else
+using PollDescriptor = pollfd;
+
+inline int pollSockets(std::vector<PollDescriptor> &fds, int timeoutMs)
+{
+    return poll(fds.data(), (nfds_t)fds.size(), timeoutMs);
+}
+#endif
+
+inline PollDescriptor makePollDescriptor(const juce::StreamingSocket &socket)
+{
+    PollDescriptor d = {};
+    d.fd = (decltype(d.fd))socket.getRawSocketHandle();
+    d.events = POLLIN;
+    return d;
+}
+
+inline bool isReadable(const PollDescriptor &d)
+{
+    return (d.revents & (POLLIN | POLLHUP | POLLERR)) != 0;
+}
+
+inline bool isWritable(const PollDescriptor &d)
+{
+    return (d.revents & POLLOUT) != 0;
+}
+
+// StreamingSocket::write blocks until everything is sent, so the server
+// switches its sockets to non-blocking and writes with sendSome().
+inline void setNonBlocking(const juce::StreamingSocket &socket)
+{
+#if JUCE_WINDOWS
+    u_long on = 1;
+    ioctlsocket((SOCKET)socket.getRawSocketHandle(), FIONBIO, &on);
+#else
+    auto handle = socket.getRawSocketHandle();
+    fcntl(handle, F_SETFL, fcntl(handle, F_GETFL) | O_NONBLOCK);
+#endif
+}
+
+// Returns the number of bytes the socket took, 0 if it would block, or -1
+// if the connection failed.
+inline int sendSome(const juce::StreamingSocket &socket, const void *data, size_t size)
+{
+#if JUCE_WINDOWS
+    auto sent = ::send((SOCKET)socket.getRawSocketHandle(), static_cast<const char *>(data), (int)size, 0);
+    if (sent < 0)
+        return WSAGetLastError() == WSAEWOULDBLOCK ? 0 : -1;
+#else
+ #ifdef MSG_NOSIGNAL
+    auto flags = MSG_NOSIGNAL;
+ #else
+    auto flags = 0;
+ #endif
+    auto sent = ::send(socket.getRawSocketHandle(), data, size, flags);
+    if (sent < 0)
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ? 0 : -1;
+#endif
+    return (int)sent;
+}
+
+// Each connection holds a descriptor, and a server with a thousand clients
+// passes the usual soft limit of 1024. Raises the soft limit towards
+// wanted as far as the hard limit allows and returns the limit in force,
+// or wanted where there is no such limit.
+inline int raiseDescriptorLimit(int wanted)
+{
+#if JUCE_WINDOWS
+    return wanted;
+#else
+    rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) != 0)
+        return wanted;
+
+    if (limit.rlim_cur != RLIM_INFINITY && limit.rlim_cur < (rlim_t)wanted)
+    {
+        limit.rlim_cur = limit.rlim_max == RLIM_INFINITY ? (rlim_t)wanted : juce::jmin((rlim_t)wanted, limit.rlim_max);
+        if (setrlimit(RLIMIT_NOFILE, &limit) != 0)
+            getrlimit(RLIMIT_NOFILE, &limit);
+    }
+    return limit.rlim_cur == RLIM_INFINITY ? wanted : (int)juce::jmin(limit.rlim_cur, (rlim_t)wanted);
+#endif
+}
+
+inline juce::String getLastErrorText()
+{
+#if JUCE_WINDOWS
+    return "error " + juce::String(WSAGetLastError());
+#else
+    return std::strerror(errno);
+#endif
+}
+} // namespace QuizProtocol
+
+//==============================================================================
+// Fixed set of threads with one task queue each. Tasks go to their preferred
+// worker's queue; idle workers steal from the back of other queues, so one
+// busy session cannot hold up the sessions queued behind it.
+class WorkStealingPool
+{
+public:
+    using Task = std::function<void(int workerIndex)>;
+
+    explicit WorkStealingPool(int numWorkers)
+    {
+        for (auto i = 0; i < juce::jmax(1, numWorkers); ++i)
+            workers.add(new Worker(*this, i));
+        for (auto *w : workers)
+            w->startThread(6);
+    }
+
+    ~WorkStealingPool()
+    {
+        for (auto *w : workers)
+            w->signalThreadShouldExit();
+        for (auto *w : workers)
+            w->wake.signal();
+        for (auto *w : workers)
+            w->stopThread(2000);
+        workers.clear();
+    }
+
+    int getNumWorkers() const { return workers.size(); }
+    juce::int64 getNumSteals() const { return numSteals.load(); }
+
+    void submit(Task task, int preferredWorker)
+    {
+        auto index = (int)((unsigned)preferredWorker % (unsigned)workers.size());
+        auto *target = workers.getUnchecked(index);
+        {
+            const juce::SpinLock::ScopedLockType lock(target->lock);
+            target->tasks.push_back(std::move(task));
+        }
+        target->wake.signal();
+
+        // If the owner is busy, let an idle worker steal it straight away.
+        if (!target->idle.load())
+            for (auto *w : workers)
+                if (w != target && w->idle.load())
+                {
+                    w->wake.signal();
+                    break;
+                }
+    }
+
+private:
+    class Worker : public juce::Thread
+    {
+    public:
+        Worker(WorkStealingPool &o, int i)
+            : juce::Thread("Quiz worker " + juce::String(i)), owner(o), index(i)
+        {
+        }
+
+        ~Worker() override
+        {
+            stopThread(2000);
+        }
+
+        void run() override
+        {
+            Task task;
+            while (!threadShouldExit())
+            {
+                if (!owner.takeTask(index, task))
+                {
+                    // A task submitted before idle was set woke nobody, so
+                    // look once more before sleeping until submit() signals.
+                    idle = true;
+                    auto found = owner.takeTask(index, task);
+                    if (!found)
+                        wake.wait(-1);
+                    idle = false;
+                    if (!found)
+                        continue;
+                }
+
+                task(index);
+                task = nullptr;
+            }
+        }
+
+        WorkStealingPool &owner;
+        const int index;
+        juce::SpinLock lock;
+        std::deque<Task> tasks;
+        juce::WaitableEvent wake;
+        std::atomic<bool> idle{false};
+    };
+
+    bool takeTask(int index, Task &task)
+    {
+        auto *own = workers.getUnchecked(index);
+        {
+            const juce::SpinLock::ScopedLockType lock(own->lock);
+            if (!own->tasks.empty())
+            {
+                task = std::move(own->tasks.front());
+                own->tasks.pop_front();
+                return true;
+            }
+        }
+
+        for (auto k = 1; k < workers.size(); ++k)
+        {
+            auto *victim = workers.getUnchecked((index + k) % workers.size());
+            const juce::SpinLock::ScopedTryLockType lock(victim->lock);
+            if (lock.isLocked() && !victim->tasks.empty())
+            {
+                task = std::move(victim->tasks.back());
+                victim->tasks.pop_back();
+                ++numSteals;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    juce::OwnedArray<Worker> workers;
+    std::atomic<juce::int64> numSteals{0};
+};
+
+//==============================================================================
+// Serves quizzes to many clients at once from a single process: one thread
+// multiplexes every connection, and sessions are processed on a work-stealing
+// pool. Quiz audio is rendered once per note sequence and cached. Workers
+// never touch sockets: replies go to the session's outbox, which the poll
+// thread writes without blocking as the socket takes it. A session whose
+// queues are full is not read from until they drain, so a client that stops
+// reading holds up only itself.
+class QuizServer : private juce::Thread
+{
+public:
+    struct Settings
+    {
+        int port = 5151;
+        int numThreads = juce::SystemStats::getNumCpus();
+        double sampleRate = 22050.0;
+        int instrument = -1; // see QuizRenderer
+        juce::File corpusFile = MelodyCorpus::getDefaultFile();
+    };
+
+    struct Stats
+    {
+        int activeSessions = 0;
+        juce::int64 totalSessions = 0, refusedConnections = 0, requests = 0, bytesSent = 0, steals = 0;
+        juce::int64 audioCacheHits = 0, audioCacheMisses = 0;
+    };
+
+    explicit QuizServer(const Settings &s)
+        : juce::Thread("Quiz server"), settings(s), pool(s.numThreads)
+    {
+        if (settings.corpusFile.existsAsFile())
+            corpus.open(settings.corpusFile);
+
+        for (auto i = 0; i < pool.getNumWorkers(); ++i)
+            renderers.add(new QuizRenderer(settings.sampleRate, 512, settings.instrument));
+    }
+
+    ~QuizServer() override
+    {
+        stop();
+    }
+
+    // Listens on the loopback interface; port 0 picks a free port.
+    bool start()
+    {
+        QuizProtocol::raiseDescriptorLimit(maxDescriptors);
+        if (!listener.createListener(settings.port, "127.0.0.1"))
+            return false;
+
+        // A connection to ourselves, so workers can wake the poll thread.
+        if (!wakeSender.connect("127.0.0.1", getPort(), 1000))
+            return false;
+        wakeReceiver.reset(listener.waitForNextConnection());
+        if (wakeReceiver == nullptr)
+            return false;
+        QuizProtocol::setNonBlocking(wakeSender);
+
+        startThread(7);
+        return true;
+    }
+
+    void stop()
+    {
+        stopThread(2000);
+        wakeSender.close();
+        wakeReceiver.reset();
+        listener.close();
+    }
+
+    int getPort() const { return listener.getBoundPort(); }
+
+    Stats getStats() const
+    {
+        Stats stats;
+        stats.activeSessions = numActiveSessions.load();
+        stats.totalSessions = numTotalSessions.load();
+        stats.refusedConnections = numRefusedConnections.load();
+        stats.requests = numRequests.load();
+        stats.bytesSent = numBytesSent.load();
+        stats.steals = pool.getNumSteals();
+        stats.audioCacheHits = numCacheHits.load();
+        stats.audioCacheMisses = numCacheMisses.load();
+        return stats;
+    }
+
+private:
+    struct Session
+    {
+        Session(juce::StreamingSocket *s, int sessionId)
+            : socket(s), id(sessionId), reader(QuizProtocol::maxRequestPayloadSize),
+              generator((juce::int64)sessionId * 7919 + 1)
+        {
+            QuizProtocol::setNonBlocking(*socket);
+        }
+
+        // Whether the poll thread should read more requests.
+        bool hasRoom()
+        {
+            const juce::ScopedLock sl(lock);
+            return inbox.size() < maxInboxFrames && outbox.getSize() - outboxSent < maxOutboxBytes;
+        }
+
+        bool hasOutput()
+        {
+            const juce::ScopedLock sl(lock);
+            return outboxSent < outbox.getSize();
+        }
+
+        // Poll thread: sends what the socket takes. Returns false if the connection failed.
+        bool flush(std::atomic<juce::int64> &bytesSent)
+        {
+            const juce::ScopedLock sl(lock);
+            if (outboxSent == outbox.getSize())
+                return true;
+
+            auto sent = QuizProtocol::sendSome(*socket, static_cast<const char *>(outbox.getData()) + outboxSent,
+                                               outbox.getSize() - outboxSent);
+            if (sent < 0)
+                return false;
+
+            outboxSent += (size_t)sent;
+            bytesSent += sent;
+            if (outboxSent == outbox.getSize())
+            {
+                outbox.reset();
+                outboxSent = 0;
+            }
+            return true;
+        }
+
+        std::unique_ptr<juce::StreamingSocket> socket;
+        const int id;
+        QuizProtocol::FrameReader reader;
+
+        // Frames waiting for a worker; at most one worker drains a session.
+        // Replies wait in the outbox for the poll thread.
+        juce::CriticalSection lock;
+        std::deque<std::pair<juce::uint8, juce::MemoryBlock>> inbox;
+        juce::MemoryBlock outbox;
+        size_t outboxSent = 0;
+        bool scheduled = false;
+        std::atomic<bool> closed{false};
+
+        QuizGenerator generator;
+        int quiz[QuizGenerator::maxQuizLength] = {};
+    };
+
+    using SessionPtr = std::shared_ptr<Session>;
+
+    // Any thread: makes the poll thread look at the outboxes again.
+    void wakePollThread()
+    {
+        if (!wakePending.exchange(true))
+        {
+            char byte = 0;
+            QuizProtocol::sendSome(wakeSender, &byte, 1);
+        }
+    }
+
+    void run() override
+    {
+        // The listener and the wake connection come first, then one per session.
+        std::vector<QuizProtocol::PollDescriptor> fds;
+        std::vector<SessionPtr> sessions;
+        fds.push_back(QuizProtocol::makePollDescriptor(listener));
+        fds.push_back(QuizProtocol::makePollDescriptor(*wakeReceiver));
+        sessions.resize(2);
+
+        char buffer[16384];
+        auto nextId = 0;
+        auto acceptPausedUntil = 0.0;
+
+        while (!threadShouldExit())
+        {
+            fds[0].events = juce::Time::getMillisecondCounterHiRes() >= acceptPausedUntil ? POLLIN : 0;
+            for (size_t i = firstSession; i < fds.size(); ++i)
+                fds[i].events = (short)((sessions[i]->hasRoom() ? POLLIN : 0) | (sessions[i]->hasOutput() ? POLLOUT : 0));
+
+            if (QuizProtocol::pollSockets(fds, 50) <= 0)
+                continue;
+
+            if (QuizProtocol::isReadable(fds[1]))
+            {
+                wakePending = false;
+                wakeReceiver->read(buffer, (int)sizeof(buffer), false);
+            }
+
+            if (QuizProtocol::isReadable(fds[0]))
+            {
+                if (auto *socket = listener.waitForNextConnection())
+                {
+                    sessions.push_back(std::make_shared<Session>(socket, nextId++));
+                    if (corpus.isOpen())
+                        sessions.back()->generator.setCorpus(&corpus);
+                    fds.push_back(QuizProtocol::makePollDescriptor(*socket));
+                    ++numActiveSessions;
+                    ++numTotalSessions;
+                }
+                else
+                {
+                    // Typically EMFILE. The connection stays queued and the
+                    // listener readable, so stop polling it for a while
+                    // rather than spin on it.
+                    auto error = QuizProtocol::getLastErrorText();
+                    ++numRefusedConnections;
+                    acceptPausedUntil = juce::Time::getMillisecondCounterHiRes() + acceptBackoffMs;
+                    juce::Logger::writeToLog("Quiz server: could not accept a connection (" + error + "), "
+                                             + juce::String(numActiveSessions.load()) + " sessions open");
+                }
+            }
+
+            for (size_t i = firstSession; i < fds.size();)
+            {
+                auto &session = sessions[i];
+                auto keep = !session->closed;
+                if (keep && QuizProtocol::isReadable(fds[i]))
+                {
+                    auto numRead = session->socket->read(buffer, (int)sizeof(buffer), false);
+                    keep = numRead > 0 && receive(session, buffer, (size_t)numRead);
+                }
+                if (keep && QuizProtocol::isWritable(fds[i]))
+                    keep = session->flush(numBytesSent);
+
+                if (keep)
+                {
+                    ++i;
+                    continue;
+                }
+
+                session->closed = true;
+                --numActiveSessions;
+                std::swap(fds[i], fds.back());
+                std::swap(sessions[i], sessions.back());
+                fds.pop_back();
+                sessions.pop_back();
+            }
+        }
+    }
+
+    bool receive(const SessionPtr &session, const char *data, size_t size)
+    {
+        session->reader.append(data, size);
+
+        juce::uint8 type;
+        juce::MemoryBlock payload;
+        while (session->reader.next(type, payload))
+        {
+            auto schedule = false;
+            {
+                const juce::ScopedLock sl(session->lock);
+                session->inbox.emplace_back(type, std::move(payload));
+                schedule = !session->scheduled;
+                session->scheduled = true;
+            }
+
+            if (schedule)
+                pool.submit([this, session](int worker) { drain(*session, worker); }, session->id);
+        }
+        return !session->reader.corrupt;
+    }
+
+    void drain(Session &session, int worker)
+    {
+        for (;;)
+        {
+            std::pair<juce::uint8, juce::MemoryBlock> frame;
+            {
+                const juce::ScopedLock sl(session.lock);
+                if (session.inbox.empty() || session.closed)
+                {
+                    session.scheduled = false;
+                    return;
+                }
+                frame = std::move(session.inbox.front());
+                session.inbox.pop_front();
+            }
+
+            juce::MemoryBlock reply;
+            handle(session, frame.first, frame.second, worker, reply);
+            ++numRequests;
+
+            {
+                const juce::ScopedLock sl(session.lock);
+                session.outbox.append(reply.getData(), reply.getSize());
+            }
+            wakePollThread();
+        }
+    }
+
+    void handle(Session &session, juce::uint8 type, const juce::MemoryBlock &payload, int worker, juce::MemoryBlock &reply)
+    {
+        auto *bytes = static_cast<const juce::uint8 *>(payload.getData());
+
+        if (type == QuizProtocol::newQuiz && payload.getSize() >= 3)
+        {
+            auto level = juce::jlimit(1, QuizGenerator::numLevels, (int)bytes[0]);
+            auto key = bytes[1] % 12;
+            session.generator.generate(level, 60 + key, session.quiz);
+
+            juce::uint8 notes[QuizGenerator::maxQuizLength + 1];
+            auto count = getNotes(session.quiz, notes + 1);
+            notes[0] = (juce::uint8)count;
+            QuizProtocol::appendFrame(reply, QuizProtocol::quiz, notes, (size_t)count + 1);
+
+            if ((bytes[2] & QuizProtocol::wantAudio) != 0)
+            {
+                auto audio = getAudio(session.quiz, worker);
+                QuizProtocol::appendFrame(reply, QuizProtocol::audio, audio->getData(), audio->getSize());
+            }
+        }
+        else if (type == QuizProtocol::answer && payload.getSize() >= 1 && payload.getSize() >= (size_t)bytes[0] + 1)
+        {
+            juce::uint8 result[QuizGenerator::maxQuizLength + 2];
+            auto count = getNotes(session.quiz, result + 2);
+            auto numAnswered = (int)bytes[0];
+
+            auto mistakes = std::abs(numAnswered - count);
+            for (auto i = 0; i < juce::jmin(numAnswered, count); ++i)
+                mistakes += PitchSet::matchesMelodicStep(bytes[1 + i], i ? bytes[i] : 0, session.quiz[i],
+                                                         i ? session.quiz[i - 1] : 0, i > 0)
+                                ? 0
+                                : 1;
+
+            result[0] = (juce::uint8)juce::jmin(255, mistakes);
+            result[1] = (juce::uint8)count;
+            QuizProtocol::appendFrame(reply, QuizProtocol::grade, result, (size_t)count + 2);
+        }
+        else
+        {
+            juce::String message("Bad request");
+            QuizProtocol::appendFrame(reply, QuizProtocol::error, message.toRawUTF8(), message.getNumBytesAsUTF8());
+        }
+    }
+
+    static int getNotes(const int *quiz, juce::uint8 *notes)
+    {
+        auto count = 0;
+        for (; count < QuizGenerator::maxQuizLength && quiz[count]; ++count)
+            notes[count] = (juce::uint8)quiz[count];
+        return count;
+    }
+
+    std::shared_ptr<const juce::MemoryBlock> getAudio(const int *quiz, int worker)
+    {
+        juce::String key;
+        for (auto i = 0; i < QuizGenerator::maxQuizLength && quiz[i]; ++i)
+            key << quiz[i] << ' ';
+
+        {
+            const juce::ScopedLock sl(cacheLock);
+            auto found = audioCache.find(key);
+            if (found != audioCache.end())
+            {
+                ++numCacheHits;
+                return found->second;
+            }
+        }
+
+        ++numCacheMisses;
+        auto audio = std::make_shared<juce::MemoryBlock>();
+        juce::uint8 rate[4];
+        QuizProtocol::writeLittleEndian(rate, (juce::uint32)settings.sampleRate);
+        audio->append(rate, sizeof(rate));
+
+        renderers[worker]->renderBlocks(quiz, [&audio](const juce::AudioSampleBuffer &block, int numSamples)
+                                        {
+                                            auto offset = audio->getSize();
+                                            audio->setSize(offset + (size_t)numSamples * 2);
+                                            auto *out = static_cast<juce::uint8 *>(audio->getData()) + offset;
+                                            for (auto i = 0; i < numSamples; ++i)
+                                            {
+                                                auto sample = juce::jlimit(-32768, 32767, juce::roundToInt(block.getSample(0, i) * 32767.0f));
+                                                QuizProtocol::writeLittleEndian(out + 2 * i, (juce::uint16)sample);
+                                            }
+                                            return true;
+                                        });
+
+        const juce::ScopedLock sl(cacheLock);
+        if (audioCache.size() >= maxCachedQuizzes)
+            audioCache.clear();
+        audioCache.emplace(key, audio);
+        return audio;
+    }
+
+    static constexpr size_t maxCachedQuizzes = 8192;
+    static constexpr size_t firstSession = 2;
+    // Per-session limits past which the poll thread stops reading requests.
+    static constexpr size_t maxInboxFrames = 64;
+    static constexpr size_t maxOutboxBytes = 1 << 20;
+    // Descriptors the server asks for at start, and how long it stops
+    // accepting after running out.
+    static constexpr int maxDescriptors = 8192;
+    static constexpr double acceptBackoffMs = 100.0;
+
+    Settings settings;
+    juce::StreamingSocket listener, wakeSender;
+    std::unique_ptr<juce::StreamingSocket> wakeReceiver;
+    std::atomic<bool> wakePending{false};
+    MelodyCorpus corpus;
+    juce::OwnedArray<QuizRenderer> renderers;
+    juce::CriticalSection cacheLock;
+    std::map<juce::String, std::shared_ptr<const juce::MemoryBlock>> audioCache;
+    std::atomic<int> numActiveSessions{0};
+    std::atomic<juce::int64> numTotalSessions{0}, numRefusedConnections{0}, numRequests{0}, numBytesSent{0};
+    std::atomic<juce::int64> numCacheHits{0}, numCacheMisses{0};
+    WorkStealingPool pool;
+};
+
+//==============================================================================
+// Simulates classroom clients: each one asks for a quiz, answers it, waits
+// for the grade and repeats. Latency is measured from sending a request to
+// receiving its last reply frame.
+class QuizLoadGenerator
+{
+public:
+    struct Settings
+    {
+        juce::String host = "127.0.0.1";
+        int port = 5151;
+        int numClients = 1000;
+        int numThreads = 2;
+        double seconds = 10.0;
+        int audioEvery = 10;
+    };
+
+    struct Result
+    {
+        int numConnected = 0;
+        juce::int64 numRequests = 0, numGradingErrors = 0, bytesReceived = 0;
+        double seconds = 0.0;
+        std::vector<float> latenciesMs;
+    };
+
+    static Result run(const Settings &settings)
+    {
+        juce::OwnedArray<ClientThread> threads;
+        for (auto t = 0; t < juce::jmax(1, settings.numThreads); ++t)
+            threads.add(new ClientThread(settings, t));
+
+        auto start = juce::Time::getMillisecondCounterHiRes();
+        for (auto *t : threads)
+            t->startThread();
+        for (auto *t : threads)
+            t->waitForThreadToExit(-1);
+
+        Result result;
+        result.seconds = (juce::Time::getMillisecondCounterHiRes() - start) * 0.001;
+        for (auto *t : threads)
+        {
+            result.numConnected += t->numConnected;
+            result.numRequests += t->numRequests;
+            result.numGradingErrors += t->numGradingErrors;
+            result.bytesReceived += t->bytesReceived;
+            result.latenciesMs.insert(result.latenciesMs.end(), t->latenciesMs.begin(), t->latenciesMs.end());
+        }
+        std::sort(result.latenciesMs.begin(), result.latenciesMs.end());
+        return result;
+    }
+
+private:
+    struct Client
+    {
+        std::unique_ptr<juce::StreamingSocket> socket;
+        QuizProtocol::FrameReader reader;
+        juce::int64 sentTicks = 0;
+        int framesExpected = 0;
+        int expectedMistakes = 0;
+        int requestIndex = 0;
+        juce::uint8 notes[QuizGenerator::maxQuizLength] = {};
+        int numNotes = 0;
+    };
+
+    class ClientThread : public juce::Thread
+    {
+    public:
+        ClientThread(const Settings &s, int i)
+            : juce::Thread("Quiz client " + juce::String(i)), settings(s), index(i), random(i + 1)
+        {
+        }
+
+        void run() override
+        {
+            std::vector<Client> clients;
+            std::vector<QuizProtocol::PollDescriptor> fds;
+            for (auto c = index; c < settings.numClients; c += settings.numThreads)
+            {
+                Client client;
+                client.socket.reset(new juce::StreamingSocket());
+                if (!client.socket->connect(settings.host, settings.port, 5000))
+                    continue;
+
+                fds.push_back(QuizProtocol::makePollDescriptor(*client.socket));
+                clients.push_back(std::move(client));
+            }
+            numConnected = (int)clients.size();
+
+            for (auto &client : clients)
+                requestQuiz(client);
+
+            auto end = juce::Time::getMillisecondCounterHiRes() + settings.seconds * 1000.0;
+            char buffer[65536];
+            juce::uint8 type;
+            juce::MemoryBlock payload;
+
+            while (!threadShouldExit() && juce::Time::getMillisecondCounterHiRes() < end)
+            {
+                if (QuizProtocol::pollSockets(fds, 20) <= 0)
+                    continue;
+
+                for (size_t i = 0; i < clients.size();)
+                {
+                    if (!QuizProtocol::isReadable(fds[i]))
+                    {
+                        ++i;
+                        continue;
+                    }
+
+                    auto &client = clients[i];
+                    auto numRead = client.socket->read(buffer, (int)sizeof(buffer), false);
+                    if (numRead > 0)
+                    {
+                        bytesReceived += numRead;
+                        client.reader.append(buffer, (size_t)numRead);
+                        while (client.reader.next(type, payload))
+                            handleReply(client, type, payload);
+                        ++i;
+                        continue;
+                    }
+
+                    // A closed socket keeps reporting POLLHUP, so it leaves the poll set.
+                    std::swap(fds[i], fds.back());
+                    std::swap(clients[i], clients.back());
+                    fds.pop_back();
+                    clients.pop_back();
+                }
+
+                if (clients.empty())
+                    break;
+            }
+        }
+
+        int numConnected = 0;
+        juce::int64 numRequests = 0, numGradingErrors = 0, bytesReceived = 0;
+        std::vector<float> latenciesMs;
+
+    private:
+        void send(Client &client, QuizProtocol::MessageType type, const juce::uint8 *payload, size_t size, int numReplies)
+        {
+            juce::MemoryBlock frame;
+            QuizProtocol::appendFrame(frame, type, payload, size);
+            client.framesExpected = numReplies;
+            client.sentTicks = juce::Time::getHighResolutionTicks();
+            client.socket->write(frame.getData(), (int)frame.getSize());
+        }
+
+        void requestQuiz(Client &client)
+        {
+            auto audio = settings.audioEvery > 0 && client.requestIndex++ % settings.audioEvery == 0;
+            juce::uint8 request[] = {(juce::uint8)(1 + random.nextInt(QuizGenerator::numLevels)),
+                                     (juce::uint8)random.nextInt(12),
+                                     audio ? QuizProtocol::wantAudio : (juce::uint8)0};
+            send(client, QuizProtocol::newQuiz, request, sizeof(request), audio ? 2 : 1);
+        }
+
+        void handleReply(Client &client, juce::uint8 type, const juce::MemoryBlock &payload)
+        {
+            auto *bytes = static_cast<const juce::uint8 *>(payload.getData());
+            if (type == QuizProtocol::quiz && payload.getSize() >= 1)
+            {
+                client.numNotes = juce::jmin((int)bytes[0], QuizGenerator::maxQuizLength, (int)payload.getSize() - 1);
+                std::copy(bytes + 1, bytes + 1 + client.numNotes, client.notes);
+            }
+            else if (type == QuizProtocol::grade && payload.getSize() >= 1)
+            {
+                if (bytes[0] != client.expectedMistakes)
+                    ++numGradingErrors;
+            }
+
+            if (--client.framesExpected > 0)
+                return;
+
+            latenciesMs.push_back((float)(juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - client.sentTicks) * 1000.0));
+            ++numRequests;
+
+            if (type == QuizProtocol::grade || type == QuizProtocol::error)
+            {
+                requestQuiz(client);
+                return;
+            }
+
+            // Answer correctly, or with the last note a semitone sharp a quarter of the time.
+            juce::uint8 answer[QuizGenerator::maxQuizLength + 1];
+            answer[0] = (juce::uint8)client.numNotes;
+            std::copy(client.notes, client.notes + client.numNotes, answer + 1);
+            client.expectedMistakes = 0;
+            if (client.numNotes > 0 && random.nextInt(4) == 0)
+            {
+                answer[client.numNotes] = (juce::uint8)(answer[client.numNotes] + 1);
+                client.expectedMistakes = 1;
+            }
+            send(client, QuizProtocol::answer, answer, (size_t)client.numNotes + 1, 1);
+        }
+
+        const Settings &settings;
+        const int index;
+        juce::Random random;
+    };
+};
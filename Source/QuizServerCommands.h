@@ -0,0 +1,110 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "HeadlessCommand.h"
+#include "QuizServer.h"
+
+// Headless modes for QuizServer: serving and a load generator.
+class QuizServerCommands : private HeadlessCommand
+{
+public:
+    static void addTo(juce::ConsoleApplication &app)
+    {
+        app.addCommand({"--serve",
+                        "--serve [--port=N] [--threads=N] [--seconds=N] [--instrument=N]",
+                        "Runs the multi-session quiz server on the loopback interface.",
+                        "Clients request quizzes, optional audio and grades over the QuizProtocol framing. Quiz audio uses the "
+                        "app's instrument unless --instrument picks 0 sine, 1 sampled piano, 2 plucked string or 3 modal piano.",
+                        [](const juce::ArgumentList &a) { serve(a); }});
+        app.addCommand({"--server-load",
+                        "--server-load [--clients=N] [--seconds=N] [--audio-every=N] [--port=N]",
+                        "Simulates N quiz clients and reports throughput and tail latency.",
+                        "Starts an in-process server unless --port names a running one.",
+                        [](const juce::ArgumentList &a) { serverLoad(a); }});
+    }
+
+private:
+    // Descriptors kept back for the wake connection, files and libraries.
+    static constexpr int spareDescriptors = 64;
+
+    static void printServerStats(const QuizServer &server)
+    {
+        auto stats = server.getStats();
+        std::cout << "sessions " << stats.activeSessions << " (" << stats.totalSessions << " total, "
+                  << stats.refusedConnections << " refused), requests "
+                  << stats.requests << ", sent " << stats.bytesSent / 1024 << " KB, steals " << stats.steals
+                  << ", audio cache " << stats.audioCacheHits << " hits / " << stats.audioCacheMisses << " misses"
+                  << std::endl;
+    }
+
+    static void serve(const juce::ArgumentList &args)
+    {
+        QuizServer::Settings settings;
+        settings.port = getIntOption(args, "--port", settings.port);
+        settings.numThreads = juce::jmax(1, getIntOption(args, "--threads", settings.numThreads));
+        settings.instrument = juce::jlimit(-1, 3, getIntOption(args, "--instrument", settings.instrument));
+        auto seconds = getIntOption(args, "--seconds", 0);
+
+        QuizServer server(settings);
+        if (!server.start())
+            juce::ConsoleApplication::fail("Could not listen on port " + juce::String(settings.port));
+
+        std::cout << "Serving quizzes on 127.0.0.1:" << server.getPort() << std::endl;
+        for (auto elapsed = 0; seconds <= 0 || elapsed < seconds; elapsed += 5)
+        {
+            juce::Thread::sleep(5000);
+            printServerStats(server);
+        }
+    }
+
+    static void serverLoad(const juce::ArgumentList &args)
+    {
+        QuizLoadGenerator::Settings settings;
+        settings.numClients = juce::jmax(1, getIntOption(args, "--clients", settings.numClients));
+        settings.seconds = juce::jmax(1, getIntOption(args, "--seconds", 10));
+        settings.audioEvery = getIntOption(args, "--audio-every", settings.audioEvery);
+        settings.numThreads = juce::jlimit(1, 8, settings.numClients / 250 + 1);
+
+        // Every client holds a descriptor, and so does its server session
+        // when the server runs in this process.
+        auto perClient = args.containsOption("--port") ? 1 : 2;
+        auto available = (QuizProtocol::raiseDescriptorLimit(settings.numClients * perClient + spareDescriptors) - spareDescriptors) / perClient;
+        if (available < settings.numClients)
+        {
+            std::cout << "Only " << juce::jmax(0, available) << " clients fit the open file limit" << std::endl;
+            settings.numClients = juce::jmax(1, available);
+            settings.numThreads = juce::jlimit(1, 8, settings.numClients / 250 + 1);
+        }
+
+        std::unique_ptr<QuizServer> server;
+        if (args.containsOption("--port"))
+        {
+            settings.port = getIntOption(args, "--port", settings.port);
+        }
+        else
+        {
+            QuizServer::Settings serverSettings;
+            serverSettings.port = 0;
+            server.reset(new QuizServer(serverSettings));
+            if (!server->start())
+                juce::ConsoleApplication::fail("Could not start the quiz server");
+            settings.port = server->getPort();
+        }
+
+        auto result = QuizLoadGenerator::run(settings);
+        auto &latencies = result.latenciesMs;
+        if (latencies.empty())
+            juce::ConsoleApplication::fail("No replies received");
+
+        auto percentile = [&latencies](double p) { return latencies[juce::jmin(latencies.size() - 1, (size_t)(latencies.size() * p))]; };
+        std::cout << "clients " << result.numConnected << "/" << settings.numClients << ", "
+                  << juce::String(result.numRequests / result.seconds, 0) << " requests/s, "
+                  << juce::String(result.bytesReceived / result.seconds / (1024.0 * 1024.0), 1) << " MB/s received" << std::endl;
+        std::cout << "latency ms  p50 " << juce::String(percentile(0.5), 2) << "  p99 " << juce::String(percentile(0.99), 2)
+                  << "  p99.9 " << juce::String(percentile(0.999), 2) << "  max " << juce::String(latencies.back(), 2) << std::endl;
+        if (result.numGradingErrors > 0)
+            std::cout << "grading mismatches: " << result.numGradingErrors << std::endl;
+        if (server != nullptr)
+            printServerStats(*server);
+    }
+};
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "QuizGenerator.h"
+#include "QuizScheduler.h"
+#include "MelodyCorpus.h"
+#include "RhythmEngine.h"
+#include "Metrics.h"
+
+// The current quiz and how it was picked, with no GUI attached. The quiz
+// panel drives it from its buttons, the synth reads the notes and the
+// replay flag on the audio thread, and headless modes can use it alone.
+class QuizSession
+{
+public:
+    static constexpr int adaptiveLevel = 6;
+    static constexpr int rhythmLevel = 7;
+
+    // MIDI notes of the melody, terminated by 0.
+    int quiz[6] = {};
+    // True while the quiz is being played back; the audio thread clears it.
+    std::atomic<bool> replaying{false};
+    // True between Start and Stop, while played notes are graded.
+    bool answering = false;
+    RhythmPattern rhythm;
+
+    // Called on the message thread after a replay finishes.
+    std::function<void()> onReplayCompleted;
+
+    // Spaced-repetition statistics and the melody corpus, if one was built.
+    void loadState()
+    {
+        scheduler.load(QuizScheduler::getDefaultStatsFile());
+        if (corpus.open(MelodyCorpus::getDefaultFile()))
+            generator.setCorpus(&corpus);
+    }
+
+    void saveState() const
+    {
+        scheduler.save(QuizScheduler::getDefaultStatsFile());
+    }
+
+    void setCenterNote(int note) { center = note; }
+    int getCenterNote() const { return center; }
+
+    bool isRhythmMode() const { return rhythmMode; }
+
+    // difficulty is a level from 1 to 5, adaptiveLevel or rhythmLevel.
+    void generate(int difficulty)
+    {
+        Metrics::get().quizzesGenerated.add();
+        Metrics::ScopedTimer timer(Metrics::get().quizGenerationSeconds);
+        int base = center;
+        currentItem = -1;
+        rhythmMode = difficulty == rhythmLevel;
+        if (rhythmMode)
+        {
+            rhythm = RhythmPattern::generate(rhythmRandom);
+            quiz[0] = 0;
+            return;
+        }
+        if (difficulty == adaptiveLevel)
+        {
+            currentItem = scheduler.pickNext(juce::Time::currentTimeMillis() * 0.001);
+            auto item = QuizScheduler::decode(currentItem);
+            base = 60 + item.key + 12 * item.octave;
+            generator.setFocusInterval(item.interval);
+            difficulty = item.level + 1;
+        }
+        generator.generate(difficulty, base, quiz);
+    }
+
+    void quizAnswered(int mistakes)
+    {
+        if (currentItem >= 0)
+        {
+            scheduler.recordAnswer(currentItem, mistakes, juce::Time::currentTimeMillis() * 0.001);
+            currentItem = -1;
+        }
+    }
+
+    // Clears the replay flag first so the audio thread doesn't start another take.
+    // Message thread.
+    void replayCompleted()
+    {
+        replaying = false;
+        if (onReplayCompleted)
+            onReplayCompleted();
+    }
+
+    // Audio thread: ends the replay now and leaves the notification for the
+    // message thread to deliver with dispatchReplayCompleted().
+    void finishReplay()
+    {
+        replaying = false;
+        completionPending = true;
+    }
+
+    bool isCompletionPending() const { return completionPending.load(); }
+
+    // Message thread: delivers a completion left by finishReplay(), if any.
+    void dispatchReplayCompleted()
+    {
+        if (completionPending.exchange(false) && onReplayCompleted)
+            onReplayCompleted();
+    }
+
+private:
+    std::atomic<bool> completionPending{false};
+    int center = 60;
+    bool rhythmMode = false;
+    int currentItem = -1;
+    juce::Random rhythmRandom;
+    QuizScheduler scheduler;
+    QuizGenerator generator;
+    MelodyCorpus corpus;
+};
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "Tracing.h"
+
+// Keeps the device timestamps of recent MIDI note-ons, so an answer handled
+// later on the message thread can be timed from when the key was pressed.
+class AnswerTimestamps : public juce::MidiInputCallback
+{
+public:
+    void setInputLatencyMs(double ms) { inputLatency = ms * 0.001; }
+
+    void handleIncomingMidiMessage(juce::MidiInput *, const juce::MidiMessage &message) override
+    {
+        if (!message.isNoteOn())
+            return;
+
+        Tracer::Scope traced("MIDI input");
+        Tracer::getInstance().beginNoteFlow(message.getNoteNumber());
+        const juce::SpinLock::ScopedLockType sl(lock);
+        recent[next] = {message.getNoteNumber(), message.getTimeStamp() - inputLatency.load()};
+        next = (next + 1) % numRecent;
+    }
+
+    // Time in seconds the note was played, or fallback if it did not come
+    // from MIDI input within the last second.
+    double getPressTime(int note, double fallback) const
+    {
+        const juce::SpinLock::ScopedLockType sl(lock);
+        for (auto i = 1; i <= numRecent; ++i)
+        {
+            auto &e = recent[(next - i + numRecent) % numRecent];
+            if (e.note == note && fallback - e.time < 1.0)
+                return e.time;
+        }
+        return fallback;
+    }
+
+private:
+    static constexpr int numRecent = 16;
+
+    struct Press
+    {
+        int note = -1;
+        double time = 0.0;
+    };
+
+    juce::SpinLock lock;
+    Press recent[numRecent];
+    int next = 0;
+    std::atomic<double> inputLatency{0.0};
+};
+
+// Per-student reaction time histograms, one per difficulty.
+class ReactionStats
+{
+public:
+    static constexpr int numLevels = 8;
+    static constexpr int numBins = 100;
+    static constexpr double binWidthMs = 50.0;
+
+    void add(int level, double ms)
+    {
+        if (!juce::isPositiveAndBelow(level, numLevels) || ms < 0.0)
+            return;
+
+        auto bin = juce::jmin(numBins - 1, (int)(ms / binWidthMs));
+        ++histograms[level][bin];
+    }
+
+    int getCount(int level) const
+    {
+        auto total = 0;
+        for (auto n : histograms[level])
+            total += n;
+        return total;
+    }
+
+    // Upper edge of the bin holding the given fraction of answers.
+    double getPercentileMs(int level, double fraction) const
+    {
+        auto target = fraction * getCount(level);
+        auto seen = 0;
+        for (auto b = 0; b < numBins; ++b)
+        {
+            seen += histograms[level][b];
+            if (seen > 0 && seen >= target)
+                return (b + 1) * binWidthMs;
+        }
+        return 0.0;
+    }
+
+    const int *getHistogram(int level) const { return histograms[level]; }
+
+    void load(const juce::File &file)
+    {
+        juce::FileInputStream in(file);
+        if (!in.openedOk() || in.readInt() != fileMagic || in.readInt() != numLevels * numBins)
+            return;
+
+        for (auto &level : histograms)
+            for (auto &n : level)
+                n = in.readInt();
+    }
+
+    void save(const juce::File &file) const
+    {
+        file.getParentDirectory().createDirectory();
+        juce::FileOutputStream out(file);
+        if (!out.openedOk())
+            return;
+
+        out.setPosition(0);
+        out.truncate();
+        out.writeInt(fileMagic);
+        out.writeInt(numLevels * numBins);
+        for (auto &level : histograms)
+            for (auto n : level)
+                out.writeInt(n);
+    }
+
+    static juce::File getDefaultFile()
+    {
+        return juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+            .getChildFile("SenseTrainer")
+            .getChildFile("reaction_" + juce::File::createLegalFileName(juce::SystemStats::getLogonName()) + ".dat");
+    }
+
+private:
+    static constexpr int fileMagic = 0x52544853;
+
+    int histograms[numLevels][numBins] = {};
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "HeadlessCommand.h"
+#include "ReactionTime.h"
+
+// Headless mode for ReactionStats: prints the stored histograms.
+class ReactionTimeCommands : private HeadlessCommand
+{
+public:
+    static void addTo(juce::ConsoleApplication &app)
+    {
+        app.addCommand({"--reaction-stats",
+                        "--reaction-stats",
+                        "Prints the current user's reaction time histograms.",
+                        {},
+                        [](const juce::ArgumentList &a) { reactionStats(a); }});
+    }
+
+private:
+    static void reactionStats(const juce::ArgumentList &)
+    {
+        ReactionStats stats;
+        stats.load(ReactionStats::getDefaultFile());
+
+        for (auto level = 1; level < ReactionStats::numLevels; ++level)
+        {
+            auto count = stats.getCount(level);
+            if (count == 0)
+                continue;
+
+            std::cout << "level " << level << ": " << count << " answers, median " << stats.getPercentileMs(level, 0.5)
+                      << " ms, p90 " << stats.getPercentileMs(level, 0.9) << " ms" << std::endl;
+
+            auto *histogram = stats.getHistogram(level);
+            auto peak = *std::max_element(histogram, histogram + ReactionStats::numBins);
+            for (auto b = 0; b < ReactionStats::numBins; ++b)
+                if (histogram[b] > 0)
+                    std::cout << juce::String((int)(b * ReactionStats::binWidthMs)).paddedLeft(' ', 6) << " ms "
+                              << juce::String::repeatedString("#", juce::jmax(1, histogram[b] * 40 / peak)) << " "
+                              << histogram[b] << std::endl;
+        }
+    }
+};
@@ -0,0 +1,521 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+#if JUCE_LINUX
+ #include <pthread.h>
+ #include <sched.h>
+ #include <sys/mman.h>
+ #include <sys/resource.h>
+ #include <sys/syscall.h>
+ #include <unistd.h>
+ #include <cerrno>
+ #include <cstring>
+#endif
+
+// Opt-in real-time setup for the audio callback and the threads it waits
+// on. Each of them calls enterRealtime() as it starts: denormals are always
+// flushed to zero there, and on Linux, when enabled, the thread asks for
+// SCHED_FIFO (raising the soft RLIMIT_RTPRIO to its hard limit if it has
+// to, then asking rtkit over D-Bus, which is how most desktop sessions
+// grant it) and workers are pinned to the configured cores. The audio
+// callback never waits for rtkit: its request goes to a helper thread, and
+// a thread rtkit has already served is not asked again. What each thread
+// actually got is kept for getReport().
+class RealtimeThreads
+{
+public:
+    enum class Role
+    {
+        audio,
+        voiceWorker,
+        reverbTail,
+        streamer
+    };
+
+    struct Settings
+    {
+        bool enabled = false;
+        int priority = 70; // SCHED_FIFO priority of the audio callback
+        bool lockMemory = true;
+        juce::Array<int> workerCores;
+
+        void load(const juce::File &file)
+        {
+            auto xml = juce::parseXML(file);
+            if (xml == nullptr || !xml->hasTagName("Realtime"))
+                return;
+
+            enabled = xml->getBoolAttribute("enabled");
+            priority = juce::jlimit(1, 99, xml->getIntAttribute("priority", priority));
+            lockMemory = xml->getBoolAttribute("lockMemory", lockMemory);
+            workerCores.clearQuick();
+            for (auto &core : juce::StringArray::fromTokens(xml->getStringAttribute("workerCores"), ",", {}))
+                if (core.trim().isNotEmpty())
+                    workerCores.add(core.getIntValue());
+        }
+
+        bool save(const juce::File &file) const
+        {
+            juce::StringArray cores;
+            for (auto core : workerCores)
+                cores.add(juce::String(core));
+
+            juce::XmlElement xml("Realtime");
+            xml.setAttribute("enabled", enabled);
+            xml.setAttribute("priority", priority);
+            xml.setAttribute("lockMemory", lockMemory);
+            xml.setAttribute("workerCores", cores.joinIntoString(","));
+            file.getParentDirectory().createDirectory();
+            return xml.writeTo(file);
+        }
+    };
+
+    static RealtimeThreads &getInstance()
+    {
+        static RealtimeThreads instance;
+        return instance;
+    }
+
+    static juce::File getDefaultFile()
+    {
+        return juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+            .getChildFile("SenseTrainer")
+            .getChildFile("realtime.xml");
+    }
+
+    // Applies to threads that start after the call.
+    void setSettings(const Settings &newSettings)
+    {
+        {
+            const juce::SpinLock::ScopedLockType sl(lock);
+            settings = newSettings;
+        }
+#if JUCE_LINUX
+        if (newSettings.enabled)
+            rtkitHelper.startThread();
+#endif
+    }
+
+    Settings getSettings() const
+    {
+        const juce::SpinLock::ScopedLockType sl(lock);
+        return settings;
+    }
+
+    // Call at the start of a real-time thread (or the first audio callback).
+    void enterRealtime(Role role, int index)
+    {
+        juce::FloatVectorOperations::disableDenormalisedNumberSupport();
+
+        auto &slot = slots[(int)role][juce::jlimit(0, maxIndex - 1, index)];
+        slot.valid = false;
+        slot.flushesDenormals = juce::FloatVectorOperations::areDenormalsDisabled();
+        slot.error = 0;
+        slot.pinFailed = false;
+        slot.viaRtkit = false;
+
+#if JUCE_LINUX
+        auto enabled = false;
+        auto priority = 0, core = -1;
+        {
+            const juce::SpinLock::ScopedLockType sl(lock);
+            enabled = settings.enabled;
+            priority = juce::jlimit(1, 99, settings.priority - priorityBelowAudio(role));
+            if (role != Role::audio && !settings.workerCores.isEmpty())
+                core = settings.workerCores[index % settings.workerCores.size()];
+        }
+
+        if (enabled)
+        {
+            slot.error = setFifo(priority, role != Role::audio, slot);
+            if (core >= 0 && core < CPU_SETSIZE)
+            {
+                cpu_set_t set;
+                CPU_ZERO(&set);
+                CPU_SET(core, &set);
+                slot.pinFailed = pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0;
+            }
+        }
+
+        sched_param param;
+        if (pthread_getschedparam(pthread_self(), &slot.policy, &param) == 0)
+            slot.priority = param.sched_priority;
+
+        cpu_set_t set;
+        slot.cores = 0;
+        if (pthread_getaffinity_np(pthread_self(), sizeof(set), &set) == 0)
+            for (auto i = 0; i < 64; ++i)
+                if (CPU_ISSET(i, &set))
+                    slot.cores |= (juce::uint64)1 << i;
+#endif
+        slot.valid = true;
+    }
+
+    // Locks the process's pages, loaded samples included, into RAM. Later
+    // allocations are locked too only when RLIMIT_MEMLOCK is unlimited;
+    // otherwise they would start failing once the limit was reached.
+    void lockMemory()
+    {
+        auto current = getSettings();
+        if (!current.enabled || !current.lockMemory)
+            return;
+
+#if JUCE_LINUX
+        rlimit limit;
+        auto unlimited = getrlimit(RLIMIT_MEMLOCK, &limit) == 0 && limit.rlim_cur == RLIM_INFINITY;
+        if (mlockall(MCL_CURRENT | (unlimited ? MCL_FUTURE : 0)) == 0)
+            memoryStatus = unlimited ? "current and future pages locked" : "current pages locked";
+        else
+            memoryStatus = "mlockall failed: " + juce::String(std::strerror(errno)) + " (RLIMIT_MEMLOCK "
+                           + juce::String((juce::int64)limit.rlim_cur / 1024) + " KiB)";
+#else
+        memoryStatus = "memory locking is only set up on Linux";
+#endif
+    }
+
+    juce::StringArray getReport() const
+    {
+        juce::StringArray lines;
+        auto current = getSettings();
+        if (!current.enabled)
+            lines.add("Real-time setup off; denormals flushed to zero only");
+        else
+            lines.add("Real-time setup on, audio priority " + juce::String(current.priority));
+
+#if JUCE_LINUX
+        rlimit limit;
+        if (getrlimit(RLIMIT_RTPRIO, &limit) == 0)
+            lines.add("RLIMIT_RTPRIO " + juce::String((juce::int64)limit.rlim_cur) + "/" + juce::String((juce::int64)limit.rlim_max));
+#endif
+
+        const char *roleNames[] = {"audio", "voice worker", "reverb tail", "streamer"};
+        for (auto r = 0; r < numRoles; ++r)
+        {
+            for (auto i = 0; i < maxIndex; ++i)
+            {
+                auto &slot = slots[r][i];
+                if (!slot.valid)
+                    continue;
+
+                juce::String line(roleNames[r]);
+                if (r == (int)Role::voiceWorker)
+                    line << " " << i + 1;
+                line << ": " << policyName(slot.policy) << " " << slot.priority << ", cores " << describeCores(slot.cores)
+                     << (slot.flushesDenormals ? ", denormals flushed" : "");
+#if JUCE_LINUX
+                if (slot.error != 0)
+                    line << " (SCHED_FIFO refused: " << std::strerror(slot.error) << ")";
+                if (slot.viaRtkit)
+                    line << " (via rtkit)";
+#endif
+                if (slot.pinFailed)
+                    line << " (pinning refused)";
+                lines.add(line);
+            }
+        }
+
+        if (memoryStatus.isNotEmpty())
+            lines.add("memory: " + memoryStatus);
+        return lines;
+    }
+
+private:
+    static constexpr int numRoles = 4;
+    static constexpr int maxIndex = 16;
+
+    struct Slot
+    {
+        std::atomic<bool> valid{false};
+        bool flushesDenormals = false, pinFailed = false, viaRtkit = false;
+        int policy = 0, priority = 0, error = 0;
+        juce::uint64 cores = 0;
+#if JUCE_LINUX
+        // A request for rtkitHelper: the thread id, or 0 if none is waiting.
+        std::atomic<pid_t> rtkitPending{0};
+        pthread_t thread{};
+        int rtkitPriority = 0;
+#endif
+    };
+
+    RealtimeThreads()
+    {
+        settings.load(getDefaultFile());
+#if JUCE_LINUX
+        if (settings.enabled)
+            rtkitHelper.startThread();
+#endif
+    }
+
+    // Voice workers share the audio thread's priority since it spins on them.
+    static int priorityBelowAudio(Role role)
+    {
+        switch (role)
+        {
+        case Role::reverbTail:
+            return 5;
+        case Role::streamer:
+            return 10;
+        default:
+            return 0;
+        }
+    }
+
+#if JUCE_LINUX
+    int setFifo(int priority, bool mayBlock, Slot &slot)
+    {
+        sched_param param{};
+        param.sched_priority = priority;
+        auto result = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (result != EPERM)
+            return result;
+
+        // Without CAP_SYS_NICE the soft limit can still be raised to the hard one.
+        rlimit limit;
+        if (getrlimit(RLIMIT_RTPRIO, &limit) == 0 && limit.rlim_max > 0)
+        {
+            limit.rlim_cur = limit.rlim_max;
+            setrlimit(RLIMIT_RTPRIO, &limit);
+            param.sched_priority = (int)juce::jmin((rlim_t)priority, limit.rlim_max);
+            result = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+            if (result != EPERM)
+                return result;
+        }
+
+        // rtkit's grant survives a thread re-entering, at rtkit's lower priority.
+        auto thread = (pid_t)syscall(SYS_gettid);
+        int policy = 0;
+        if (isServedByRtkit(thread) && pthread_getschedparam(pthread_self(), &policy, &param) == 0 && policy == SCHED_FIFO)
+        {
+            slot.viaRtkit = true;
+            return 0;
+        }
+
+        if (mayBlock)
+        {
+            slot.viaRtkit = makeRealtimeThroughRtkit(thread, priority);
+            if (slot.viaRtkit)
+                rememberRtkitThread(thread);
+            return slot.viaRtkit ? 0 : result;
+        }
+
+        slot.thread = pthread_self();
+        slot.rtkitPriority = priority;
+        slot.rtkitPending.store(thread, std::memory_order_release);
+        rtkitHelper.notify();
+        return result;
+    }
+
+    // Makes the rtkit requests of threads that must not block, and updates
+    // their slots when one is granted.
+    class RtkitHelper : public juce::Thread
+    {
+    public:
+        explicit RtkitHelper(RealtimeThreads &o) : juce::Thread("rtkit helper"), owner(o) {}
+
+        ~RtkitHelper() override
+        {
+            stopThread(2000);
+        }
+
+        void run() override
+        {
+            while (!threadShouldExit())
+            {
+                for (auto &role : owner.slots)
+                {
+                    for (auto &slot : role)
+                    {
+                        auto thread = slot.rtkitPending.exchange(0, std::memory_order_acquire);
+                        if (thread == 0 || !makeRealtimeThroughRtkit(thread, slot.rtkitPriority))
+                            continue;
+
+                        owner.rememberRtkitThread(thread);
+                        sched_param param;
+                        if (pthread_getschedparam(slot.thread, &slot.policy, &param) == 0)
+                            slot.priority = param.sched_priority;
+                        slot.viaRtkit = true;
+                        slot.error = 0;
+                    }
+                }
+                wait(-1);
+            }
+        }
+
+    private:
+        RealtimeThreads &owner;
+    };
+
+    bool isServedByRtkit(pid_t thread) const
+    {
+        for (auto &served : rtkitThreads)
+            if (served.load(std::memory_order_relaxed) == thread)
+                return true;
+        return false;
+    }
+
+    // The kernel reuses thread ids, so isServedByRtkit() is only trusted
+    // while the thread is still SCHED_FIFO.
+    void rememberRtkitThread(pid_t thread)
+    {
+        for (auto &served : rtkitThreads)
+        {
+            pid_t empty = 0;
+            if (served.load(std::memory_order_relaxed) == thread || served.compare_exchange_strong(empty, thread))
+                return;
+        }
+    }
+
+    // Asks rtkit for SCHED_FIFO on the calling thread. libdbus is loaded at
+    // run time so it is not a build dependency. rtkit caps the priority (20
+    // unless configured otherwise) and only serves processes whose
+    // RLIMIT_RTTIME is within its limit, so that is set first; a thread
+    // then gets SIGXCPU after 200 ms of real-time CPU without blocking.
+    // This is a blocking round trip of up to a second.
+    static bool makeRealtimeThroughRtkit(pid_t thread, int priority)
+    {
+        static DBus dbus;
+        if (!dbus.isLoaded())
+            return false;
+
+        rlimit limit;
+        if (getrlimit(RLIMIT_RTTIME, &limit) != 0)
+            return false;
+        if (limit.rlim_max == RLIM_INFINITY || limit.rlim_max > rtkitMaxRealtimeMicroseconds)
+        {
+            limit.rlim_cur = limit.rlim_max = rtkitMaxRealtimeMicroseconds;
+            if (setrlimit(RLIMIT_RTTIME, &limit) != 0)
+                return false;
+        }
+
+        DBus::Error error;
+        dbus.errorInit(&error);
+        auto *connection = dbus.busGetPrivate(DBus::systemBus, &error);
+        if (connection == nullptr)
+        {
+            dbus.errorFree(&error);
+            return false;
+        }
+        dbus.setExitOnDisconnect(connection, 0);
+
+        auto succeeded = false;
+        if (auto *message = dbus.newMethodCall("org.freedesktop.RealtimeKit1", "/org/freedesktop/RealtimeKit1",
+                                               "org.freedesktop.RealtimeKit1", "MakeThreadRealtime"))
+        {
+            juce::uint64 rtkitThread = (juce::uint64)thread;
+            juce::uint32 rtkitPriority = (juce::uint32)juce::jmin(priority, rtkitMaxPriority);
+            if (dbus.appendArgs(message, DBus::typeUInt64, &rtkitThread, DBus::typeUInt32, &rtkitPriority, DBus::typeInvalid))
+            {
+                if (auto *reply = dbus.sendWithReplyAndBlock(connection, message, 1000, &error))
+                {
+                    succeeded = true;
+                    dbus.messageUnref(reply);
+                }
+            }
+            dbus.messageUnref(message);
+        }
+
+        dbus.errorFree(&error);
+        dbus.connectionClose(connection);
+        dbus.connectionUnref(connection);
+        return succeeded;
+    }
+
+    // The few libdbus entry points the rtkit request needs.
+    struct DBus
+    {
+        // Layout of DBusError.
+        struct Error
+        {
+            const char *name, *message;
+            unsigned int flags;
+            void *padding;
+        };
+
+        static constexpr int systemBus = 1;
+        static constexpr int typeInvalid = 0, typeUInt32 = 'u', typeUInt64 = 't';
+
+        DBus()
+        {
+            if (!library.open("libdbus-1.so.3"))
+                return;
+
+            errorInit = (void (*)(Error *))library.getFunction("dbus_error_init");
+            errorFree = (void (*)(Error *))library.getFunction("dbus_error_free");
+            busGetPrivate = (void *(*)(int, Error *))library.getFunction("dbus_bus_get_private");
+            setExitOnDisconnect = (void (*)(void *, unsigned int))library.getFunction("dbus_connection_set_exit_on_disconnect");
+            newMethodCall = (void *(*)(const char *, const char *, const char *, const char *))library.getFunction("dbus_message_new_method_call");
+            appendArgs = (unsigned int (*)(void *, int, ...))library.getFunction("dbus_message_append_args");
+            sendWithReplyAndBlock = (void *(*)(void *, void *, int, Error *))library.getFunction("dbus_connection_send_with_reply_and_block");
+            messageUnref = (void (*)(void *))library.getFunction("dbus_message_unref");
+            connectionClose = (void (*)(void *))library.getFunction("dbus_connection_close");
+            connectionUnref = (void (*)(void *))library.getFunction("dbus_connection_unref");
+        }
+
+        bool isLoaded() const
+        {
+            return errorInit != nullptr && errorFree != nullptr && busGetPrivate != nullptr && setExitOnDisconnect != nullptr
+                   && newMethodCall != nullptr && appendArgs != nullptr && sendWithReplyAndBlock != nullptr
+                   && messageUnref != nullptr && connectionClose != nullptr && connectionUnref != nullptr;
+        }
+
+        juce::DynamicLibrary library;
+        void (*errorInit)(Error *) = nullptr;
+        void (*errorFree)(Error *) = nullptr;
+        void *(*busGetPrivate)(int, Error *) = nullptr;
+        void (*setExitOnDisconnect)(void *, unsigned int) = nullptr;
+        void *(*newMethodCall)(const char *, const char *, const char *, const char *) = nullptr;
+        unsigned int (*appendArgs)(void *, int, ...) = nullptr;
+        void *(*sendWithReplyAndBlock)(void *, void *, int, Error *) = nullptr;
+        void (*messageUnref)(void *) = nullptr;
+        void (*connectionClose)(void *) = nullptr;
+        void (*connectionUnref)(void *) = nullptr;
+    };
+
+    static constexpr int rtkitMaxPriority = 20;
+    static constexpr rlim_t rtkitMaxRealtimeMicroseconds = 200000;
+#endif
+
+    static juce::String policyName(int policy)
+    {
+#if JUCE_LINUX
+        if (policy == SCHED_FIFO)
+            return "SCHED_FIFO";
+        if (policy == SCHED_RR)
+            return "SCHED_RR";
+        return "SCHED_OTHER";
+#else
+        juce::ignoreUnused(policy);
+        return "default";
+#endif
+    }
+
+    static juce::String describeCores(juce::uint64 cores)
+    {
+        if (cores == 0)
+            return "any";
+
+        juce::StringArray ranges;
+        for (auto i = 0; i < 64; ++i)
+        {
+            if (((cores >> i) & 1) == 0)
+                continue;
+
+            auto end = i;
+            while (end < 63 && ((cores >> (end + 1)) & 1) != 0)
+                ++end;
+            ranges.add(end > i ? juce::String(i) + "-" + juce::String(end) : juce::String(i));
+            i = end;
+        }
+        return ranges.joinIntoString(",");
+    }
+
+    mutable juce::SpinLock lock;
+    Settings settings;
+    Slot slots[numRoles][maxIndex];
+    juce::String memoryStatus;
+#if JUCE_LINUX
+    std::atomic<pid_t> rtkitThreads[numRoles * maxIndex] = {};
+    RtkitHelper rtkitHelper{*this};
+#endif
+};
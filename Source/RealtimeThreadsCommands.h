@@ -0,0 +1,149 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <thread>
+#include <vector>
+#include "HeadlessCommand.h"
+#include "RealtimeThreads.h"
+#include "SynthLoad.h"
+
+// Headless modes for RealtimeThreads: its settings and an xrun comparison.
+class RealtimeThreadsCommands : private HeadlessCommand
+{
+public:
+    static void addTo(juce::ConsoleApplication &app)
+    {
+        app.addCommand({"--realtime",
+                        "--realtime [--enable|--disable] [--priority=N] [--cores=2,3] [--lock-memory=0|1]",
+                        "Shows or changes the opt-in real-time thread setup used on Linux.",
+                        "Settings apply from the next start of the application.",
+                        [](const juce::ArgumentList &a) { realtimeSetup(a); }});
+        app.addCommand({"--xrun-compare",
+                        "--xrun-compare [--seconds=N] [--hogs=N] [--workers=N]",
+                        "Counts xruns under a CPU-hog load with default scheduling and with the real-time setup.",
+                        {},
+                        [](const juce::ArgumentList &a) { xrunCompare(a); }});
+    }
+
+private:
+    static void realtimeSetup(const juce::ArgumentList &args)
+    {
+        auto settings = RealtimeThreads::getInstance().getSettings();
+        auto changed = false;
+
+        if (args.containsOption("--enable") || args.containsOption("--disable"))
+        {
+            settings.enabled = args.containsOption("--enable");
+            changed = true;
+        }
+        if (args.containsOption("--priority"))
+        {
+            settings.priority = juce::jlimit(1, 99, getIntOption(args, "--priority", settings.priority));
+            changed = true;
+        }
+        if (args.containsOption("--lock-memory"))
+        {
+            settings.lockMemory = getIntOption(args, "--lock-memory", 1) != 0;
+            changed = true;
+        }
+        if (args.containsOption("--cores"))
+        {
+            settings.workerCores.clearQuick();
+            for (auto &core : juce::StringArray::fromTokens(args.getValueForOption("--cores"), ",", {}))
+                if (core.trim().isNotEmpty())
+                    settings.workerCores.add(core.getIntValue());
+            changed = true;
+        }
+
+        if (changed && !settings.save(RealtimeThreads::getDefaultFile()))
+            juce::ConsoleApplication::fail("Could not write " + RealtimeThreads::getDefaultFile().getFullPathName());
+
+        juce::StringArray cores;
+        for (auto core : settings.workerCores)
+            cores.add(juce::String(core));
+        std::cout << "enabled " << (settings.enabled ? "yes" : "no") << ", audio priority " << settings.priority
+                  << ", lock memory " << (settings.lockMemory ? "yes" : "no") << ", worker cores "
+                  << (cores.isEmpty() ? juce::String("any") : cores.joinIntoString(",")) << std::endl;
+    }
+
+    // Plays a sustained chord against busy threads of normal priority and
+    // counts xruns, as device-reported ones plus late callbacks.
+    static juce::int64 countXruns(juce::AudioDeviceManager &devices, SynthLoad &load, int seconds, int numHogs)
+    {
+        devices.closeAudioDevice();
+        devices.restartLastAudioDevice();
+        auto *device = devices.getCurrentAudioDevice();
+        if (device == nullptr)
+            juce::ConsoleApplication::fail("Audio device did not restart");
+
+        load.active = true;
+        juce::Thread::sleep(500);
+
+        std::atomic<bool> stop{false};
+        std::vector<std::thread> hogs;
+        for (auto i = 0; i < numHogs; ++i)
+            hogs.emplace_back([&stop, i]
+                              {
+                                  std::vector<float> scratch(1 << 20, (float)i);
+                                  while (!stop.load())
+                                      for (size_t k = 0; k < scratch.size(); k += 16)
+                                          scratch[k] = std::sqrt(scratch[k] + 1.0f);
+                              });
+
+        auto before = load.monitor.snapshot();
+        auto deviceBefore = device->getXRunCount();
+        juce::Thread::sleep(seconds * 1000);
+        auto after = load.monitor.snapshot();
+        auto deviceAfter = device->getXRunCount();
+
+        stop = true;
+        for (auto &t : hogs)
+            t.join();
+        load.active = false;
+
+        auto xruns = after.lateCallbacks - before.lateCallbacks;
+        if (deviceBefore >= 0 && deviceAfter >= 0)
+            xruns += deviceAfter - deviceBefore;
+        return xruns;
+    }
+
+    static void xrunCompare(const juce::ArgumentList &args)
+    {
+        auto seconds = juce::jmax(1, getIntOption(args, "--seconds", 20));
+        auto numHogs = juce::jmax(0, getIntOption(args, "--hogs", juce::SystemStats::getNumCpus() * 2));
+        auto &realtime = RealtimeThreads::getInstance();
+        auto configured = realtime.getSettings();
+
+        juce::AudioDeviceManager devices;
+        auto error = devices.initialiseWithDefaultDevices(0, 2);
+        if (error.isNotEmpty() || devices.getCurrentAudioDevice() == nullptr)
+            juce::ConsoleApplication::fail("Could not open an audio device: " + error);
+
+        SynthLoad load(32);
+        load.numWorkers = juce::jmax(0, getIntOption(args, "--workers", 2));
+        juce::AudioSourcePlayer player;
+        player.setSource(&load);
+        devices.addAudioCallback(&player);
+
+        auto plain = configured;
+        plain.enabled = false;
+        realtime.setSettings(plain);
+        auto defaultXruns = countXruns(devices, load, seconds, numHogs);
+
+        auto rt = configured;
+        rt.enabled = true;
+        realtime.setSettings(rt);
+        realtime.lockMemory();
+        auto realtimeXruns = countXruns(devices, load, seconds, numHogs);
+
+        for (auto &line : realtime.getReport())
+            std::cout << line << std::endl;
+        std::cout << numHogs << " hog threads, " << seconds << " s each, " << devices.getCurrentAudioDevice()->getCurrentBufferSizeSamples()
+                  << " sample buffer" << std::endl
+                  << "xruns with default scheduling: " << defaultXruns << std::endl
+                  << "xruns with real-time setup:    " << realtimeXruns << std::endl;
+
+        devices.removeAudioCallback(&player);
+        realtime.setSettings(configured);
+    }
+};
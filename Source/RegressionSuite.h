@@ -0,0 +1,489 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <map>
+#include <ostream>
+#include <vector>
+#include "QuizSession.h"
+#include "LockFreeKeyboardState.h"
+#include "SynthUsingMidiInput.h"
+#include "ConvolutionReverb.h"
+#include "PhysicalVoices.h"
+#include "DspKernels.h"
+
+// Golden-reference checks for the audio engine. Fixed quiz scripts are
+// replayed through SynthAudioSource offline at several sample rates and
+// block sizes, and each render is compared with a stored WAV: the SNR
+// against it, the onset times found in both, and the pitch of every note
+// against the script. Separately, each DSP kernel's cost per sample is
+// measured against a budget in budgets.xml, which is edited by hand.
+// Checking never writes anything; updateGoldens() re-renders the WAVs, which
+// are then reviewed and committed. Everything runs without an audio device.
+class RegressionSuite
+{
+public:
+    struct Script
+    {
+        const char *name;
+        SynthAudioSource::Instrument instrument;
+        std::vector<int> notes;
+        // Sine scripts are checked note by note; inharmonic ones are not.
+        bool checkPitch;
+    };
+
+    static const std::vector<Script> &getScripts()
+    {
+        static const std::vector<Script> scripts{
+            {"steps", SynthAudioSource::Instrument::sine, {60, 62, 64, 65, 67}, true},
+            {"leaps", SynthAudioSource::Instrument::sine, {48, 84, 55, 91, 60}, true},
+            {"repeats", SynthAudioSource::Instrument::sine, {67, 67, 64, 64, 72}, true},
+            {"piano", SynthAudioSource::Instrument::modalPiano, {60, 64, 67, 72}, false}};
+        return scripts;
+    }
+
+    static std::vector<double> getSampleRates() { return {44100.0, 48000.0, 96000.0}; }
+    static std::vector<int> getBlockSizes() { return {32, 128, 512}; }
+
+    static constexpr double minSnrDb = 60.0;
+    static constexpr double onsetToleranceMs = 1.0;
+    static constexpr double pitchToleranceCents = 2.0;
+
+    // Where each replayed note starts and is released, in samples, following
+    // the replay rule in SynthAudioSource: the next note is queued by the
+    // first block starting more than 0.5 s after the previous one was, and
+    // sounds from the start of the block after next.
+    struct Schedule
+    {
+        std::vector<juce::int64> onsets, releases;
+    };
+
+    static Schedule getSchedule(const Script &script, double sampleRate, int blockSize)
+    {
+        Schedule schedule;
+        auto queuedAt = 0.0;
+        for (juce::int64 block = 0; schedule.releases.size() < script.notes.size(); ++block)
+        {
+            auto time = (double)(block * blockSize) / sampleRate;
+            if (time - queuedAt <= 0.5)
+                continue;
+
+            if (!schedule.onsets.empty())
+                schedule.releases.push_back(block * blockSize);
+            if (schedule.onsets.size() < script.notes.size())
+                schedule.onsets.push_back((block + 2) * blockSize);
+            queuedAt = time;
+        }
+        return schedule;
+    }
+
+    // The left channel of the replayed script, with half a second after the last release.
+    static juce::AudioSampleBuffer render(const Script &script, double sampleRate, int blockSize)
+    {
+        QuizSession session;
+        LockFreeKeyboardState keyboardState;
+        SynthAudioSource source(keyboardState, session);
+        source.setInstrument(script.instrument);
+        source.getReverb().setImpulseResponse({});
+        source.setOfflineReplay(true);
+        source.prepareToPlay(blockSize, sampleRate);
+
+        for (size_t i = 0; i < script.notes.size(); ++i)
+            session.quiz[i] = script.notes[i];
+        session.replaying = true;
+
+        auto end = getSchedule(script, sampleRate, blockSize).releases.back() + (juce::int64)(0.5 * sampleRate);
+        auto numBlocks = (int)((end + blockSize - 1) / blockSize);
+        juce::AudioSampleBuffer output(1, numBlocks * blockSize), block(2, blockSize);
+        for (auto b = 0; b < numBlocks; ++b)
+        {
+            source.getNextAudioBlock(juce::AudioSourceChannelInfo(&block, 0, blockSize));
+            output.copyFrom(0, b * blockSize, block, 0, 0, blockSize);
+        }
+        source.releaseResources();
+        return output;
+    }
+
+    static juce::File getDefaultDirectory()
+    {
+        return juce::File::getCurrentWorkingDirectory().getChildFile("Regression");
+    }
+
+    static juce::File getGoldenFile(const juce::File &directory, const Script &script, double sampleRate, int blockSize)
+    {
+        return directory.getChildFile(juce::String(script.name) + "-" + juce::String((int)sampleRate) + "-" + juce::String(blockSize) + ".wav");
+    }
+
+    // Stored as 32-bit float so an unchanged engine compares exactly.
+    static bool writeGolden(const juce::File &file, const juce::AudioSampleBuffer &audio, double sampleRate)
+    {
+        file.getParentDirectory().createDirectory();
+        file.deleteFile();
+        std::unique_ptr<juce::OutputStream> stream(file.createOutputStream());
+        if (stream == nullptr)
+            return false;
+
+        std::unique_ptr<juce::AudioFormatWriter> writer(juce::WavAudioFormat().createWriterFor(stream.get(), sampleRate, 1, 32, {}, 0));
+        if (writer == nullptr)
+            return false;
+
+        stream.release();
+        return writer->writeFromAudioSampleBuffer(audio, 0, audio.getNumSamples());
+    }
+
+    static bool readGolden(const juce::File &file, juce::AudioSampleBuffer &audio)
+    {
+        juce::WavAudioFormat wav;
+        std::unique_ptr<juce::AudioFormatReader> reader(wav.createReaderFor(file.createInputStream().release(), true));
+        if (reader == nullptr)
+            return false;
+
+        audio.setSize(1, (int)reader->lengthInSamples);
+        return reader->read(&audio, 0, audio.getNumSamples(), 0, true, false);
+    }
+
+    // Infinite when the two are identical.
+    static double getSnrDb(const juce::AudioSampleBuffer &reference, const juce::AudioSampleBuffer &audio)
+    {
+        if (reference.getNumSamples() != audio.getNumSamples())
+            return -std::numeric_limits<double>::infinity();
+
+        auto *r = reference.getReadPointer(0);
+        auto *a = audio.getReadPointer(0);
+        double signal = 0.0, noise = 0.0;
+        for (auto i = 0; i < reference.getNumSamples(); ++i)
+        {
+            signal += (double)r[i] * r[i];
+            noise += ((double)a[i] - r[i]) * ((double)a[i] - r[i]);
+        }
+        if (noise == 0.0)
+            return std::numeric_limits<double>::infinity();
+        return 10.0 * std::log10(juce::jmax(1.0e-30, signal) / noise);
+    }
+
+    // Note starts in seconds: where a peak envelope with a 20 ms release
+    // grows by half within 5 ms, traced back to the start of the rise.
+    // Repeated notes that join in phase with the last one's tail are not
+    // heard as new onsets, here or by ear.
+    static std::vector<double> detectOnsets(const juce::AudioSampleBuffer &audio, double sampleRate)
+    {
+        auto *x = audio.getReadPointer(0);
+        auto numSamples = audio.getNumSamples();
+        auto release = (float)std::exp(-1.0 / (0.02 * sampleRate));
+        auto lag = (int)(0.005 * sampleRate);
+        auto refractory = (int)(0.1 * sampleRate);
+        auto floor = 0.1f * audio.getMagnitude(0, 0, numSamples);
+
+        std::vector<float> envelope((size_t)numSamples);
+        auto e = 0.0f;
+        for (auto i = 0; i < numSamples; ++i)
+            envelope[(size_t)i] = e = juce::jmax(std::abs(x[i]), e * release);
+
+        std::vector<double> onsets;
+        auto last = -refractory;
+        for (auto i = lag; i < numSamples; ++i)
+        {
+            auto level = envelope[(size_t)i];
+            if (level <= floor || level <= 1.5f * envelope[(size_t)(i - lag)] || i - last < refractory)
+                continue;
+
+            auto start = i;
+            while (start > 0 && envelope[(size_t)(start - 1)] < envelope[(size_t)start])
+                --start;
+            onsets.push_back(start / sampleRate);
+            last = i;
+        }
+        return onsets;
+    }
+
+    // Frequency from the upward zero crossings in [start, end), interpolated
+    // between samples; exact for the sine voice. 0 if under two periods.
+    static double measureFrequency(const juce::AudioSampleBuffer &audio, juce::int64 start, juce::int64 end, double sampleRate)
+    {
+        auto *x = audio.getReadPointer(0);
+        auto first = -1.0, lastCrossing = -1.0;
+        auto count = 0;
+        for (auto i = juce::jmax((juce::int64)1, start); i < juce::jmin(end, (juce::int64)audio.getNumSamples()); ++i)
+        {
+            if (x[i - 1] < 0.0f && x[i] >= 0.0f)
+            {
+                auto crossing = (double)(i - 1) + x[i - 1] / (double)(x[i - 1] - x[i]);
+                if (first < 0.0)
+                    first = crossing;
+                lastCrossing = crossing;
+                ++count;
+            }
+        }
+        return count > 2 ? (count - 1) * sampleRate / (lastCrossing - first) : 0.0;
+    }
+
+    struct CaseResult
+    {
+        double snrDb = 0.0;
+        int onsets = 0, goldenOnsets = 0;
+        double worstOnsetMs = 0.0;
+        double worstPitchCents = 0.0;
+        bool passed = false;
+        juce::String problem;
+    };
+
+    static CaseResult check(const Script &script, double sampleRate, int blockSize,
+                            const juce::AudioSampleBuffer &audio, const juce::AudioSampleBuffer &golden)
+    {
+        CaseResult result;
+        result.snrDb = getSnrDb(golden, audio);
+
+        auto onsets = detectOnsets(audio, sampleRate);
+        auto goldenOnsets = detectOnsets(golden, sampleRate);
+        result.onsets = (int)onsets.size();
+        result.goldenOnsets = (int)goldenOnsets.size();
+        for (size_t i = 0; i < juce::jmin(onsets.size(), goldenOnsets.size()); ++i)
+            result.worstOnsetMs = juce::jmax(result.worstOnsetMs, std::abs(onsets[i] - goldenOnsets[i]) * 1000.0);
+
+        if (script.checkPitch)
+        {
+            // From 50 ms in, when the previous note's tail has gone, to the release.
+            auto schedule = getSchedule(script, sampleRate, blockSize);
+            for (size_t i = 0; i < script.notes.size(); ++i)
+            {
+                auto frequency = measureFrequency(audio, schedule.onsets[i] + (juce::int64)(0.05 * sampleRate),
+                                                  schedule.releases[i], sampleRate);
+                auto cents = frequency > 0.0 ? 1200.0 * std::log2(frequency / juce::MidiMessage::getMidiNoteInHertz(script.notes[i]))
+                                             : std::numeric_limits<double>::infinity();
+                if (std::abs(cents) > std::abs(result.worstPitchCents))
+                    result.worstPitchCents = cents;
+            }
+        }
+
+        if (golden.getNumSamples() != audio.getNumSamples())
+            result.problem = "length " + juce::String(audio.getNumSamples()) + ", golden " + juce::String(golden.getNumSamples());
+        else if (result.snrDb < minSnrDb)
+            result.problem = "SNR below " + juce::String(minSnrDb) + " dB";
+        else if (onsets.size() != goldenOnsets.size())
+            result.problem = "onset count differs";
+        else if (result.worstOnsetMs > onsetToleranceMs)
+            result.problem = "onset moved";
+        else if (std::abs(result.worstPitchCents) > pitchToleranceCents)
+            result.problem = "pitch off";
+        result.passed = result.problem.isEmpty();
+        return result;
+    }
+
+    // Allowed nanoseconds per sample for each kernel, kept with the golden files.
+    class Budgets
+    {
+    public:
+        void load(const juce::File &file)
+        {
+            limits.clear();
+            auto xml = juce::parseXML(file);
+            if (xml == nullptr || !xml->hasTagName("CpuBudgets"))
+                return;
+
+            for (auto *e : xml->getChildWithTagNameIterator("Kernel"))
+                limits[e->getStringAttribute("name")] = e->getDoubleAttribute("nsPerSample");
+        }
+
+        // -1 if the kernel has no budget.
+        double get(const juce::String &name) const
+        {
+            auto found = limits.find(name);
+            return found != limits.end() ? found->second : -1.0;
+        }
+
+        static juce::File getFile(const juce::File &directory) { return directory.getChildFile("budgets.xml"); }
+
+    private:
+        std::map<juce::String, double> limits;
+    };
+
+    struct KernelCost
+    {
+        juce::String name;
+        double nsPerSample;
+    };
+
+    // Each kernel as the engine runs it at 48 kHz in blocks of blockSize:
+    // the best of five 20 ms runs, so a busy machine reads high less often.
+    static std::vector<KernelCost> measureKernelCosts(int blockSize = 128)
+    {
+        const double sampleRate = 48000.0;
+        DspKernels::prepare(2, blockSize);
+        auto &set = DspKernels::current();
+        juce::Random random(1);
+
+        std::vector<float> source((size_t)(4 * blockSize + 8)), spectrumA((size_t)(2 * (blockSize + 1))),
+            spectrumB(spectrumA.size()), accumulator(spectrumA.size()), output((size_t)blockSize);
+        for (auto *v : {&source, &spectrumA, &spectrumB})
+            for (auto &x : *v)
+                x = random.nextFloat() * 2.0f - 1.0f;
+
+        alignas(16) float re[DspKernels::maxResonators] = {}, im[DspKernels::maxResonators] = {};
+        alignas(16) float a[DspKernels::maxResonators], b[DspKernels::maxResonators], gain[DspKernels::maxResonators];
+        for (auto k = 0; k < DspKernels::maxResonators; ++k)
+        {
+            auto w = 0.02 * (k + 1);
+            a[k] = (float)(0.9999 * std::cos(w));
+            b[k] = (float)(0.9999 * std::sin(w));
+            gain[k] = 1.0f / (k + 1);
+        }
+
+        juce::AudioSampleBuffer stereo(2, blockSize);
+        stereo.clear();
+
+        std::vector<KernelCost> costs;
+        auto measure = [&costs](const char *name, int samplesPerCall, const std::function<void()> &call)
+        {
+            auto best = std::numeric_limits<double>::max();
+            for (auto round = 0; round < 5; ++round)
+            {
+                juce::int64 calls = 0;
+                auto start = juce::Time::getHighResolutionTicks();
+                auto elapsed = 0.0;
+                do
+                {
+                    call();
+                    ++calls;
+                    elapsed = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start);
+                } while (elapsed < 0.02);
+                best = juce::jmin(best, elapsed * 1.0e9 / (double)(calls * samplesPerCall));
+            }
+            costs.push_back({name, best});
+        };
+
+        measure("hermite resample", blockSize, [&]
+             { set.hermiteResample(source.data() + 1, output.data(), blockSize, 0.25, 1.37); });
+        measure("complex mac", blockSize + 1, [&]
+             { set.complexMultiplyAccumulate(accumulator.data(), spectrumA.data(), spectrumB.data(), blockSize + 1); });
+        measure("dot product", blockSize, [&]
+             { output[0] = set.dotProduct(source.data(), source.data() + blockSize, blockSize); });
+        measure("resonator bank", blockSize, [&]
+             { set.resonatorBank(re, im, a, b, gain, source.data(), output.data(), blockSize); });
+        measure("mix stereo", blockSize, [&]
+             {
+                 const float *src[] = {source.data(), source.data() + blockSize};
+                 set.addTo(stereo, 0, src, 2, blockSize, 0.25f, 0.75f);
+             });
+
+        timeVoice<SineWaveVoice, SineWaveSound>("sine voice", sampleRate, blockSize, measure);
+        timeVoice<PluckedStringVoice, PluckedStringSound>("plucked string voice", sampleRate, blockSize, measure);
+        timeVoice<ModalPianoVoice, ModalPianoSound>("modal piano voice", sampleRate, blockSize, measure);
+
+        // A 2 s decaying noise tail, stereo, with the tail partitions counted in.
+        juce::AudioSampleBuffer ir(2, (int)(2.0 * sampleRate));
+        for (auto ch = 0; ch < 2; ++ch)
+            for (auto i = 0; i < ir.getNumSamples(); ++i)
+                ir.setSample(ch, i, (random.nextFloat() * 2.0f - 1.0f) * std::exp(-3.0f * (float)i / ir.getNumSamples()));
+        ConvolutionReverb reverb;
+        reverb.setImpulseResponse(ir);
+        reverb.setNonRealtime(true);
+        reverb.prepare(blockSize, 2);
+        measure("convolution reverb", blockSize, [&]
+             { reverb.process(stereo, 0, blockSize); });
+
+        return costs;
+    }
+
+    static juce::String getCaseName(const Script &script, double sampleRate, int blockSize)
+    {
+        return juce::String(script.name) + " " + juce::String((int)sampleRate) + "/" + juce::String(blockSize);
+    }
+
+    // Renders every case and compares it with its golden file, a line per
+    // case to out. Returns the number of failed cases; a missing golden file
+    // is a failure.
+    static int checkGoldens(const juce::File &directory, std::ostream &out)
+    {
+        auto failures = 0;
+        out << "case                  snr dB  onsets  onset ms  pitch cents  result" << std::endl;
+        for (auto &script : getScripts())
+        {
+            for (auto sampleRate : getSampleRates())
+            {
+                for (auto blockSize : getBlockSizes())
+                {
+                    auto name = getCaseName(script, sampleRate, blockSize).paddedRight(' ', 20);
+                    juce::AudioSampleBuffer golden;
+                    if (!readGolden(getGoldenFile(directory, script, sampleRate, blockSize), golden))
+                    {
+                        out << name << "  no golden file" << std::endl;
+                        ++failures;
+                        continue;
+                    }
+
+                    auto result = check(script, sampleRate, blockSize, render(script, sampleRate, blockSize), golden);
+                    failures += result.passed ? 0 : 1;
+                    out << name << juce::String(result.snrDb, 1).paddedLeft(' ', 8)
+                        << (juce::String(result.onsets) + "/" + juce::String(result.goldenOnsets)).paddedLeft(' ', 8)
+                        << juce::String(result.worstOnsetMs, 3).paddedLeft(' ', 10)
+                        << (script.checkPitch ? juce::String(result.worstPitchCents, 3) : juce::String("-")).paddedLeft(' ', 13)
+                        << "  " << (result.passed ? juce::String("ok") : result.problem) << std::endl;
+                }
+            }
+        }
+        return failures;
+    }
+
+    // Renders every case over its golden file. Returns false if one could
+    // not be written.
+    static bool updateGoldens(const juce::File &directory, std::ostream &out)
+    {
+        for (auto &script : getScripts())
+        {
+            for (auto sampleRate : getSampleRates())
+            {
+                for (auto blockSize : getBlockSizes())
+                {
+                    auto file = getGoldenFile(directory, script, sampleRate, blockSize);
+                    if (!writeGolden(file, render(script, sampleRate, blockSize), sampleRate))
+                    {
+                        out << "could not write " << file.getFullPathName() << std::endl;
+                        return false;
+                    }
+                    out << "wrote " << file.getFileName() << std::endl;
+                }
+            }
+        }
+        return true;
+    }
+
+    // Measures every kernel against budgets.xml, a line per kernel to out.
+    // Returns the number over budget or without one.
+    static int checkBudgets(const juce::File &directory, std::ostream &out)
+    {
+        Budgets budgets;
+        budgets.load(Budgets::getFile(directory));
+
+        auto failures = 0;
+        out << "kernel                 ns/sample    budget  result" << std::endl;
+        for (auto &cost : measureKernelCosts())
+        {
+            auto budget = budgets.get(cost.name);
+            auto passed = budget >= 0.0 && cost.nsPerSample <= budget;
+            failures += passed ? 0 : 1;
+            out << cost.name.paddedRight(' ', 21) << juce::String(cost.nsPerSample, 2).paddedLeft(' ', 11)
+                << (budget >= 0.0 ? juce::String(budget, 1) : juce::String("none")).paddedLeft(' ', 10)
+                << "  " << (passed ? "ok" : budget < 0.0 ? "no budget in budgets.xml" : "over budget") << std::endl;
+        }
+        return failures;
+    }
+
+private:
+    // One voice holding middle C, restarted whenever it has decayed.
+    template <typename Voice, typename Sound, typename Measure>
+    static void timeVoice(const char *name, double sampleRate, int blockSize, Measure &measure)
+    {
+        juce::Synthesiser synth;
+        synth.addVoice(new Voice());
+        synth.addSound(new Sound());
+        synth.setCurrentPlaybackSampleRate(sampleRate);
+
+        juce::AudioSampleBuffer buffer(2, blockSize);
+        juce::MidiBuffer none, noteOn;
+        noteOn.addEvent(juce::MidiMessage::noteOn(1, 60, (juce::uint8)100), 0);
+        measure(name, blockSize, [&]
+             {
+                 buffer.clear();
+                 synth.renderNextBlock(buffer, synth.getVoice(0)->isVoiceActive() ? none : noteOn, 0, blockSize);
+             });
+    }
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "HeadlessCommand.h"
+#include "RegressionSuite.h"
+
+// Headless mode for RegressionSuite: the golden-reference run.
+class RegressionSuiteCommands : private HeadlessCommand
+{
+public:
+    static void addTo(juce::ConsoleApplication &app)
+    {
+        app.addCommand({"--regress",
+                        "--regress [--golden=<directory>] [--no-budgets]",
+                        "Renders fixed quiz scripts offline and checks them against golden WAVs and CPU budgets.",
+                        "Each script is rendered at every sample rate and block size and compared by SNR, onset times and pitch. "
+                        "Nothing is written. Defaults to ./Regression.",
+                        [](const juce::ArgumentList &a) { regress(a); }});
+        app.addCommand({"--regress-update",
+                        "--regress-update [--golden=<directory>]",
+                        "Re-renders the golden WAVs for --regress.",
+                        "Review the new files before committing them. CPU budgets are edited by hand in budgets.xml.",
+                        [](const juce::ArgumentList &a) { regressUpdate(a); }});
+    }
+
+private:
+    static juce::File getDirectory(const juce::ArgumentList &args)
+    {
+        return args.containsOption("--golden") ? juce::File::getCurrentWorkingDirectory().getChildFile(args.getValueForOption("--golden"))
+                                               : RegressionSuite::getDefaultDirectory();
+    }
+
+    static void regress(const juce::ArgumentList &args)
+    {
+        auto directory = getDirectory(args);
+        auto failures = RegressionSuite::checkGoldens(directory, std::cout);
+        if (!args.containsOption("--no-budgets"))
+        {
+            std::cout << std::endl;
+            failures += RegressionSuite::checkBudgets(directory, std::cout);
+        }
+
+        if (failures > 0)
+            juce::ConsoleApplication::fail(juce::String(failures) + " regression check(s) failed");
+    }
+
+    static void regressUpdate(const juce::ArgumentList &args)
+    {
+        if (!RegressionSuite::updateGoldens(getDirectory(args), std::cout))
+            juce::ConsoleApplication::fail("Could not update the golden files");
+    }
+};
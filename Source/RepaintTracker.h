@@ -0,0 +1,136 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <map>
+
+// Debug counters of paint calls. A component opts in with a ScopedPaint
+// at the top of its paint(), or by being declared as Tracked<Type>; the
+// overlay shows paints per second and the average and worst paint time.
+// Counting only happens while the overlay is showing. Message thread only.
+class RepaintTracker
+{
+public:
+    static RepaintTracker &getInstance()
+    {
+        static RepaintTracker instance;
+        return instance;
+    }
+
+    void setEnabled(bool shouldTrack)
+    {
+        enabled = shouldTrack;
+        stats.clear();
+    }
+
+    bool isEnabled() const { return enabled; }
+
+    struct ScopedPaint
+    {
+        explicit ScopedPaint(const char *componentName)
+            : name(componentName), start(getInstance().isEnabled() ? juce::Time::getHighResolutionTicks() : 0)
+        {
+        }
+
+        ~ScopedPaint()
+        {
+            if (start != 0)
+                getInstance().record(name, juce::Time::getHighResolutionTicks() - start);
+        }
+
+        const char *name;
+        juce::int64 start;
+    };
+
+    // Wraps a stock component so its paints are counted too.
+    template <typename ComponentType>
+    struct Tracked : public ComponentType
+    {
+        using ComponentType::ComponentType;
+
+        void paint(juce::Graphics &g) override
+        {
+            ScopedPaint tracked(trackedName);
+            ComponentType::paint(g);
+        }
+
+        const char *trackedName = "component";
+    };
+
+    // One line per component since the last call, then starts a new interval.
+    juce::StringArray takeReport(double seconds)
+    {
+        juce::StringArray lines;
+        for (auto &s : stats)
+        {
+            auto average = s.second.paints > 0 ? s.second.totalMs / s.second.paints : 0.0;
+            lines.add(juce::String(s.first).paddedRight(' ', 14) + juce::String(s.second.paints / seconds, 1).paddedLeft(' ', 6)
+                      + "/s " + juce::String(average, 2).paddedLeft(' ', 6) + " ms avg "
+                      + juce::String(s.second.worstMs, 2).paddedLeft(' ', 6) + " ms max");
+            s.second = {};
+        }
+        return lines;
+    }
+
+private:
+    struct Stats
+    {
+        int paints = 0;
+        double totalMs = 0.0, worstMs = 0.0;
+    };
+
+    void record(const char *name, juce::int64 ticks)
+    {
+        auto ms = juce::Time::highResolutionTicksToSeconds(ticks) * 1000.0;
+        auto &s = stats[name];
+        ++s.paints;
+        s.totalMs += ms;
+        s.worstMs = juce::jmax(s.worstMs, ms);
+    }
+
+    bool enabled = false;
+    std::map<juce::String, Stats> stats;
+};
+
+// Small opaque panel listing the tracker's figures twice a second.
+class RepaintOverlay : public juce::Component,
+                       private juce::Timer
+{
+public:
+    RepaintOverlay()
+    {
+        setOpaque(true);
+        setInterceptsMouseClicks(false, false);
+    }
+
+    void setShowing(bool shouldShow)
+    {
+        RepaintTracker::getInstance().setEnabled(shouldShow);
+        setVisible(shouldShow);
+        lines.clear();
+        if (shouldShow)
+            startTimer(500);
+        else
+            stopTimer();
+    }
+
+    void paint(juce::Graphics &g) override
+    {
+        g.fillAll(juce::Colours::black);
+        g.setColour(juce::Colours::lightgreen);
+        g.setFont(juce::Font(juce::Font::getDefaultMonospacedFontName(), 12.0f, juce::Font::plain));
+
+        auto area = getLocalBounds().reduced(4);
+        g.drawText("paints  (Ctrl+Shift+R hides)", area.removeFromTop(15), juce::Justification::centredLeft);
+        for (auto &line : lines)
+            g.drawText(line, area.removeFromTop(15), juce::Justification::centredLeft);
+    }
+
+private:
+    void timerCallback() override
+    {
+        lines = RepaintTracker::getInstance().takeReport(0.5);
+        repaint();
+    }
+
+    juce::StringArray lines;
+};
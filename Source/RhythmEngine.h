@@ -0,0 +1,441 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+// One bar of 4/4 built from common one-beat cells. Onsets are in beats from
+// the start of the bar.
+struct RhythmPattern
+{
+    static constexpr int beatsPerBar = 4;
+    static constexpr int maxOnsets = 16;
+
+    int numOnsets = 0;
+    double onsets[maxOnsets] = {};
+
+    static RhythmPattern generate(juce::Random &random)
+    {
+        static const double cells[][5] = {{0.0, -1.0},
+                                          {0.0, 0.5, -1.0},
+                                          {0.5, -1.0},
+                                          {0.0, 0.75, -1.0},
+                                          {0.0, 0.5, 0.75, -1.0},
+                                          {0.0, 0.25, 0.5, -1.0},
+                                          {0.0, 0.25, 0.5, 0.75, -1.0}};
+
+        RhythmPattern pattern;
+        for (auto beat = 0; beat < beatsPerBar; ++beat)
+        {
+            // Always start on the downbeat so the bar is unambiguous.
+            auto *cell = cells[beat == 0 ? 0 : random.nextInt((int)juce::numElementsInArray(cells))];
+            for (auto i = 0; cell[i] >= 0.0; ++i)
+                pattern.onsets[pattern.numOnsets++] = beat + cell[i];
+        }
+        return pattern;
+    }
+};
+
+// Relates the audio sample clock to Time::getMillisecondCounterHiRes() with a
+// second-order delay-locked loop driven by the audio callbacks, so events
+// timestamped on other threads can be placed on the sample timeline.
+class SampleClock
+{
+public:
+    void reset(double newSampleRate)
+    {
+        sampleRate = newSampleRate;
+        lastNumSamples = 0;
+        jitterSumSquares = 0.0;
+        jitterMax = 0.0;
+        numUpdates = 0;
+    }
+
+    // Audio thread, once per callback before any rendering.
+    void update(juce::int64 blockStart, int numSamples, double now)
+    {
+        if (numSamples != lastNumSamples)
+        {
+            // (Re)start the loop; a change of block size changes its period.
+            auto period = numSamples / sampleRate;
+            auto omega = 2.0 * juce::MathConstants<double>::pi * loopBandwidthHz * period;
+            b = std::sqrt(2.0) * omega;
+            c = omega * omega;
+            t0 = now;
+            t1 = now + period;
+            e2 = period;
+            lastNumSamples = numSamples;
+        }
+        else
+        {
+            auto e = now - t1;
+            t0 = t1;
+            t1 += b * e + e2;
+            e2 += c * e;
+
+            jitterSumSquares = jitterSumSquares + e * e;
+            jitterMax = juce::jmax(jitterMax.load(), std::abs(e));
+            ++numUpdates;
+        }
+
+        sequence.fetch_add(1, std::memory_order_acq_rel);
+        publishedStart.store(blockStart, std::memory_order_relaxed);
+        publishedTime.store(t0, std::memory_order_relaxed);
+        publishedSamplesPerSecond.store(numSamples / (t1 - t0), std::memory_order_relaxed);
+        sequence.fetch_add(1, std::memory_order_release);
+    }
+
+    // Any thread: the (fractional) sample the clock was at at this time.
+    double sampleAt(double timeSeconds) const
+    {
+        for (;;)
+        {
+            auto before = sequence.load(std::memory_order_acquire);
+            auto start = publishedStart.load(std::memory_order_relaxed);
+            auto time = publishedTime.load(std::memory_order_relaxed);
+            auto rate = publishedSamplesPerSecond.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if ((before & 1) == 0 && before == sequence.load(std::memory_order_relaxed))
+                return (double)start + (timeSeconds - time) * rate;
+        }
+    }
+
+    // Deviation of callback arrival times from the filtered clock.
+    double getJitterRmsSeconds() const
+    {
+        auto n = numUpdates.load();
+        return n > 0 ? std::sqrt(jitterSumSquares.load() / (double)n) : 0.0;
+    }
+
+    double getJitterMaxSeconds() const { return jitterMax.load(); }
+    juce::int64 getNumUpdates() const { return numUpdates.load(); }
+
+private:
+    static constexpr double loopBandwidthHz = 1.0;
+
+    double sampleRate = 44100.0;
+    int lastNumSamples = 0;
+    double b = 0.0, c = 0.0, t0 = 0.0, t1 = 0.0, e2 = 0.0;
+
+    std::atomic<juce::uint32> sequence{0};
+    std::atomic<juce::int64> publishedStart{0};
+    std::atomic<double> publishedTime{0.0}, publishedSamplesPerSecond{44100.0};
+    std::atomic<double> jitterSumSquares{0.0}, jitterMax{0.0};
+    std::atomic<juce::int64> numUpdates{0};
+};
+
+// Rhythm dictation on the audio sample clock. A take is a count-in bar of
+// clicks, a bar where the pattern plays, and a bar where the user taps it
+// back. Clicks and pattern notes land on exact sample positions; taps from
+// MIDI input or the on-screen keyboard are mapped back onto the same clock
+// and shifted by the device latency before they are graded.
+class RhythmEngine : public juce::MidiInputCallback
+{
+public:
+    struct TakeResult
+    {
+        int numExpected = 0, numTaps = 0;
+        double meanErrorMs = 0.0, spreadMs = 0.0, worstErrorMs = 0.0;
+        bool passed = false;
+    };
+
+    struct TimingReport
+    {
+        double callbackJitterRmsUs = 0.0, callbackJitterMaxUs = 0.0;
+        double eventPlacementMaxUs = 0.0;
+        double latencyCompensationMs = 0.0;
+        juce::int64 numCallbacks = 0;
+    };
+
+    static constexpr double toleranceMs = 40.0;
+
+    RhythmEngine()
+    {
+        taps.reserve(maxTaps);
+    }
+
+    void prepare(double newSampleRate)
+    {
+        sampleRate = newSampleRate;
+        clock.reset(sampleRate);
+        nextBlockStart = 0;
+        state = idle;
+    }
+
+    void setTempo(double bpm) { tempo = juce::jlimit(30.0, 240.0, bpm); }
+    double getTempo() const { return tempo; }
+
+    // Output latency plus one buffer, in samples.
+    void setLatencyCompensation(int samples) { latencyCompensation = samples; }
+    int getLatencyCompensation() const { return latencyCompensation.load(); }
+
+    // Delay from a key press to its MIDI timestamp, taken off MIDI taps.
+    void setMidiInputLatencyMs(double ms) { midiInputLatency = ms * 0.001; }
+
+    // Message thread: queues a take to start with the next audio block.
+    bool start(const RhythmPattern &pattern, int noteNumber)
+    {
+        if (state.load() != idle)
+            return false;
+
+        pendingPattern = pattern;
+        patternNote = noteNumber;
+        {
+            const juce::SpinLock::ScopedLockType sl(tapLock);
+            taps.clear();
+        }
+        state.store(pending, std::memory_order_release);
+        return true;
+    }
+
+    bool isIdle() const { return state.load() == idle; }
+    bool isFinished() const { return state.load() == finished; }
+
+    // Message thread: grades a finished take and returns the engine to idle.
+    bool takeFinished(TakeResult &result)
+    {
+        if (state.load(std::memory_order_acquire) != finished)
+            return false;
+
+        result = grade();
+        state = idle;
+        return true;
+    }
+
+    // Any thread: a tap at a Time::getMillisecondCounterHiRes() time in seconds.
+    void tapAt(double timeSeconds)
+    {
+        auto s = state.load(std::memory_order_acquire);
+        if (s != running && s != finished)
+            return;
+
+        auto sample = clock.sampleAt(timeSeconds) - latencyCompensation.load() - (double)takeStart.load();
+        const juce::SpinLock::ScopedLockType sl(tapLock);
+        if (taps.size() < maxTaps)
+            taps.push_back(sample);
+    }
+
+    void handleIncomingMidiMessage(juce::MidiInput *, const juce::MidiMessage &message) override
+    {
+        if (message.isNoteOn())
+            tapAt(message.getTimeStamp() - midiInputLatency.load());
+    }
+
+    // Audio thread, first thing in each callback.
+    void beginBlock(int numSamples)
+    {
+        blockStart = nextBlockStart;
+        nextBlockStart += numSamples;
+        clock.update(blockStart, numSamples, juce::Time::getMillisecondCounterHiRes() * 0.001);
+    }
+
+    // Audio thread: adds the pattern's notes that fall in this block.
+    void addPatternNotes(juce::MidiBuffer &midi, int startSample, int numSamples)
+    {
+        if (state.load(std::memory_order_acquire) == pending)
+            scheduleTake();
+
+        if (state.load() != running)
+            return;
+
+        auto end = blockStart + numSamples;
+        for (; nextNote < numNoteEvents && takeStart + noteEvents[nextNote].sample < end; ++nextNote)
+        {
+            auto &e = noteEvents[nextNote];
+            auto offset = startSample + (int)juce::jmax((juce::int64)0, takeStart + e.sample - blockStart);
+            midi.addEvent(e.isNoteOn ? juce::MidiMessage::noteOn(1, patternNote, (juce::uint8)100)
+                                     : juce::MidiMessage::noteOff(1, patternNote),
+                          offset);
+        }
+    }
+
+    // Audio thread: mixes the click track into the output and ends the take
+    // once the answer bar has passed.
+    void renderClicks(juce::AudioSampleBuffer &buffer, int startSample, int numSamples)
+    {
+        if (state.load() != running)
+            return;
+
+        auto end = blockStart + numSamples;
+        for (auto pos = blockStart; pos < end;)
+        {
+            auto next = nextClick < numClicks ? juce::jmax(pos, takeStart + clickSamples[nextClick]) : end;
+            next = juce::jmin(next, end);
+            click.render(buffer, startSample + (int)(pos - blockStart), (int)(next - pos));
+            pos = next;
+
+            if (pos < end)
+            {
+                auto accent = nextClick % RhythmPattern::beatsPerBar == 0;
+                click.trigger(sampleRate, accent ? 1760.0 : 880.0, accent ? 0.5f : 0.3f);
+                ++nextClick;
+            }
+        }
+
+        if (end >= takeStart + takeLength)
+            state.store(finished, std::memory_order_release);
+    }
+
+    juce::int64 getBlockStartSample() const { return blockStart; }
+    const SampleClock &getClock() const { return clock; }
+
+    TimingReport getTimingReport() const
+    {
+        TimingReport report;
+        report.callbackJitterRmsUs = clock.getJitterRmsSeconds() * 1.0e6;
+        report.callbackJitterMaxUs = clock.getJitterMaxSeconds() * 1.0e6;
+        report.eventPlacementMaxUs = placementError * 1.0e6;
+        report.latencyCompensationMs = latencyCompensation.load() * 1000.0 / sampleRate;
+        report.numCallbacks = clock.getNumUpdates();
+        return report;
+    }
+
+private:
+    enum State
+    {
+        idle,
+        pending,
+        running,
+        finished
+    };
+
+    struct NoteEvent
+    {
+        juce::int64 sample;
+        bool isNoteOn;
+    };
+
+    class Click
+    {
+    public:
+        void trigger(double sampleRate, double frequency, float gain)
+        {
+            phase = 0.0;
+            delta = 2.0 * juce::MathConstants<double>::pi * frequency / sampleRate;
+            level = gain;
+            decay = (float)std::exp(-1.0 / (0.008 * sampleRate));
+            remaining = juce::roundToInt(0.04 * sampleRate);
+        }
+
+        void render(juce::AudioSampleBuffer &buffer, int startSample, int numSamples)
+        {
+            auto n = juce::jmin(numSamples, remaining);
+            for (auto i = 0; i < n; ++i)
+            {
+                auto sample = level * (float)std::sin(phase);
+                for (auto ch = 0; ch < buffer.getNumChannels(); ++ch)
+                    buffer.addSample(ch, startSample + i, sample);
+                phase += delta;
+                level *= decay;
+            }
+            remaining -= n;
+        }
+
+    private:
+        double phase = 0.0, delta = 0.0;
+        float level = 0.0f, decay = 0.0f;
+        int remaining = 0;
+    };
+
+    static constexpr int numBars = 3;
+    static constexpr int numClicks = numBars * RhythmPattern::beatsPerBar;
+    static constexpr size_t maxTaps = 64;
+
+    juce::int64 beatToSample(double beat)
+    {
+        auto exact = beat * 60.0 / tempo * sampleRate;
+        auto rounded = (juce::int64)std::llround(exact);
+        placementError = juce::jmax(placementError.load(), std::abs((double)rounded - exact) / sampleRate);
+        return rounded;
+    }
+
+    void scheduleTake()
+    {
+        const auto &pattern = pendingPattern;
+        const auto beats = RhythmPattern::beatsPerBar;
+
+        for (auto i = 0; i < numClicks; ++i)
+            clickSamples[i] = beatToSample(i);
+
+        numNoteEvents = 0;
+        for (auto i = 0; i < pattern.numOnsets; ++i)
+        {
+            auto next = i + 1 < pattern.numOnsets ? pattern.onsets[i + 1] : (double)beats;
+            auto length = juce::jmin(0.2, next - pattern.onsets[i]);
+            noteEvents[numNoteEvents++] = {beatToSample(beats + pattern.onsets[i]), true};
+            noteEvents[numNoteEvents++] = {beatToSample(beats + pattern.onsets[i] + length), false};
+        }
+
+        // Answer bar follows the pattern bar; allow half a beat for late taps.
+        for (auto i = 0; i < pattern.numOnsets; ++i)
+            expected[i] = (double)beatToSample(2 * beats + pattern.onsets[i]);
+        numExpected = pattern.numOnsets;
+        answerStart = (double)beatToSample(2 * beats - 0.5);
+        takeLength = beatToSample(3 * beats + 0.5);
+
+        nextNote = nextClick = 0;
+        takeStart = blockStart;
+        state.store(running, std::memory_order_release);
+    }
+
+    TakeResult grade()
+    {
+        std::vector<double> answer;
+        {
+            const juce::SpinLock::ScopedLockType sl(tapLock);
+            for (auto t : taps)
+                if (t >= answerStart && t < (double)takeLength)
+                    answer.push_back(t);
+        }
+        std::sort(answer.begin(), answer.end());
+
+        TakeResult result;
+        result.numExpected = numExpected;
+        result.numTaps = (int)answer.size();
+
+        // Each tap is scored against its nearest expected onset.
+        double sum = 0.0, sumSquares = 0.0;
+        for (auto t : answer)
+        {
+            auto error = 1.0e9;
+            for (auto i = 0; i < numExpected; ++i)
+                if (std::abs(t - expected[i]) < std::abs(error))
+                    error = t - expected[i];
+
+            auto ms = error * 1000.0 / sampleRate;
+            sum += ms;
+            sumSquares += ms * ms;
+            if (std::abs(ms) > std::abs(result.worstErrorMs))
+                result.worstErrorMs = ms;
+        }
+
+        if (!answer.empty())
+        {
+            result.meanErrorMs = sum / answer.size();
+            result.spreadMs = std::sqrt(juce::jmax(0.0, sumSquares / answer.size() - result.meanErrorMs * result.meanErrorMs));
+        }
+        result.passed = result.numTaps == numExpected && std::abs(result.worstErrorMs) <= toleranceMs;
+        return result;
+    }
+
+    double sampleRate = 44100.0, tempo = 90.0;
+    std::atomic<int> latencyCompensation{0};
+    std::atomic<double> midiInputLatency{0.0};
+    SampleClock clock;
+    juce::int64 blockStart = 0, nextBlockStart = 0;
+    std::atomic<int> state{idle};
+
+    RhythmPattern pendingPattern;
+    int patternNote = 60;
+    std::atomic<juce::int64> takeStart{0};
+    juce::int64 takeLength = 0;
+    juce::int64 clickSamples[numClicks] = {};
+    NoteEvent noteEvents[2 * RhythmPattern::maxOnsets] = {};
+    int numNoteEvents = 0, nextNote = 0, nextClick = 0;
+    double expected[RhythmPattern::maxOnsets] = {};
+    int numExpected = 0;
+    double answerStart = 0.0;
+    std::atomic<double> placementError{0.0};
+    Click click;
+
+    juce::SpinLock tapLock;
+    std::vector<double> taps;
+};
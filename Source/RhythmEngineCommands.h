@@ -0,0 +1,108 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <thread>
+#include <vector>
+#include "HeadlessCommand.h"
+#include "RhythmEngine.h"
+
+// Headless mode for RhythmEngine: timing accuracy against a paced callback.
+class RhythmEngineCommands : private HeadlessCommand
+{
+public:
+    static void addTo(juce::ConsoleApplication &app)
+    {
+        app.addCommand({"--rhythm-jitter",
+                        "--rhythm-jitter [--seconds=N] [--block=N] [--rate=N]",
+                        "Drives the rhythm engine from a paced callback thread and reports timing accuracy.",
+                        "Measures callback jitter, note placement on the sample clock and the error of tap timestamps mapped onto it.",
+                        [](const juce::ArgumentList &a) { rhythmJitter(a); }});
+    }
+
+private:
+    static void rhythmJitter(const juce::ArgumentList &args)
+    {
+        auto seconds = juce::jmax(2, getIntOption(args, "--seconds", 20));
+        auto blockSize = juce::jmax(16, getIntOption(args, "--block", 256));
+        auto sampleRate = (double)juce::jmax(8000, getIntOption(args, "--rate", 48000));
+
+        RhythmEngine engine;
+        engine.prepare(sampleRate);
+        juce::Random random(1);
+        auto pattern = RhythmPattern::generate(random);
+
+        // The simulated device's sample clock is exactly wall-clock time from
+        // start; only the callback wake-ups are subject to scheduling jitter.
+        auto start = juce::Time::getMillisecondCounterHiRes() * 0.001;
+        auto numBlocks = (int)(seconds * sampleRate / blockSize);
+        std::atomic<bool> running{true};
+        std::vector<juce::int64> noteOnSamples;
+        juce::int64 takeStart = -1;
+
+        std::thread audio([&]
+                          {
+                              juce::MidiBuffer midi;
+                              juce::AudioSampleBuffer buffer(2, blockSize);
+                              for (auto block = 0; block < numBlocks; ++block)
+                              {
+                                  auto due = start + block * blockSize / sampleRate;
+                                  while (juce::Time::getMillisecondCounterHiRes() * 0.001 < due)
+                                      juce::Thread::sleep(0);
+
+                                  engine.beginBlock(blockSize);
+                                  if (block == numBlocks / 2)
+                                  {
+                                      engine.start(pattern, 60);
+                                      takeStart = engine.getBlockStartSample();
+                                  }
+
+                                  midi.clear();
+                                  buffer.clear();
+                                  engine.addPatternNotes(midi, 0, blockSize);
+                                  engine.renderClicks(buffer, 0, blockSize);
+                                  for (const auto metadata : midi)
+                                      if (metadata.getMessage().isNoteOn())
+                                          noteOnSamples.push_back(engine.getBlockStartSample() + metadata.samplePosition);
+                              }
+                              running = false;
+                          });
+
+        // Taps arrive on another thread at random times; compare where the
+        // clock places them against where they really fell.
+        juce::Array<double> errors;
+        juce::Thread::sleep(1000);
+        while (running)
+        {
+            juce::Thread::sleep(5 + random.nextInt(40));
+            auto now = juce::Time::getMillisecondCounterHiRes() * 0.001;
+            errors.add((engine.getClock().sampleAt(now) - (now - start) * sampleRate) / sampleRate * 1.0e6);
+        }
+        audio.join();
+
+        auto placementErrors = 0;
+        auto beatLength = 60.0 / engine.getTempo() * sampleRate;
+        for (auto i = 0; i < juce::jmin((int)noteOnSamples.size(), pattern.numOnsets); ++i)
+            if (noteOnSamples[(size_t)i] - takeStart != std::llround((RhythmPattern::beatsPerBar + pattern.onsets[i]) * beatLength))
+                ++placementErrors;
+
+        double mean = 0.0, maxError = 0.0;
+        for (auto e : errors)
+            mean += e / errors.size();
+        double variance = 0.0;
+        for (auto e : errors)
+        {
+            variance += (e - mean) * (e - mean) / errors.size();
+            maxError = juce::jmax(maxError, std::abs(e - mean));
+        }
+
+        auto report = engine.getTimingReport();
+        std::cout << "callbacks " << report.numCallbacks << " of " << blockSize << " samples at " << sampleRate << " Hz" << std::endl;
+        std::cout << "callback jitter      " << juce::String(report.callbackJitterRmsUs, 1) << " us rms, "
+                  << juce::String(report.callbackJitterMaxUs, 1) << " us max" << std::endl;
+        std::cout << "note placement       " << (int)noteOnSamples.size() << " notes, " << placementErrors
+                  << " off their sample, rounding " << juce::String(report.eventPlacementMaxUs, 2) << " us max" << std::endl;
+        std::cout << "tap timestamp error  " << errors.size() << " taps, offset " << juce::String(mean, 1)
+                  << " us, " << juce::String(std::sqrt(variance), 1) << " us rms, " << juce::String(maxError, 1)
+                  << " us max around offset" << std::endl;
+    }
+};
@@ -0,0 +1,470 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "DspKernels.h"
+#include "RealtimeThreads.h"
+
+// One recorded note at one velocity layer. Only the first headSeconds of the
+// file stay resident (memory-mapped for WAV/AIFF, decoded otherwise); the
+// rest is streamed from disk by SampleStreamer while the note plays.
+class SampleZone
+{
+public:
+    SampleZone(const juce::File &f, int root, int lowVel, int highVel)
+        : file(f), rootNote(root), lowVelocity(lowVel), highVelocity(highVel)
+    {
+    }
+
+    bool load(juce::AudioFormatManager &formats, double headSeconds)
+    {
+        std::unique_ptr<juce::AudioFormatReader> reader(formats.createReaderFor(file));
+        if (reader == nullptr)
+            return false;
+
+        sampleRate = reader->sampleRate;
+        numChannels = juce::jmin(2, (int)reader->numChannels);
+        lengthInFrames = reader->lengthInSamples;
+        headFrames = juce::jmin(lengthInFrames, (juce::int64)(headSeconds * sampleRate));
+
+        auto extension = file.getFileExtension().toLowerCase();
+        if (extension == ".wav")
+            mapped.reset(juce::WavAudioFormat().createMemoryMappedReader(file));
+        else if (extension == ".aif" || extension == ".aiff")
+            mapped.reset(juce::AiffAudioFormat().createMemoryMappedReader(file));
+
+        if (mapped != nullptr && mapped->mapSectionOfFile({0, headFrames}))
+        {
+            // Fault the head in now rather than on the audio thread.
+            for (juce::int64 i = 0; i < headFrames; i += 512)
+                mapped->touchSample(i);
+            return true;
+        }
+
+        mapped.reset();
+        headBuffer.setSize(numChannels, (int)headFrames);
+        reader->read(&headBuffer, 0, (int)headFrames, 0, true, numChannels > 1);
+        return true;
+    }
+
+    // Real-time safe: reads from the resident head only.
+    void readHead(float *const *dest, juce::int64 start, int numFrames) const
+    {
+        if (mapped != nullptr)
+        {
+            mapped->read(dest, numChannels, start, numFrames);
+        }
+        else
+        {
+            for (auto ch = 0; ch < numChannels; ++ch)
+                juce::FloatVectorOperations::copy(dest[ch], headBuffer.getReadPointer(ch, (int)start), numFrames);
+        }
+
+        if (numChannels == 1)
+            juce::FloatVectorOperations::copy(dest[1], dest[0], numFrames);
+    }
+
+    size_t getResidentBytes() const
+    {
+        return mapped != nullptr ? mapped->getNumBytesUsed()
+                                 : (size_t)headBuffer.getNumSamples() * (size_t)numChannels * sizeof(float);
+    }
+
+    const juce::File file;
+    const int rootNote, lowVelocity, highVelocity;
+    double sampleRate = 44100.0;
+    int numChannels = 1;
+    juce::int64 lengthInFrames = 0, headFrames = 0;
+
+private:
+    std::unique_ptr<juce::MemoryMappedAudioFormatReader> mapped;
+    juce::AudioSampleBuffer headBuffer;
+};
+
+// Per-voice double buffer for the streamed part of a sample. The voice
+// (audio thread) requests a half by bumping its ticket; the streamer fills it
+// and publishes the same ticket. A half is readable only while both match,
+// so neither side ever blocks on the other.
+struct SampleStream
+{
+    static constexpr int chunkFrames = 16384;
+
+    struct Half
+    {
+        juce::AudioSampleBuffer data{2, chunkFrames};
+        std::atomic<const SampleZone *> zone{nullptr};
+        std::atomic<juce::int64> start{0};
+        std::atomic<juce::uint32> requested{0}, completed{0};
+        int numValid = 0;
+
+        void request(const SampleZone *z, juce::int64 frame)
+        {
+            zone = z;
+            start = frame;
+            requested.fetch_add(1, std::memory_order_release);
+        }
+
+        bool isReady() const
+        {
+            return completed.load(std::memory_order_acquire) == requested.load(std::memory_order_acquire);
+        }
+    };
+
+    Half halves[2];
+};
+
+// Background reader thread shared by all sampled voices. It sleeps until a
+// voice that has queued a request calls notify().
+class SampleStreamer : public juce::Thread
+{
+public:
+    explicit SampleStreamer(juce::AudioFormatManager &f)
+        : juce::Thread("Sample streamer"), formats(f)
+    {
+    }
+
+    ~SampleStreamer() override
+    {
+        stopThread(2000);
+    }
+
+    void addStream(SampleStream *stream)
+    {
+        const juce::ScopedLock sl(streamLock);
+        streams.add(stream);
+    }
+
+    // Artificial per-read delay, used to stress the underrun handling.
+    void setSimulatedReadDelay(int ms) { simulatedReadDelayMs = ms; }
+
+    void run() override
+    {
+        RealtimeThreads::getInstance().enterRealtime(RealtimeThreads::Role::streamer, 0);
+        while (!threadShouldExit())
+        {
+            auto didWork = false;
+            {
+                const juce::ScopedLock sl(streamLock);
+                for (auto *stream : streams)
+                    for (auto &half : stream->halves)
+                        didWork |= fill(half);
+            }
+
+            if (!didWork)
+                wait(-1);
+        }
+    }
+
+private:
+    bool fill(SampleStream::Half &half)
+    {
+        auto ticket = half.requested.load(std::memory_order_acquire);
+        if (ticket == half.completed.load(std::memory_order_relaxed))
+            return false;
+
+        auto *zone = half.zone.load();
+        auto start = half.start.load();
+        if (zone == nullptr || ticket != half.requested.load(std::memory_order_acquire))
+            return true;
+
+        auto *reader = getReader(*zone);
+        auto numFrames = (int)juce::jlimit((juce::int64)0, (juce::int64)SampleStream::chunkFrames, zone->lengthInFrames - start);
+        half.data.clear();
+        if (reader != nullptr && numFrames > 0)
+            reader->read(&half.data, 0, numFrames, start, true, zone->numChannels > 1);
+        if (zone->numChannels == 1)
+            half.data.copyFrom(1, 0, half.data, 0, 0, numFrames);
+        half.numValid = numFrames;
+
+        if (simulatedReadDelayMs > 0)
+            juce::Thread::sleep(simulatedReadDelayMs);
+
+        // Publish only if the voice hasn't moved on while we were reading.
+        if (ticket == half.requested.load(std::memory_order_acquire))
+            half.completed.store(ticket, std::memory_order_release);
+
+        return true;
+    }
+
+    // Keeps a small number of files open so large libraries don't exhaust
+    // file handles.
+    juce::AudioFormatReader *getReader(const SampleZone &zone)
+    {
+        for (auto i = 0; i < readers.size(); ++i)
+        {
+            if (readerZones[i] == &zone)
+            {
+                readers.move(i, 0);
+                readerZones.move(i, 0);
+                return readers.getFirst();
+            }
+        }
+
+        if (readers.size() >= maxOpenReaders)
+        {
+            readers.removeLast();
+            readerZones.removeLast();
+        }
+
+        readers.insert(0, formats.createReaderFor(zone.file));
+        readerZones.insert(0, &zone);
+        return readers.getFirst();
+    }
+
+    static constexpr int maxOpenReaders = 32;
+
+    juce::AudioFormatManager &formats;
+    juce::CriticalSection streamLock;
+    juce::Array<SampleStream *> streams;
+    juce::OwnedArray<juce::AudioFormatReader> readers;
+    juce::Array<const SampleZone *> readerZones;
+    std::atomic<int> simulatedReadDelayMs{0};
+};
+
+// A directory of "<midi note>_<top velocity>.wav" files (also .aif, .aiff,
+// .flac), e.g. 60_64.wav and 60_127.wav for two layers of middle C.
+struct SampledSound : public juce::SynthesiserSound
+{
+    bool appliesToNote(int) override { return true; }
+    bool appliesToChannel(int) override { return true; }
+
+    bool loadFromDirectory(const juce::File &directory, double headSeconds)
+    {
+        formats.registerBasicFormats();
+        zones.clear();
+
+        auto files = directory.findChildFiles(juce::File::findFiles, false, "*.wav;*.aif;*.aiff;*.flac");
+        std::map<int, std::map<int, juce::File>> layers;
+        for (auto &f : files)
+        {
+            auto name = f.getFileNameWithoutExtension();
+            auto note = name.upToFirstOccurrenceOf("_", false, false).getIntValue();
+            auto velocity = name.fromFirstOccurrenceOf("_", false, false).getIntValue();
+            if (name.containsChar('_') && juce::isPositiveAndBelow(note, 128) && juce::isPositiveAndBelow(velocity, 128))
+                layers[note][velocity] = f;
+        }
+
+        for (auto &note : layers)
+        {
+            auto low = 0;
+            for (auto &layer : note.second)
+            {
+                auto *zone = zones.add(new SampleZone(layer.second, note.first, low, layer.first));
+                if (!zone->load(formats, headSeconds))
+                    zones.removeObject(zone);
+                low = layer.first + 1;
+            }
+        }
+        return !zones.isEmpty();
+    }
+
+    // Nearest root note among the zones whose layer covers the velocity.
+    const SampleZone *findZone(int note, int velocity) const
+    {
+        const SampleZone *best = nullptr;
+        for (auto *zone : zones)
+        {
+            if (velocity < zone->lowVelocity || velocity > zone->highVelocity)
+                continue;
+            if (best == nullptr || std::abs(zone->rootNote - note) < std::abs(best->rootNote - note))
+                best = zone;
+        }
+        return best;
+    }
+
+    size_t getResidentBytes() const
+    {
+        size_t total = 0;
+        for (auto *zone : zones)
+            total += zone->getResidentBytes();
+        return total;
+    }
+
+    static juce::File getDefaultDirectory()
+    {
+        return juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+            .getChildFile("SenseTrainer")
+            .getChildFile("Samples");
+    }
+
+    juce::AudioFormatManager formats;
+    juce::OwnedArray<SampleZone> zones;
+    std::atomic<int> underruns{0};
+};
+
+struct SampledVoice : public juce::SynthesiserVoice
+{
+    explicit SampledVoice(SampleStreamer &s)
+        : streamer(s), input(2, maxInputFrames), output(2, maxBlockSize)
+    {
+        streamer.addStream(&stream);
+    }
+
+    bool canPlaySound(juce::SynthesiserSound *sound) override
+    {
+        return dynamic_cast<SampledSound *>(sound) != nullptr;
+    }
+
+    void startNote(int midiNoteNumber, float velocity,
+                   juce::SynthesiserSound *sound, int) override
+    {
+        auto *sampled = static_cast<SampledSound *>(sound);
+        zone = sampled->findZone(midiNoteNumber, juce::roundToInt(velocity * 127.0f));
+        if (zone == nullptr)
+        {
+            clearCurrentNote();
+            return;
+        }
+
+        underruns = &sampled->underruns;
+        ratio = std::pow(2.0, (midiNoteNumber - zone->rootNote) / 12.0) * zone->sampleRate / getSampleRate();
+        ratio = juce::jmin(ratio, maxRatio);
+        position = 0.0;
+        level = velocity * 0.5f;
+        releaseGain = 1.0f;
+        releasing = false;
+
+        stream.halves[0].request(zone, zone->headFrames);
+        stream.halves[1].request(zone, zone->headFrames + SampleStream::chunkFrames);
+        streamer.notify();
+    }
+
+    void stopNote(float, bool allowTailOff) override
+    {
+        if (allowTailOff)
+        {
+            releasing = true;
+        }
+        else
+        {
+            clearCurrentNote();
+            zone = nullptr;
+        }
+    }
+
+    void pitchWheelMoved(int) override {}
+    void controllerMoved(int, int) override {}
+
+    void renderNextBlock(juce::AudioSampleBuffer &outputBuffer, int startSample, int numSamples) override
+    {
+        while (zone != nullptr && numSamples > 0)
+        {
+            auto n = juce::jmin(numSamples, maxBlockSize);
+            auto first = (juce::int64)position - 1;
+            auto numInput = (int)((position - (double)(first + 1)) + (n - 1) * ratio) + 4;
+            fetch(first, numInput);
+
+            for (auto ch = 0; ch < 2; ++ch)
+                DspKernels::hermiteResample(input.getReadPointer(ch, 1), output.getWritePointer(ch), n,
+                                            position - (double)(first + 1), ratio);
+
+            auto startGain = level * releaseGain;
+            if (releasing)
+                releaseGain = juce::jmax(0.0f, releaseGain - n * (float)(1.0 / (releaseSeconds * getSampleRate())));
+            auto endGain = level * releaseGain;
+
+            DspKernels::current().addTo(outputBuffer, startSample, output.getArrayOfReadPointers(), 2, n, startGain, endGain);
+
+            position += n * ratio;
+            startSample += n;
+            numSamples -= n;
+            recycleHalves();
+
+            if (releaseGain <= 0.0f || position >= (double)zone->lengthInFrames)
+            {
+                clearCurrentNote();
+                zone = nullptr;
+            }
+        }
+    }
+
+private:
+    // Gathers source frames [first, first + count) into input, from the head,
+    // the stream halves, or silence outside the sample or on underrun.
+    void fetch(juce::int64 first, int count)
+    {
+        auto *dest = input.getArrayOfWritePointers();
+        for (auto done = 0; done < count;)
+        {
+            auto frame = first + done;
+            float *at[2] = {dest[0] + done, dest[1] + done};
+            int n;
+
+            if (frame < 0 || frame >= zone->lengthInFrames)
+            {
+                n = frame < 0 ? (int)juce::jmin((juce::int64)(count - done), -frame) : count - done;
+                juce::FloatVectorOperations::clear(at[0], n);
+                juce::FloatVectorOperations::clear(at[1], n);
+            }
+            else if (frame < zone->headFrames)
+            {
+                n = (int)juce::jmin((juce::int64)(count - done), zone->headFrames - frame);
+                zone->readHead(at, frame, n);
+            }
+            else
+            {
+                n = readStream(frame, count - done, at);
+            }
+            done += n;
+        }
+    }
+
+    int readStream(juce::int64 frame, int maxFrames, float *const *dest)
+    {
+        for (auto &half : stream.halves)
+        {
+            auto start = half.start.load();
+            if (frame < start || frame >= start + SampleStream::chunkFrames || half.zone.load() != zone)
+                continue;
+
+            auto offset = (int)(frame - start);
+            auto n = juce::jmin(maxFrames, SampleStream::chunkFrames - offset);
+            if (half.isReady() && offset + n <= half.numValid)
+            {
+                juce::FloatVectorOperations::copy(dest[0], half.data.getReadPointer(0, offset), n);
+                juce::FloatVectorOperations::copy(dest[1], half.data.getReadPointer(1, offset), n);
+                return n;
+            }
+            break;
+        }
+
+        // Not streamed in time: play silence for this stretch and count it.
+        auto n = juce::jmin(maxFrames, maxBlockSize);
+        juce::FloatVectorOperations::clear(dest[0], n);
+        juce::FloatVectorOperations::clear(dest[1], n);
+        ++*underruns;
+        return n;
+    }
+
+    // Once playback has moved past a half, queue the chunk after the other one.
+    void recycleHalves()
+    {
+        auto consumed = (juce::int64)position - 2;
+        auto requested = false;
+        for (auto &half : stream.halves)
+        {
+            auto next = half.start.load() + 2 * SampleStream::chunkFrames;
+            if (half.start.load() + SampleStream::chunkFrames <= consumed && next < zone->lengthInFrames)
+            {
+                half.request(zone, next);
+                requested = true;
+            }
+        }
+
+        if (requested)
+            streamer.notify();
+    }
+
+    static constexpr int maxBlockSize = 256;
+    static constexpr double maxRatio = 8.0;
+    static constexpr int maxInputFrames = (int)(maxBlockSize * maxRatio) + 8;
+    static constexpr double releaseSeconds = 0.3;
+
+    SampleStreamer &streamer;
+    SampleStream stream;
+    juce::AudioSampleBuffer input, output;
+    const SampleZone *zone = nullptr;
+    std::atomic<int> *underruns = nullptr;
+    double position = 0.0, ratio = 1.0;
+    float level = 0.0f, releaseGain = 1.0f;
+    bool releasing = false;
+};
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "HeadlessCommand.h"
+#include "SampledInstrument.h"
+
+// Headless mode for the sampled piano: a streaming stress test.
+class SampledInstrumentCommands : private HeadlessCommand
+{
+public:
+    static void addTo(juce::ConsoleApplication &app)
+    {
+        app.addCommand({"--stream-stress",
+                        "--stream-stress <sample directory> [--voices=N] [--seconds=N] [--head-ms=N] [--read-delay-ms=N]",
+                        "Plays dense random notes in real time and counts streaming underruns.",
+                        {},
+                        [](const juce::ArgumentList &a) { streamStress(a); }});
+    }
+
+private:
+    static void streamStress(const juce::ArgumentList &args)
+    {
+        args.checkMinNumArguments(2);
+        auto directory = args[1].resolveAsExistingFolder();
+        auto numVoices = getIntOption(args, "--voices", 32);
+        auto seconds = getIntOption(args, "--seconds", 10);
+        const double sampleRate = 48000.0;
+        const int blockSize = 128;
+
+        auto *sound = new SampledSound();
+        juce::SynthesiserSound::Ptr holder(sound);
+        if (!sound->loadFromDirectory(directory, getIntOption(args, "--head-ms", 500) * 0.001))
+            juce::ConsoleApplication::fail("No samples found in " + directory.getFullPathName());
+
+        SampleStreamer streamer(sound->formats);
+        streamer.setSimulatedReadDelay(getIntOption(args, "--read-delay-ms", 0));
+
+        juce::Synthesiser synth;
+        for (auto i = 0; i < numVoices; ++i)
+            synth.addVoice(new SampledVoice(streamer));
+        synth.addSound(holder);
+        synth.setCurrentPlaybackSampleRate(sampleRate);
+        streamer.startThread(7);
+
+        juce::AudioSampleBuffer buffer(2, blockSize);
+        juce::MidiBuffer midi;
+        juce::Random random(1);
+        auto numBlocks = (int)(seconds * sampleRate / blockSize);
+        auto blockMs = blockSize * 1000.0 / sampleRate;
+        auto start = juce::Time::getMillisecondCounterHiRes();
+
+        for (auto b = 0; b < numBlocks; ++b)
+        {
+            midi.clear();
+            if (random.nextInt(4) == 0)
+                midi.addEvent(juce::MidiMessage::noteOn(1, 36 + random.nextInt(60), (juce::uint8)(1 + random.nextInt(127))), 0);
+            if (random.nextInt(4) == 0)
+                midi.addEvent(juce::MidiMessage::noteOff(1, 36 + random.nextInt(60)), 0);
+
+            buffer.clear();
+            synth.renderNextBlock(buffer, midi, 0, blockSize);
+
+            // Pace the render like a device callback so the streamer has real deadlines.
+            auto wait = start + (b + 1) * blockMs - juce::Time::getMillisecondCounterHiRes();
+            if (wait > 0)
+                juce::Thread::sleep((int)wait);
+        }
+
+        std::cout << sound->zones.size() << " zones, " << sound->getResidentBytes() / (1024 * 1024)
+                  << " MiB resident heads" << std::endl
+                  << numVoices << " voices, " << numBlocks << " blocks of " << blockSize << std::endl
+                  << "underruns: " << sound->underruns.load() << std::endl;
+
+        streamer.stopThread(2000);
+        if (sound->underruns.load() > 0)
+            juce::ConsoleApplication::fail("Streaming underruns occurred", 2);
+    }
+};
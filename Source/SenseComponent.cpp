@@ -18,6 +18,7 @@
 */
 
 //[Headers] You can add your own extra header files here...
+#include "Metrics.h"
 //[/Headers]
 
 #include "SenseComponent.h"
@@ -27,8 +28,8 @@
 //[/MiscUserDefs]
 
 //==============================================================================
-UserInterface::UserInterface (juce::TextEditor& tex)
-    : messagesBox(tex)
+UserInterface::UserInterface (juce::TextEditor& tex, QuizSession& quizSession)
+    : messagesBox(tex), session(quizSession)
 {
     //[Constructor_pre] You can add your own custom stuff here..
     //[/Constructor_pre]
@@ -44,6 +45,8 @@ UserInterface::UserInterface (juce::TextEditor& tex)
     juce__comboBox->addItem (TRANS("Level 3"), 3);
     juce__comboBox->addItem (TRANS("Level 4"), 4);
     juce__comboBox->addItem (TRANS("Level 5"), 5);
+    juce__comboBox->addItem (TRANS("Adaptive"), 6);
+    juce__comboBox->addItem (TRANS("Rhythm"), 7);
     juce__comboBox->addListener (this);
 
     juce__comboBox->setBounds (80, 24, 120, 24);
@@ -114,8 +117,6 @@ UserInterface::UserInterface (juce::TextEditor& tex)
 
     juce__label2->setBounds (32, 56, 48, 24);
 
-    cachedImage_speaker_off_png_1 = juce::ImageCache::getFromMemory (speaker_off_png, speaker_off_pngSize);
-
     //[UserPreSize]
     //[/UserPreSize]
 
@@ -126,17 +127,20 @@ UserInterface::UserInterface (juce::TextEditor& tex)
     juce__comboBox->setSelectedId(1, juce::dontSendNotification);
     juce__comboBox2->setSelectedId(1, juce::dontSendNotification);
     juce__textButton->addShortcut(juce::KeyPress::KeyPress(juce::KeyPress::spaceKey));
-    buttonflag = false;
-    answerflag = false;
+    session.onReplayCompleted = [this] { replayCompleted(); };
     (juce__textButton.get())->setEnabled(false);
-    addChildComponent(speaker_on);
-    speaker_on.setBounds(140, 108, speaker_on.getWidth(), speaker_on.getHeight());
+    addAndMakeVisible(speakerIcon);
+    speakerIcon.setBounds(140, 108, 100, 100);
+    setOpaque(true);
+    reactionStats.load(ReactionStats::getDefaultFile());
     //[/Constructor]
 }
 
 UserInterface::~UserInterface()
 {
     //[Destructor_pre]. You can add your own custom destruction code here..
+    session.onReplayCompleted = nullptr;
+    reactionStats.save(ReactionStats::getDefaultFile());
     //[/Destructor_pre]
 
     juce__comboBox = nullptr;
@@ -156,17 +160,10 @@ UserInterface::~UserInterface()
 void UserInterface::paint (juce::Graphics& g)
 {
     //[UserPrePaint] Add your own custom painting code here..
+    RepaintTracker::ScopedPaint tracked("quiz panel");
     //[/UserPrePaint]
 
-    {
-        int x = 140, y = 108, width = 100, height = 100;
-        //[UserPaintCustomArguments] Customize the painting arguments here..
-        //[/UserPaintCustomArguments]
-        g.setColour (juce::Colours::black);
-        g.drawImage (cachedImage_speaker_off_png_1,
-                     x, y, width, height,
-                     0, 0, cachedImage_speaker_off_png_1.getWidth(), cachedImage_speaker_off_png_1.getHeight());
-    }
+    g.fillAll (juce::Colour (0xff5f9ea0));
 
     //[UserPaint] Add your own custom painting code here..
     //[/UserPaint]
@@ -194,7 +191,7 @@ void UserInterface::comboBoxChanged (juce::ComboBox* comboBoxThatHasChanged)
     else if (comboBoxThatHasChanged == juce__comboBox2.get())
     {
         //[UserComboBoxCode_juce__comboBox2] -- add your combo box handling code here..
-        center = 60 + (juce__comboBox2->getSelectedId() - 1);
+        session.setCenterNote(60 + (juce__comboBox2->getSelectedId() - 1));
         //[/UserComboBoxCode_juce__comboBox2]
     }
 
@@ -210,27 +207,30 @@ void UserInterface::buttonClicked (juce::Button* buttonThatWasClicked)
     if (buttonThatWasClicked == juce__textButton.get())
     {
         //[UserButtonCode_juce__textButton] -- add your button handler code here..
-        buttonflag = true;
-        speaker_on.setVisible(true);
+        session.replaying = true;
+        Metrics::get().replays.add();
+        if (onReplay)
+            onReplay();
+        speakerIcon.setPlaying(true);
         (juce__textButton.get())->setEnabled(false);
         //[/UserButtonCode_juce__textButton]
     }
     else if (buttonThatWasClicked == juce__textButton2.get())
     {
         //[UserButtonCode_juce__textButton2] -- add your button handler code here..
-        generateQuiz(juce__comboBox->getSelectedId());
+        session.generate(juce__comboBox->getSelectedId());
         (juce__textButton.get())->setEnabled(true);
         juce__textButton->setToggleState(true,juce::sendNotification);
         (juce__comboBox.get())->setEnabled(false);
         (juce__comboBox2.get())->setEnabled(false);
         (juce__textButton2.get())->setEnabled(false);
-        answerflag = true;
+        session.answering = true;
         //[/UserButtonCode_juce__textButton2]
     }
     else if (buttonThatWasClicked == juce__textButton3.get())
     {
         //[UserButtonCode_juce__textButton3] -- add your button handler code here..
-        answerflag = false;
+        session.answering = false;
         messagesBox.clear();
         (juce__comboBox.get())->setEnabled(true);
         (juce__comboBox2.get())->setEnabled(true);
@@ -248,67 +248,18 @@ void UserInterface::buttonClicked (juce::Button* buttonThatWasClicked)
 //[MiscUserCode] You can add your own definitions of your custom methods or any other code here...
 void UserInterface::replayCompleted()
 {
-    speaker_on.setVisible(false);
+    speakerIcon.setPlaying(false);
     (juce__textButton.get())->setEnabled(true);
     juce__textButton->setToggleState(false, juce::dontSendNotification);
-    buttonflag = false;
-}
-
-void UserInterface::generateQuiz(int difficulty) {
-    int rand;
-    int interval[14] = { -12,-10,-8,-7,-5,-3,-1,2,4,5,7,9,11,12 };
-    int i;
-    switch (difficulty) {
-    case 1:
-        rand = generateRand(14);
-        quiz[0] = center;
-        quiz[1] = center + interval[rand];
-        quiz[2] = 0;
-        break;
-    case 2:
-        rand = generateRand(14);
-        quiz[0] = center + interval[rand];
-        quiz[1] = center;
-        quiz[2] = 0;
-        break;
-    case 3:
-        rand = generateRand(12) + 1;
-        quiz[0] = center;
-        quiz[1] = center + interval[rand];
-        interval[rand] > 0
-            ? quiz[2] = center + interval[rand + (juce::Random::getSystemRandom().nextInt(14 - 1 - rand) + 1)]
-            : quiz[2] = center + interval[rand - (juce::Random::getSystemRandom().nextInt(rand) + 1)];
-        quiz[3] = 0;
-        break;
-    case 4:
-        quiz[0] = center + interval[generateRand(14)];
-        quiz[1] = center;
-        quiz[2] = center + interval[generateRand(14)];
-        quiz[3] = 0;
-        break;
-    case 5:
-        rand = juce::Random::getSystemRandom().nextInt(5);
-        for (i = 0; i < 5; i++) {
-            i == rand ? quiz[i] = center : quiz[i] = center + interval[generateRand(14)];
-        }
-        quiz[i] = 0;
-        break;
-    }
 }
 
 void UserInterface::nextQuiz() {
-    generateQuiz(juce__comboBox->getSelectedId());
+    session.generate(juce__comboBox->getSelectedId());
     juce__textButton->setToggleState(true, juce::sendNotification);
 }
 
-int UserInterface::generateRand(int range) {
-    int rand = 0;
-    rand = juce::Random::getSystemRandom().nextInt(range);
-    if (previousRand == rand) {
-        rand = generateRand(range);
-    }
-    previousRand = rand;
-    return rand;
+void UserInterface::recordReaction(double ms) {
+    reactionStats.add(juce__comboBox->getSelectedId(), ms);
 }
 //[/MiscUserCode]
 
@@ -323,17 +274,14 @@ int UserInterface::generateRand(int range) {
 BEGIN_JUCER_METADATA
 
 <JUCER_COMPONENT documentType="Component" className="UserInterface" componentName=""
-                 parentClasses="public juce::Component" constructorParams="juce::TextEditor&amp; tex"
-                 variableInitialisers="messagesBox(tex)" snapPixels="8" snapActive="1"
+                 parentClasses="public juce::Component" constructorParams="juce::TextEditor&amp; tex, QuizSession&amp; quizSession"
+                 variableInitialisers="messagesBox(tex), session(quizSession)" snapPixels="8" snapActive="1"
                  snapShown="1" overlayOpacity="0.330" fixedSize="0" initialWidth="600"
                  initialHeight="400">
-  <BACKGROUND backgroundColour="323e44">
-    <IMAGE pos="140 108 100 100" resource="speaker_off_png" opacity="1.0"
-           mode="0"/>
-  </BACKGROUND>
+  <BACKGROUND backgroundColour="ff5f9ea0"/>
   <COMBOBOX name="new combo box" id="cf3bf4e5f540eae3" memberName="juce__comboBox"
             virtualName="" explicitFocusOrder="0" pos="80 24 120 24" editable="0"
-            layout="33" items="Level 1&#10;Level 2&#10;Level 3&#10;Level 4&#10;Level 5"
+            layout="33" items="Level 1&#10;Level 2&#10;Level 3&#10;Level 4&#10;Level 5&#10;Adaptive&#10;Rhythm"
             textWhenNonSelected="Select" textWhenNoItems="(no choices)"/>
   <TEXTBUTTON name="new button" id="a4b9e9def2af5267" memberName="juce__textButton"
               virtualName="" explicitFocusOrder="0" pos="152 232 80 80" buttonText="Replay"
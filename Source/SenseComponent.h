@@ -22,6 +22,9 @@
 //[Headers]     -- You can add your own extra header files here --
 #include <JuceHeader.h>
 #include "Nowplaying.h"
+#include "QuizSession.h"
+#include "ReactionTime.h"
+#include "SpeakerIcon.h"
 //[/Headers]
 
 
@@ -40,19 +43,15 @@ class UserInterface  : public juce::Component,
 {
 public:
     //==============================================================================
-    UserInterface (juce::TextEditor& tex);
+    UserInterface (juce::TextEditor& tex, QuizSession& quizSession);
     ~UserInterface() override;
 
     //==============================================================================
     //[UserMethods]     -- You can add your own custom methods in this section.
-    int quiz[6];
-    bool buttonflag;
-    bool answerflag;
+    std::function<void()> onReplay;
 
-    void replayCompleted();
-    void generateQuiz(int difficulty);
     void nextQuiz();
-    int generateRand(int range);
+    void recordReaction(double ms);
     //[/UserMethods]
 
     void paint (juce::Graphics& g) override;
@@ -67,10 +66,13 @@ public:
 
 private:
     //[UserVariables]   -- You can add your own custom variables in this section.
-    int previousRand = -1;
-    int center = 60;
     juce::TextEditor& messagesBox;
-    Speaker_on speaker_on;
+    QuizSession& session;
+    SpeakerIcon speakerIcon{juce::Colours::cadetblue, speaker_off_png, speaker_off_pngSize,
+                            Speaker_on::speaker_on_png, Speaker_on::speaker_on_pngSize};
+    ReactionStats reactionStats;
+
+    void replayCompleted();
     //[/UserVariables]
 
     //==============================================================================
@@ -81,7 +83,6 @@ private:
     std::unique_ptr<juce::ComboBox> juce__comboBox2;
     std::unique_ptr<juce::Label> juce__label;
     std::unique_ptr<juce::Label> juce__label2;
-    juce::Image cachedImage_speaker_off_png_1;
 
 
     //==============================================================================
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "RepaintTracker.h"
+
+// The replay speaker. The embedded PNGs are 256 px and used to be rescaled
+// on every paint; here each state is resampled once per display scale and
+// composited onto the background, so painting is a 1:1 blit. The icon is
+// opaque and buffered, so changing state repaints only its own bounds.
+class SpeakerIcon : public juce::Component
+{
+public:
+    SpeakerIcon(juce::Colour backgroundColour, const void *offPng, int offSize, const void *onPng, int onSize)
+        : background(backgroundColour)
+    {
+        sources[0] = juce::ImageCache::getFromMemory(offPng, offSize);
+        sources[1] = juce::ImageCache::getFromMemory(onPng, onSize);
+        setOpaque(true);
+        setBufferedToImage(true);
+        setInterceptsMouseClicks(false, false);
+    }
+
+    void setPlaying(bool shouldShowPlaying)
+    {
+        if (playing == shouldShowPlaying)
+            return;
+
+        playing = shouldShowPlaying;
+        repaint();
+    }
+
+    bool isPlaying() const { return playing; }
+
+    void paint(juce::Graphics &g) override
+    {
+        RepaintTracker::ScopedPaint tracked("speaker");
+        auto scale = g.getInternalContext().getPhysicalPixelScaleFactor();
+        g.drawImageTransformed(getScaled(playing ? 1 : 0, scale), juce::AffineTransform::scale(1.0f / scale));
+    }
+
+    void resized() override
+    {
+        scaled.clear();
+    }
+
+private:
+    struct Scaled
+    {
+        int state;
+        juce::Image image;
+    };
+
+    const juce::Image &getScaled(int state, float scale)
+    {
+        auto width = juce::jmax(1, juce::roundToInt(getWidth() * scale));
+        auto height = juce::jmax(1, juce::roundToInt(getHeight() * scale));
+        for (auto &s : scaled)
+            if (s.state == state && s.image.getWidth() == width && s.image.getHeight() == height)
+                return s.image;
+
+        // Only a couple of display scales are ever in use at once.
+        if (scaled.size() >= 8)
+            scaled.clear();
+
+        juce::Image image(juce::Image::RGB, width, height, false);
+        juce::Graphics g(image);
+        g.fillAll(background);
+        g.setImageResamplingQuality(juce::Graphics::highResamplingQuality);
+        if (sources[state].isValid())
+            g.drawImage(sources[state], image.getBounds().toFloat());
+
+        scaled.push_back({state, image});
+        return scaled.back().image;
+    }
+
+    juce::Colour background;
+    juce::Image sources[2];
+    std::vector<Scaled> scaled;
+    bool playing = false;
+};
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "SynthUsingMidiInput.h"
+#include "BufferSizeTuner.h"
+#include "RealtimeThreads.h"
+
+// Sine voices and the reverb standing in for the application's synth,
+// with the same idle fast path.
+struct SynthLoad : public juce::AudioSource
+{
+    explicit SynthLoad(int numVoices)
+    {
+        for (auto i = 0; i < numVoices; ++i)
+            synth.addVoice(new SineWaveVoice());
+        synth.addSound(new SineWaveSound());
+        reverb.loadImpulseResponse(ConvolutionReverb::getDefaultImpulseResponse());
+    }
+
+    void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override
+    {
+        synth.setCurrentPlaybackSampleRate(sampleRate);
+        synth.prepareWorkers(numWorkers, samplesPerBlockExpected, 2);
+        reverb.prepare(samplesPerBlockExpected, 2);
+        monitor.prepare(samplesPerBlockExpected, sampleRate);
+        idle.prepare(sampleRate);
+        threadConfigured = false;
+    }
+
+    void releaseResources() override {}
+
+    void getNextAudioBlock(const juce::AudioSourceChannelInfo &bufferToFill) override
+    {
+        if (!threadConfigured)
+        {
+            RealtimeThreads::getInstance().enterRealtime(RealtimeThreads::Role::audio, 0);
+            threadConfigured = true;
+        }
+
+        auto started = monitor.begin();
+        bufferToFill.clearActiveBufferRegion();
+
+        if (!idle.canSkipBlock(active.load() != playing))
+        {
+            juce::MidiBuffer midi;
+            if (active.load() != playing)
+            {
+                playing = !playing;
+                for (auto i = 0; i < synth.getNumVoices(); ++i)
+                    midi.addEvent(playing ? juce::MidiMessage::noteOn(1, 36 + i * 3, (juce::uint8)90)
+                                          : juce::MidiMessage::noteOff(1, 36 + i * 3),
+                                  0);
+            }
+
+            synth.renderNextBlock(*bufferToFill.buffer, midi, bufferToFill.startSample, bufferToFill.numSamples);
+            reverb.process(*bufferToFill.buffer, bufferToFill.startSample, bufferToFill.numSamples);
+            idle.blockRendered(*bufferToFill.buffer, bufferToFill.startSample, bufferToFill.numSamples,
+                               synth.isAnyVoiceActive());
+            bufferToFill.clearActiveBufferRegion();
+        }
+        monitor.end(started, bufferToFill.numSamples);
+    }
+
+    ParallelSynthesiser synth;
+    ConvolutionReverb reverb;
+    CallbackMonitor monitor;
+    IdleDetector idle;
+    std::atomic<bool> active{false};
+    bool playing = false, threadConfigured = false;
+    int numWorkers = 0;
+};
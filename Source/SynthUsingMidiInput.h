@@ -19,7 +19,15 @@
 
 #pragma once
 #include <JuceHeader.h>
-#include "SenseComponent.h"
+#include "QuizSession.h"
+#include "SampledInstrument.h"
+#include "ConvolutionReverb.h"
+#include "ParallelSynthesiser.h"
+#include "PhysicalVoices.h"
+#include "LockFreeKeyboardState.h"
+#include "RhythmEngine.h"
+#include "IdlePowerSaver.h"
+#include "Metrics.h"
 struct SineWaveSound : public juce::SynthesiserSound
 {
     SineWaveSound() {}
@@ -112,44 +120,163 @@ struct SineWaveVoice : public juce::SynthesiserVoice
 private:
     double currentAngle = 0.0, angleDelta = 0.0, level = 0.0, tailOff = 0.0;
 };
-class SynthAudioSource : public juce::AudioSource,
-                         public juce::Timer
+
+// The instruments on one ParallelSynthesiser: voices for each of them, the
+// sampled piano's streamer once its library has loaded, and which one is
+// playing. SynthAudioSource plays through it, as does the processor graph.
+class InstrumentSynth
 {
 public:
-    SynthAudioSource(juce::MidiKeyboardState &keyState, UserInterface &ui)
-        : keyboardState(keyState), UI(ui)
+    enum class Instrument
+    {
+        sine,
+        sampledPiano,
+        pluckedString,
+        modalPiano
+    };
+
+    // Starts on the sampled piano if its library is installed (and wanted),
+    // else the modal piano.
+    explicit InstrumentSynth(bool loadSampledPiano = true)
     {
         for (auto i = 0; i < 4; ++i)
             synth.addVoice(new SineWaveVoice());
+        for (auto i = 0; i < 8; ++i)
+        {
+            synth.addVoice(new PluckedStringVoice());
+            synth.addVoice(new ModalPianoVoice());
+        }
 
-        synth.addSound(new SineWaveSound());
+        if (!loadSampledPiano || !setUsingSampledSound(SampledSound::getDefaultDirectory()))
+            setInstrument(Instrument::modalPiano);
     }
 
-    void setUsingSineWaveSound()
+    // Message thread. The sampled piano is only available if its library loaded.
+    bool setInstrument(Instrument newInstrument)
     {
+        juce::SynthesiserSound::Ptr sound;
+        switch (newInstrument)
+        {
+        case Instrument::sine:
+            sound = new SineWaveSound();
+            break;
+        case Instrument::sampledPiano:
+            sound = sampledSound;
+            break;
+        case Instrument::pluckedString:
+            sound = new PluckedStringSound();
+            break;
+        case Instrument::modalPiano:
+            sound = new ModalPianoSound();
+            break;
+        }
+        if (sound == nullptr)
+            return false;
+
+        synth.allNotesOff(0, true);
         synth.clearSounds();
+        synth.addSound(sound);
+        synth.setUsingWorkers(newInstrument != Instrument::sine);
+        instrument = newInstrument;
+        return true;
+    }
+
+    Instrument getInstrument() const { return instrument; }
+
+    // Switches to the sampled piano if the directory holds a usable library.
+    bool setUsingSampledSound(const juce::File &directory)
+    {
+        if (!directory.isDirectory() || streamer != nullptr)
+            return false;
+
+        auto *sound = new SampledSound();
+        juce::SynthesiserSound::Ptr holder(sound);
+        if (!sound->loadFromDirectory(directory, 0.5))
+            return false;
+
+        sampledSound = holder;
+        streamer.reset(new SampleStreamer(sound->formats));
+        for (auto i = 0; i < 16; ++i)
+            synth.addVoice(new SampledVoice(*streamer));
+
+        synth.clearSounds();
+        synth.addSound(sampledSound);
+        synth.setUsingWorkers(true);
+        instrument = Instrument::sampledPiano;
+        streamer->startThread(7);
+        return true;
+    }
+
+    ParallelSynthesiser &getSynth() { return synth; }
+
+private:
+    ParallelSynthesiser synth;
+    juce::SynthesiserSound::Ptr sampledSound;
+    std::unique_ptr<SampleStreamer> streamer;
+    Instrument instrument = Instrument::sine;
+};
+
+class SynthAudioSource : public juce::AudioSource,
+                         public juce::Timer
+{
+public:
+    using Instrument = InstrumentSynth::Instrument;
+
+    SynthAudioSource(LockFreeKeyboardState &keyState, QuizSession &quizSession)
+        : keyboardState(keyState), session(quizSession)
+    {
+        reverb.loadImpulseResponse(ConvolutionReverb::getDefaultImpulseResponse());
     }
 
+    // Message thread. The sampled piano is only available if its library loaded.
+    bool setInstrument(Instrument newInstrument) { return instruments.setInstrument(newInstrument); }
+
+    Instrument getInstrument() const { return instruments.getInstrument(); }
+
+    void setUsingSineWaveSound()
+    {
+        setInstrument(Instrument::sine);
+    }
+
+    // Switches to the sampled piano if the directory holds a usable library.
+    bool setUsingSampledSound(const juce::File &directory) { return instruments.setUsingSampledSound(directory); }
+
     void nextQuizNote()
     {
-        if (UI.quiz[currentNote])
+        if (session.quiz[currentNote])
         {
-            quizMessage = juce::MidiMessage::MidiMessage(144, UI.quiz[currentNote], 100);
-            quizMessage.setTimeStamp(juce::Time::getMillisecondCounterHiRes() * 0.001);
-            quizMidi = juce::MidiBuffer::MidiBuffer(quizMessage);
+            quizMessage = juce::MidiMessage::MidiMessage(144, session.quiz[currentNote], 100);
+            quizMessage.setTimeStamp(getReplayTime());
+            // Placed past any block, so the note starts as the next block ends.
+            quizMidi.clear();
+            quizMidi.addEvent(quizMessage, promptPosition);
         }
         else
         {
-            const juce::MessageManagerLock messageManagerLock;
-            UI.replayCompleted();
+            session.finishReplay();
             currentNote = -1;
         }
     }
 
-    void prepareToPlay(int, double sampleRate) override
+    void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override
     {
+        currentSampleRate = sampleRate;
         synth.setCurrentPlaybackSampleRate(sampleRate);
-        midiCollector.reset(sampleRate);
+        // Resetting drops queued input, so keep the note that woke a suspended device.
+        if (sampleRate != collectorSampleRate)
+        {
+            midiCollector.reset(sampleRate);
+            collectorSampleRate = sampleRate;
+        }
+        rhythm.prepare(sampleRate);
+        idleDetector.prepare(sampleRate);
+        reverb.prepare(samplesPerBlockExpected, 2);
+        DspKernels::prepare(2, samplesPerBlockExpected);
+
+        // Sized for the costliest instrument, since it can be picked while
+        // the device runs; sine voices, too cheap to be worth a fork/join,
+        // leave the workers parked.
+        synth.prepareWorkers(juce::jlimit(0, 3, juce::SystemStats::getNumCpus() - 2), samplesPerBlockExpected, 2);
     }
 
     void releaseResources() override {}
@@ -157,10 +284,44 @@ public:
     void getNextAudioBlock(const juce::AudioSourceChannelInfo &bufferToFill) override
     {
         bufferToFill.clearActiveBufferRegion();
+        rhythm.beginBlock(bufferToFill.numSamples);
+
+        // Nothing sounding and nothing to play: leave the block silent.
+        if (idleDetector.canSkipBlock(session.replaying.load() || !rhythm.isIdle() || loadTest.load()))
+        {
+            Metrics::get().audioBlocksSkipped.add();
+            return;
+        }
+
+        if (loadTest.load())
+        {
+            renderLoadTest(bufferToFill);
+            return;
+        }
+        if (loadTestPlaying)
+        {
+            synth.allNotesOff(0, false);
+            loadTestPlaying = false;
+        }
+
+        if (session.replaying.load() && session.isRhythmMode())
+        {
+            // The user taps along while the take plays, so live input stays audible.
+            if (rhythm.isIdle())
+                rhythm.start(session.rhythm, session.getCenterNote());
+
+            juce::MidiBuffer incomingMidi;
+            midiCollector.removeNextBlockOfMessages(incomingMidi, bufferToFill.numSamples);
+            keyboardState.processNextMidiBuffer(incomingMidi, bufferToFill.startSample,
+                                                bufferToFill.numSamples, true);
+            rhythm.addPatternNotes(incomingMidi, bufferToFill.startSample, bufferToFill.numSamples);
 
-        if (UI.buttonflag)
+            synth.renderNextBlock(*bufferToFill.buffer, incomingMidi,
+                                  bufferToFill.startSample, bufferToFill.numSamples);
+        }
+        else if (session.replaying.load() && !externalPrompts.load())
         {
-            if (juce::Time::getMillisecondCounterHiRes() * 0.001 - quizMessage.getTimeStamp() > 0.5)
+            if (getReplayTime() - quizMessage.getTimeStamp() > 0.5)
             {
                 if (currentNote == -1)
                 {
@@ -169,8 +330,9 @@ public:
                 }
                 else
                 {
-                    quizMidi = juce::MidiBuffer::MidiBuffer(juce::MidiMessage::MidiMessage(128, UI.quiz[currentNote], 0, 0.0));
+                    quizMidi = juce::MidiBuffer::MidiBuffer(juce::MidiMessage::MidiMessage(128, session.quiz[currentNote], 0, 0.0));
                 }
+                promptNote = -1;
                 synth.renderNextBlock(*bufferToFill.buffer, quizMidi,
                                       bufferToFill.startSample, bufferToFill.numSamples);
 
@@ -180,6 +342,16 @@ public:
             }
             else
             {
+                // Events past the block end are played as it finishes.
+                for (const auto metadata : quizMidi)
+                {
+                    if (metadata.getMessage().isNoteOn())
+                    {
+                        promptSample = rhythm.getBlockStartSample() + juce::jlimit(0, bufferToFill.numSamples, metadata.samplePosition);
+                        promptNote = metadata.getMessage().getNoteNumber();
+                    }
+                }
+
                 synth.renderNextBlock(*bufferToFill.buffer, quizMidi,
                                       bufferToFill.startSample, bufferToFill.numSamples);
 
@@ -197,11 +369,16 @@ public:
             synth.renderNextBlock(*bufferToFill.buffer, incomingMidi,
                                   bufferToFill.startSample, bufferToFill.numSamples);
         }
+
+        reverb.process(*bufferToFill.buffer, bufferToFill.startSample, bufferToFill.numSamples);
+        rhythm.renderClicks(*bufferToFill.buffer, bufferToFill.startSample, bufferToFill.numSamples);
+        idleDetector.blockRendered(*bufferToFill.buffer, bufferToFill.startSample, bufferToFill.numSamples,
+                                   synth.isAnyVoiceActive());
     }
 
     void timerCallback() override
     {
-        quizMidi = juce::MidiBuffer::MidiBuffer(juce::MidiMessage::MidiMessage(128, UI.quiz[currentNote], 0, 0.0));
+        quizMidi = juce::MidiBuffer::MidiBuffer(juce::MidiMessage::MidiMessage(128, session.quiz[currentNote], 0, 0.0));
         currentNote++;
         stopTimer();
     }
@@ -211,14 +388,109 @@ public:
         return &midiCollector;
     }
 
+    RhythmEngine &getRhythmEngine()
+    {
+        return rhythm;
+    }
+
+    IdleDetector &getIdleDetector()
+    {
+        return idleDetector;
+    }
+
+    ConvolutionReverb &getReverb()
+    {
+        return reverb;
+    }
+
+    // Offline renders pace the replay by the samples rendered rather than the
+    // wall clock, so a quiz renders the same however fast it runs.
+    void setOfflineReplay(bool shouldUseSampleClock)
+    {
+        offlineReplay = shouldUseSampleClock;
+    }
+
+    // Sample position of a replayed note-on within its block; past the end of any block.
+    static constexpr int promptPosition = 1 << 30;
+
+    // While on, callbacks render a sustained chord through the synth and
+    // reverb and then discard it, so the device sees a realistic load in silence.
+    void setLoadTest(bool shouldRun)
+    {
+        loadTest = shouldRun;
+    }
+
+    // While on, replays are played by MidiPromptOutput instead, and the
+    // synth keeps playing live input through them.
+    void setExternalPrompts(bool shouldUseExternal)
+    {
+        externalPrompts = shouldUseExternal;
+    }
+
+    // The quiz note sounding in a replay, or -1.
+    int getPromptNote() const
+    {
+        return promptNote.load();
+    }
+
+    // Seconds from the last quiz note reaching the listener to the given
+    // Time::getMillisecondCounterHiRes() time, or -1 if nothing has played.
+    double getTimeSincePrompt(double timeSeconds) const
+    {
+        auto prompt = promptSample.load();
+        if (prompt < 0)
+            return -1.0;
+
+        auto heard = (double)(prompt + rhythm.getLatencyCompensation());
+        return (rhythm.getClock().sampleAt(timeSeconds) - heard) / currentSampleRate;
+    }
+
 private:
-    juce::MidiKeyboardState &keyboardState;
-    juce::Synthesiser synth;
+    double getReplayTime() const
+    {
+        if (offlineReplay)
+            return (double)rhythm.getBlockStartSample() / currentSampleRate;
+        return juce::Time::getMillisecondCounterHiRes() * 0.001;
+    }
+
+    void renderLoadTest(const juce::AudioSourceChannelInfo &bufferToFill)
+    {
+        juce::MidiBuffer chord;
+        if (!loadTestPlaying || loadTestSamples <= 0)
+        {
+            for (auto note : {36, 43, 48, 52, 55, 60, 64, 67, 72, 76, 79, 84})
+                chord.addEvent(juce::MidiMessage::noteOn(1, note, (juce::uint8)90), 0);
+
+            loadTestSamples = (int)(currentSampleRate * 0.5);
+            loadTestPlaying = true;
+        }
+        loadTestSamples -= bufferToFill.numSamples;
+
+        synth.renderNextBlock(*bufferToFill.buffer, chord, bufferToFill.startSample, bufferToFill.numSamples);
+        reverb.process(*bufferToFill.buffer, bufferToFill.startSample, bufferToFill.numSamples);
+        bufferToFill.clearActiveBufferRegion();
+    }
+
+    LockFreeKeyboardState &keyboardState;
+    InstrumentSynth instruments;
+    ParallelSynthesiser &synth = instruments.getSynth();
+    ConvolutionReverb reverb;
+    RhythmEngine rhythm;
+    IdleDetector idleDetector;
+    std::atomic<juce::int64> promptSample{-1};
+    std::atomic<int> promptNote{-1};
+    double currentSampleRate = 44100.0;
+    std::atomic<bool> loadTest{false};
+    std::atomic<bool> externalPrompts{false};
+    bool offlineReplay = false;
+    bool loadTestPlaying = false;
+    int loadTestSamples = 0;
     juce::MidiMessageCollector midiCollector;
+    double collectorSampleRate = 0.0;
     bool flag = false;
     int currentNote = -1;
     juce::MidiMessage quizMessage;
     juce::MidiBuffer quizMidi = juce::MidiBuffer::MidiBuffer();
     bool noteOffflag = true;
-    UserInterface &UI;
+    QuizSession &session;
 };
\ No newline at end of file
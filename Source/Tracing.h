@@ -0,0 +1,274 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <memory>
+
+// Timeline of what the MIDI, audio, worker and message threads were doing,
+// for reconstructing a reported lag. Each thread writes begin/end/flow
+// events into its own ring (single producer, oldest events overwritten), so
+// recording is a flag test, a clock read and four stores. A thread hands its
+// ring back when it exits, so threads that come and go (device restarts,
+// benchmarks) don't use up the rings; events from threads beyond maxThreads
+// live ones are counted as dropped. Flows follow a key press from where it
+// arrived through the audio callback, grading and the message list. Export
+// writes Chrome trace JSON, which chrome://tracing and ui.perfetto.dev both
+// open.
+class Tracer
+{
+public:
+    enum class Phase : juce::uint8
+    {
+        begin,
+        end,
+        instant,
+        flowStart,
+        flowStep,
+        flowEnd
+    };
+
+    static Tracer &getInstance()
+    {
+        static Tracer instance;
+        return instance;
+    }
+
+    // Message thread. Starting clears any previous trace, including the
+    // rings of threads that have exited since.
+    void setEnabled(bool shouldTrace)
+    {
+        if (shouldTrace && !enabled.load())
+        {
+            for (auto &ring : rings)
+            {
+                if (ring.events == nullptr)
+                    ring.events.reset(new Event[ringSize]);
+                ring.written.store(0, std::memory_order_relaxed);
+
+                auto retired = (int)RingState::retired;
+                ring.state.compare_exchange_strong(retired, (int)RingState::free, std::memory_order_acq_rel);
+            }
+            numDropped.store(0, std::memory_order_relaxed);
+            startTicks = juce::Time::getHighResolutionTicks();
+        }
+        enabled.store(shouldTrace, std::memory_order_release);
+    }
+
+    // Acquire, so a thread that sees tracing on also sees the rings' events.
+    bool isEnabled() const { return enabled.load(std::memory_order_acquire); }
+
+    static void record(Phase phase, const char *name, juce::uint64 id = 0)
+    {
+        auto &tracer = getInstance();
+        if (!tracer.isEnabled())
+            return;
+
+        if (auto *ring = tracer.ringForThisThread())
+            ring->push({juce::Time::getHighResolutionTicks(), name, id, phase});
+        else
+            tracer.numDropped.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Events from threads that found no free ring since tracing started.
+    juce::uint64 getNumDroppedEvents() const { return numDropped.load(std::memory_order_relaxed); }
+
+    struct Scope
+    {
+        explicit Scope(const char *scopeName) : name(scopeName), active(getInstance().isEnabled())
+        {
+            if (active)
+                record(Phase::begin, name);
+        }
+
+        ~Scope()
+        {
+            if (active)
+                record(Phase::end, name);
+        }
+
+        const char *name;
+        bool active;
+    };
+
+    // Flows are keyed by note number: a press starts one wherever it first
+    // arrives (MIDI input or the on-screen keyboard) and later steps find it.
+    void beginNoteFlow(int note)
+    {
+        if (!isEnabled())
+            return;
+
+        auto id = nextFlow.fetch_add(1, std::memory_order_relaxed) + 1;
+        noteFlows[note & 127].store(id, std::memory_order_relaxed);
+        record(Phase::flowStart, "key press", id);
+    }
+
+    void noteFlow(int note, Phase phase, const char *name)
+    {
+        if (!isEnabled())
+            return;
+
+        auto id = noteFlows[note & 127].load(std::memory_order_relaxed);
+        if (id != 0)
+            record(phase, name, id);
+    }
+
+    // Overrides the name taken from juce::Thread, e.g. for device callbacks.
+    void setThreadName(const char *name)
+    {
+        if (auto *ring = ringForThisThread())
+            juce::String(name).copyToUTF8(ring->threadName, sizeof(ring->threadName));
+    }
+
+    // Events being written during the export may be torn, so the oldest
+    // part of a full ring, which a writer could be overwriting, is skipped.
+    // The dropped-event count goes in otherData.
+    bool exportChromeJson(const juce::File &file) const
+    {
+        juce::MemoryOutputStream out;
+        out << "{\"traceEvents\":[\n";
+        auto first = true;
+        for (auto t = 0; t < maxThreads; ++t)
+        {
+            auto &ring = rings[t];
+            auto state = ring.state.load(std::memory_order_acquire);
+            if ((state != (int)RingState::owned && state != (int)RingState::retired) || ring.events == nullptr)
+                continue;
+
+            writeSeparator(out, first);
+            out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << t
+                << ",\"args\":{\"name\":" << juce::JSON::toString(juce::String(ring.threadName)) << "}}";
+
+            auto end = ring.written.load(std::memory_order_acquire);
+            auto begin = end > (juce::uint64)(ringSize - safetyMargin) ? end - (ringSize - safetyMargin) : 0;
+            for (auto n = begin; n < end; ++n)
+            {
+                auto &e = ring.events[n & (ringSize - 1)];
+                writeSeparator(out, first);
+                out << "{\"name\":" << juce::JSON::toString(juce::String(e.name)) << ",\"cat\":\"sense\",\"ph\":\""
+                    << phaseCode(e.phase) << "\",\"pid\":1,\"tid\":" << t << ",\"ts\":"
+                    << juce::String(juce::Time::highResolutionTicksToSeconds(e.ticks - startTicks) * 1.0e6, 3);
+                if (e.phase == Phase::instant)
+                    out << ",\"s\":\"t\"";
+                if (e.phase == Phase::flowStart || e.phase == Phase::flowStep || e.phase == Phase::flowEnd)
+                    out << ",\"id\":" << (juce::int64)e.id;
+                if (e.phase == Phase::flowEnd)
+                    out << ",\"bp\":\"e\"";
+                out << "}";
+            }
+        }
+        out << "\n],\"otherData\":{\"droppedEvents\":" << (juce::int64)getNumDroppedEvents() << "}}\n";
+
+        file.getParentDirectory().createDirectory();
+        return file.replaceWithData(out.getData(), out.getDataSize());
+    }
+
+    static juce::File getDefaultFile()
+    {
+        return juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+            .getChildFile("SenseTrainer")
+            .getChildFile("trace-" + juce::Time::getCurrentTime().formatted("%Y%m%d-%H%M%S") + ".json");
+    }
+
+private:
+    static constexpr int maxThreads = 16;
+    static constexpr int ringSize = 8192; // events per thread, a power of two
+    static constexpr int safetyMargin = 256;
+
+    struct Event
+    {
+        juce::int64 ticks;
+        const char *name;
+        juce::uint64 id;
+        Phase phase;
+    };
+
+    struct Ring
+    {
+        void push(const Event &e)
+        {
+            auto n = written.load(std::memory_order_relaxed);
+            events[n & (ringSize - 1)] = e;
+            written.store(n + 1, std::memory_order_release);
+        }
+
+        std::unique_ptr<Event[]> events; // allocated on first enable and kept
+        std::atomic<juce::uint64> written{0};
+        std::atomic<int> state{0};
+        char threadName[32] = {};
+    };
+
+    // A ring whose thread exited keeps its events until the next trace
+    // starts; one that never recorded is free again straight away.
+    enum class RingState
+    {
+        free,
+        claiming,
+        owned,
+        retired
+    };
+
+    struct RingLease
+    {
+        ~RingLease()
+        {
+            if (ring != nullptr)
+                ring->state.store((int)(ring->written.load(std::memory_order_relaxed) > 0 ? RingState::retired : RingState::free),
+                                  std::memory_order_release);
+        }
+
+        Ring *ring = nullptr;
+    };
+
+    Tracer() = default;
+
+    // A thread without a ring tries again on its next event, in case one was freed.
+    Ring *ringForThisThread()
+    {
+        thread_local RingLease lease;
+        if (lease.ring == nullptr)
+            lease.ring = claimRing();
+        return lease.ring;
+    }
+
+    Ring *claimRing()
+    {
+        for (auto index = 0; index < maxThreads; ++index)
+        {
+            auto &ring = rings[index];
+            auto expected = (int)RingState::free;
+            if (!ring.state.compare_exchange_strong(expected, (int)RingState::claiming, std::memory_order_acquire))
+                continue;
+
+            if (auto *thread = juce::Thread::getCurrentThread())
+                thread->getThreadName().copyToUTF8(ring.threadName, sizeof(ring.threadName));
+            else if (juce::MessageManager::existsAndIsCurrentThread())
+                juce::String("message").copyToUTF8(ring.threadName, sizeof(ring.threadName));
+            else
+                juce::String("thread " + juce::String(index)).copyToUTF8(ring.threadName, sizeof(ring.threadName));
+            ring.state.store((int)RingState::owned, std::memory_order_release);
+            return &ring;
+        }
+        return nullptr;
+    }
+
+    static const char *phaseCode(Phase phase)
+    {
+        const char *codes[] = {"B", "E", "i", "s", "t", "f"};
+        return codes[(int)phase];
+    }
+
+    static void writeSeparator(juce::OutputStream &out, bool &first)
+    {
+        if (!first)
+            out << ",\n";
+        first = false;
+    }
+
+    std::atomic<bool> enabled{false};
+    std::atomic<juce::uint64> numDropped{0};
+    std::atomic<juce::uint64> nextFlow{0};
+    std::atomic<juce::uint64> noteFlows[128] = {};
+    juce::int64 startTicks = 0;
+    Ring rings[maxThreads];
+
+    JUCE_DECLARE_NON_COPYABLE(Tracer)
+};
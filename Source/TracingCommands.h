@@ -0,0 +1,68 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <thread>
+#include <vector>
+#include "HeadlessCommand.h"
+#include "Tracing.h"
+
+// Headless mode for Tracer: the cost of an event.
+class TracingCommands : private HeadlessCommand
+{
+public:
+    static void addTo(juce::ConsoleApplication &app)
+    {
+        app.addCommand({"--trace-bench",
+                        "--trace-bench [--count=N] [--threads=N] [--out=file.json]",
+                        "Measures the cost of a trace event with tracing off and on, from several threads at once.",
+                        "With --out, the recorded events are exported as Chrome trace JSON.",
+                        [](const juce::ArgumentList &a) { traceBench(a); }});
+    }
+
+private:
+    // Nanoseconds per event, averaged over all threads.
+    static double measureTracing(int count, int numThreads)
+    {
+        std::atomic<juce::int64> ticks{0};
+        std::vector<std::thread> threads;
+        for (auto t = 0; t < numThreads; ++t)
+            threads.emplace_back([&ticks, count]
+            {
+                auto start = juce::Time::getHighResolutionTicks();
+                for (auto i = 0; i < count / 2; ++i)
+                    Tracer::Scope traced("bench");
+                ticks += juce::Time::getHighResolutionTicks() - start;
+            });
+        for (auto &thread : threads)
+            thread.join();
+
+        return juce::Time::highResolutionTicksToSeconds(ticks.load()) * 1.0e9 / ((double)(count / 2) * 2.0 * numThreads);
+    }
+
+    static void traceBench(const juce::ArgumentList &args)
+    {
+        auto count = juce::jmax(1000, getIntOption(args, "--count", 10000000));
+        auto numThreads = juce::jmax(1, getIntOption(args, "--threads", 3));
+        auto &tracer = Tracer::getInstance();
+
+        tracer.setEnabled(false);
+        auto off = measureTracing(count, numThreads);
+        tracer.setEnabled(true);
+        auto on = measureTracing(count, numThreads);
+        tracer.setEnabled(false);
+
+        std::cout << numThreads << " threads, " << count << " events each" << std::endl
+                  << "tracing off: " << juce::String(off, 2) << " ns/event" << std::endl
+                  << "tracing on:  " << juce::String(on, 2) << " ns/event" << std::endl;
+        if (auto dropped = tracer.getNumDroppedEvents())
+            std::cout << dropped << " events dropped for want of a free ring" << std::endl;
+
+        if (args.containsOption("--out"))
+        {
+            auto file = juce::File::getCurrentWorkingDirectory().getChildFile(args.getValueForOption("--out"));
+            if (!tracer.exportChromeJson(file))
+                juce::ConsoleApplication::fail("Could not write " + file.getFullPathName());
+            std::cout << "wrote " << file.getFullPathName() << std::endl;
+        }
+    }
+};
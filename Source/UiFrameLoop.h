@@ -0,0 +1,132 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <vector>
+#include "Metrics.h"
+#include "Tracing.h"
+
+// The one place the GUI is updated from. Each frame, at display rate, it
+// calls onFrame, which drains the engine's queues and applies every change
+// since the last frame, so a burst of notes costs one pass and one
+// coalesced repaint rather than a callback each. When onFrame reports
+// nothing left to do and no delayed call is due, the loop stops. Another
+// thread restarts it with wake(), which posts a message only when the
+// loop is asleep. JUCE 6.0 has no VBlankAttachment, so the frame clock is a
+// 60 Hz timer.
+class UiFrameLoop : private juce::Timer,
+                    private juce::AsyncUpdater
+{
+public:
+    static constexpr int framesPerSecond = 60;
+
+    ~UiFrameLoop() override
+    {
+        stopTimer();
+        cancelPendingUpdate();
+    }
+
+    // Message thread, once per frame. Returns true while more frames are needed.
+    std::function<bool()> onFrame;
+
+    // Any thread: something changed that a frame should pick up.
+    void wake()
+    {
+        // Publish first, so a loop going to sleep now sees it and keeps running.
+        wakePending = true;
+        if (!running.load())
+            triggerAsyncUpdate();
+    }
+
+    // Message thread: calls function from the frame at least delayMs from now.
+    void callAfter(int delayMs, std::function<void()> function)
+    {
+        auto now = juce::Time::getMillisecondCounter();
+        delayed.push_back({now + (juce::uint32)juce::jmax(0, delayMs), std::move(function)});
+        if (!running.load())
+            sleep(now);
+    }
+
+    bool isRunning() const { return running.load(); }
+
+    // Frames run since construction.
+    juce::int64 getFrameCount() const { return frames; }
+
+private:
+    struct DelayedCall
+    {
+        juce::uint32 due;
+        std::function<void()> function;
+    };
+
+    void handleAsyncUpdate() override
+    {
+        startFrames();
+    }
+
+    void startFrames()
+    {
+        running = true;
+        startTimerHz(framesPerSecond);
+    }
+
+    void timerCallback() override
+    {
+        Tracer::Scope traced("ui frame");
+        ++frames;
+        Metrics::get().uiFrames.add();
+        wakePending = false;
+        auto busy = onFrame != nullptr && onFrame();
+
+        // Calls can add calls, so take the due ones out first.
+        auto now = juce::Time::getMillisecondCounter();
+        std::vector<std::function<void()>> due;
+        for (auto it = delayed.begin(); it != delayed.end();)
+        {
+            if ((juce::int32)(now - it->due) >= 0)
+            {
+                due.push_back(std::move(it->function));
+                it = delayed.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+        for (auto &function : due)
+            function();
+
+        if (!busy && due.empty())
+        {
+            running = false;
+            if (!wakePending.load())
+            {
+                sleep(now);
+                return;
+            }
+        }
+
+        // Back at frame rate after a tick for a delayed call.
+        if (!running.load() || getTimerInterval() != 1000 / framesPerSecond)
+            startFrames();
+    }
+
+    // Stops the frames, apart from one tick for the next delayed call.
+    void sleep(juce::uint32 now)
+    {
+        if (delayed.empty())
+        {
+            stopTimer();
+            return;
+        }
+
+        auto next = delayed.front().due;
+        for (auto &d : delayed)
+            if ((juce::int32)(d.due - next) < 0)
+                next = d.due;
+        startTimer(juce::jmax(1, (juce::int32)(next - now)));
+    }
+
+    std::atomic<bool> running{false}, wakePending{false};
+    std::vector<DelayedCall> delayed;
+    juce::int64 frames = 0;
+};